@@ -30,9 +30,15 @@
 #ifndef PLANNER_CSPACE_BLOCKMEM_GRIDMAP_H
 #define PLANNER_CSPACE_BLOCKMEM_GRIDMAP_H
 
+#include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <cstdint>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <planner_cspace/cyclic_vec.h>
 
@@ -70,6 +76,8 @@ private:
 protected:
   constexpr static size_t block_bit_ = log2Recursive(BLOCK_WIDTH);
   constexpr static size_t block_bit_mask_ = (1 << block_bit_) - 1;
+  // Extra elements allocated to allow 32-bit word reads of the last cell.
+  constexpr static size_t padding_ = (sizeof(int32_t) + sizeof(T) - 1) / sizeof(T);
 
   std::unique_ptr<T[]> c_;
   CyclicVecInt<DIM, NONCYCLIC> size_;
@@ -77,6 +85,7 @@ protected:
   size_t ser_size_;
   size_t block_ser_size_;
   size_t block_num_;
+  std::vector<uint8_t> dirty_;
   T dummy_;
 
   inline void block_addr(
@@ -96,24 +105,74 @@ protected:
       addr += pos[i];
     }
   }
+  // Calls fn(addr, len) for each contiguous span of the cells in the region [min, max) in x and y
+  // clipped by the map. len is the number of the elements including all angles.
+  template <class FUNC>
+  void forEachRegionSpan(
+      const CyclicVecInt<DIM, NONCYCLIC>& min, const CyclicVecInt<DIM, NONCYCLIC>& max, FUNC fn) const
+  {
+    static_assert(DIM == 3 && NONCYCLIC == 2, "Region access supports 2 noncyclic and 1 cyclic dimensions");
+
+    const int x_min = std::max(min[0], 0);
+    const int y_min = std::max(min[1], 0);
+    const int x_max = std::min(max[0], size_[0]);
+    const int y_max = std::min(max[1], size_[1]);
+    const int angle = size_[2];
+    for (int bx = x_min >> block_bit_; bx << block_bit_ < x_max; ++bx)
+    {
+      for (int by = y_min >> block_bit_; by << block_bit_ < y_max; ++by)
+      {
+        const size_t baddr = static_cast<size_t>(bx) * block_size_[1] + by;
+        const int x0 = std::max(bx << block_bit_, x_min);
+        const int y0 = std::max(by << block_bit_, y_min);
+        const int x1 = std::min((bx + 1) << block_bit_, x_max);
+        const int y1 = std::min((by + 1) << block_bit_, y_max);
+        // Cells along y axis are contiguous in the block.
+        const size_t len = static_cast<size_t>(y1 - y0) * angle;
+        for (int x = x0; x < x1; ++x)
+        {
+          fn(baddr * block_ser_size_ + (((x & block_bit_mask_) << block_bit_) + (y0 & block_bit_mask_)) * angle,
+             len);
+        }
+      }
+    }
+  }
 
 public:
-  std::function<void(CyclicVecInt<DIM, NONCYCLIC>, size_t&, size_t&)> getAddressor() const
+  // Accessors are final to be inlined when accessed through the concrete type.
+  std::function<void(CyclicVecInt<DIM, NONCYCLIC>, size_t&, size_t&)> getAddressor() const final
   {
     return std::bind(
         &BlockMemGridmap<T, DIM, NONCYCLIC, BLOCK_WIDTH, ENABLE_VALIDATION>::block_addr,
         this,
         std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
   }
-  const CyclicVecInt<DIM, NONCYCLIC>& size() const
+  const CyclicVecInt<DIM, NONCYCLIC>& size() const final
   {
     return size_;
   }
-  size_t ser_size() const
+  size_t ser_size() const final
   {
     return ser_size_;
   }
-  void clear(const T zero)
+  // Raw memory layout for the kernels processing multiple cells at once.
+  const T* data() const
+  {
+    return c_.get();
+  }
+  const CyclicVecInt<DIM, NONCYCLIC>& block_size() const
+  {
+    return block_size_;
+  }
+  size_t block_ser_size() const
+  {
+    return block_ser_size_;
+  }
+  static constexpr int block_bit()
+  {
+    return block_bit_;
+  }
+  void clear(const T zero) final
   {
     for (size_t i = 0; i < ser_size_; i++)
     {
@@ -128,7 +187,7 @@ public:
         c_[i] = zero;
     }
   }
-  void reset(const CyclicVecInt<DIM, NONCYCLIC>& size)
+  void reset(const CyclicVecInt<DIM, NONCYCLIC>& size) final
   {
     CyclicVecInt<DIM, NONCYCLIC> size_tmp = size;
 
@@ -159,7 +218,8 @@ public:
     }
     ser_size_ = block_ser_size_ * block_num_;
 
-    c_.reset(new T[ser_size_]);
+    c_.reset(new T[ser_size_ + padding_]);
+    dirty_.assign(block_num_, 0);
     size_ = size;
   }
   explicit BlockMemGridmap(const CyclicVecInt<DIM, NONCYCLIC>& size_)
@@ -171,7 +231,7 @@ public:
     : dummy_(std::numeric_limits<T>::max())
   {
   }
-  T& operator[](const CyclicVecInt<DIM, NONCYCLIC>& pos)
+  T& operator[](const CyclicVecInt<DIM, NONCYCLIC>& pos) final
   {
     size_t baddr, addr;
     block_addr(pos, baddr, addr);
@@ -183,7 +243,7 @@ public:
     }
     return c_[a];
   }
-  const T operator[](const CyclicVecInt<DIM, NONCYCLIC>& pos) const
+  const T operator[](const CyclicVecInt<DIM, NONCYCLIC>& pos) const final
   {
     size_t baddr, addr;
     block_addr(pos, baddr, addr);
@@ -195,6 +255,179 @@ public:
     }
     return c_[a];
   }
+  // Updates the region [origin, origin + region_size) from the array in which
+  // the first dimension changes fastest (e.g. costmap_cspace_msgs::CSpace3DUpdate::data).
+  // The region is clipped by the map in x and y. The angles must be inside of the map.
+  // Blocks are processed in parallel and marked as dirty.
+  // cell_op(pos, values, cells) is called for each (x, y) cell with the contiguous copy of
+  // the source values of the angles and the pointer to the cells at pos.
+  template <class S, class CELL_OP>
+  void updateRowMajor(
+      const S* src, const CyclicVecInt<DIM, NONCYCLIC>& origin, const CyclicVecInt<DIM, NONCYCLIC>& region_size,
+      CELL_OP cell_op)
+  {
+    static_assert(DIM == 3 && NONCYCLIC == 2, "updateRowMajor supports 2 noncyclic and 1 cyclic dimensions");
+
+    const int x_min = std::max(origin[0], 0);
+    const int y_min = std::max(origin[1], 0);
+    const int x_max = std::min(origin[0] + region_size[0], size_[0]);
+    const int y_max = std::min(origin[1] + region_size[1], size_[1]);
+    if (x_min >= x_max || y_min >= y_max)
+      return;
+
+    const int bx_min = x_min >> block_bit_;
+    const int by_min = y_min >> block_bit_;
+    const int num_bx = ((x_max - 1) >> block_bit_) - bx_min + 1;
+    const int num_by = ((y_max - 1) >> block_bit_) - by_min + 1;
+    const int angle = size_[2];
+    const int num_angles = region_size[2];
+    const size_t angle_stride = static_cast<size_t>(region_size[0]) * region_size[1];
+#pragma omp parallel
+    {
+      std::vector<S> values(num_angles);
+#pragma omp for schedule(dynamic)
+      for (int i = 0; i < num_bx * num_by; ++i)
+      {
+        const int bx = bx_min + i / num_by;
+        const int by = by_min + i % num_by;
+        const size_t baddr = static_cast<size_t>(bx) * block_size_[1] + by;
+        dirty_[baddr] = 1;
+        T* const block = c_.get() + baddr * block_ser_size_;
+        const int x0 = std::max(bx << block_bit_, x_min);
+        const int y0 = std::max(by << block_bit_, y_min);
+        const int x1 = std::min((bx + 1) << block_bit_, x_max);
+        const int y1 = std::min((by + 1) << block_bit_, y_max);
+
+        CyclicVecInt<DIM, NONCYCLIC> p(0, 0, origin[2]);
+        for (p[0] = x0; p[0] < x1; ++p[0])
+        {
+          for (p[1] = y0; p[1] < y1; ++p[1])
+          {
+            // Source lines of all angles in the tile stay in cache while scanning the block.
+            const S* s = src + static_cast<size_t>(p[1] - origin[1]) * region_size[0] + (p[0] - origin[0]);
+            for (int a = 0; a < num_angles; ++a, s += angle_stride)
+            {
+              values[a] = *s;
+            }
+            T* const cells =
+                block + ((((p[0] & block_bit_mask_) << block_bit_) + (p[1] & block_bit_mask_)) * angle) + origin[2];
+            cell_op(static_cast<const CyclicVecInt<DIM, NONCYCLIC>&>(p), static_cast<const S*>(values.data()), cells);
+          }
+        }
+      }
+    }
+  }
+  // Imports the whole map from the array in which the first dimension changes fastest
+  // (e.g. costmap_cspace_msgs::CSpace3D::data).
+  // conv(value) returns the value to be stored.
+  // cell_cb(pos, values) is called for each (x, y) cell after all angles are stored,
+  // with the pointer to the contiguous values of the angles.
+  template <class S, class CONV, class CELL_CB>
+  void importRowMajor(const S* src, CONV conv, CELL_CB cell_cb)
+  {
+    const int angle = size_[2];
+    updateRowMajor(
+        src, CyclicVecInt<DIM, NONCYCLIC>(0, 0, 0), size_,
+        [angle, &conv, &cell_cb](const CyclicVecInt<DIM, NONCYCLIC>& p, const S* values, T* cells)
+        {
+          for (int a = 0; a < angle; ++a)
+          {
+            cells[a] = conv(values[a]);
+          }
+          cell_cb(p, static_cast<const T*>(cells));
+        });
+  }
+  // Dirty flags of the blocks are set by updateRowMajor() and importRowMajor().
+  size_t block_num() const
+  {
+    return block_num_;
+  }
+  bool isBlockDirty(const size_t baddr) const
+  {
+    return dirty_[baddr];
+  }
+  void clearDirtyBlocks()
+  {
+    std::fill(dirty_.begin(), dirty_.end(), 0);
+  }
+  // Gets the region [min, max) of the cells in the block clipped by the map.
+  void blockRegion(
+      const size_t baddr, CyclicVecInt<DIM, NONCYCLIC>& min, CyclicVecInt<DIM, NONCYCLIC>& max) const
+  {
+    size_t b = baddr;
+    for (int i = NONCYCLIC - 1; i >= 0; --i)
+    {
+      min[i] = (b % block_size_[i]) << block_bit_;
+      max[i] = std::min(min[i] + BLOCK_WIDTH, size_[i]);
+      b /= block_size_[i];
+    }
+    for (int i = NONCYCLIC; i < DIM; i++)
+    {
+      min[i] = 0;
+      max[i] = size_[i];
+    }
+  }
+  // Gets the addresses of the blocks overlapping the region [min, max) in x and y clipped by the map.
+  void regionBlocks(
+      const CyclicVecInt<DIM, NONCYCLIC>& min, const CyclicVecInt<DIM, NONCYCLIC>& max,
+      std::vector<size_t>& baddrs) const
+  {
+    static_assert(DIM == 3 && NONCYCLIC == 2, "regionBlocks supports 2 noncyclic and 1 cyclic dimensions");
+
+    baddrs.clear();
+    const int x_min = std::max(min[0], 0);
+    const int y_min = std::max(min[1], 0);
+    const int x_max = std::min(max[0], size_[0]);
+    const int y_max = std::min(max[1], size_[1]);
+    for (int bx = x_min >> block_bit_; bx << block_bit_ < x_max; ++bx)
+    {
+      for (int by = y_min >> block_bit_; by << block_bit_ < y_max; ++by)
+      {
+        baddrs.push_back(static_cast<size_t>(bx) * block_size_[1] + by);
+      }
+    }
+  }
+  // Copies the block from the map of the same size. Dirty flags are not changed.
+  void copyBlock(const BlockMemGridmap<T, DIM, NONCYCLIC, BLOCK_WIDTH, ENABLE_VALIDATION>& gm, const size_t baddr)
+  {
+    memcpy(c_.get() + baddr * block_ser_size_, gm.c_.get() + baddr * block_ser_size_, block_ser_size_ * sizeof(T));
+  }
+  // Copies the dirty blocks from the map of the same size and clears the dirty flags.
+  void copyDirtyBlocks(const BlockMemGridmap<T, DIM, NONCYCLIC, BLOCK_WIDTH, ENABLE_VALIDATION>& gm)
+  {
+    for (size_t b = 0; b < block_num_; ++b)
+    {
+      if (!dirty_[b])
+        continue;
+      copyBlock(gm, b);
+      dirty_[b] = 0;
+    }
+  }
+  // Copies all angles of the cells in the region [min, max) in x and y from the map of the same size
+  // without reallocation. The region is clipped by the map. Dirty flags are not changed.
+  void copyRegion(
+      const BlockMemGridmap<T, DIM, NONCYCLIC, BLOCK_WIDTH, ENABLE_VALIDATION>& gm,
+      const CyclicVecInt<DIM, NONCYCLIC>& min, const CyclicVecInt<DIM, NONCYCLIC>& max)
+  {
+    forEachRegionSpan(
+        min, max,
+        [this, &gm](const size_t addr, const size_t len)
+        {
+          memcpy(c_.get() + addr, gm.c_.get() + addr, len * sizeof(T));
+        });
+  }
+  // Fills all angles of the cells in the region [min, max) in x and y.
+  // The region is clipped by the map. Dirty flags are not changed.
+  void clearRegion(
+      const T zero, const CyclicVecInt<DIM, NONCYCLIC>& min, const CyclicVecInt<DIM, NONCYCLIC>& max)
+  {
+    forEachRegionSpan(
+        min, max,
+        [this, zero](const size_t addr, const size_t len)
+        {
+          std::fill_n(c_.get() + addr, len, zero);
+        });
+  }
   bool validate(const CyclicVecInt<DIM, NONCYCLIC>& pos, const int tolerance = 0) const
   {
     for (int i = 0; i < NONCYCLIC; i++)
@@ -213,11 +446,188 @@ public:
       const BlockMemGridmap<T, DIM, NONCYCLIC, BLOCK_WIDTH, ENABLE_VALIDATION>& gm)
   {
     reset(gm.size_);
-    memcpy(c_.get(), gm.c_.get(), ser_size_);
+    memcpy(c_.get(), gm.c_.get(), ser_size_ * sizeof(T));
 
     return *this;
   }
 };
+
+// BlockMemGridmap initializing the blocks on the first access through non-const operator[].
+// clear() is O(1): each block has the generation number of the last clear()
+// and is filled by the cleared value when accessed in a new generation.
+// Memory is allocated without initialization, so that the pages of the blocks
+// never accessed are not committed by the OS.
+// Blocks are initialized thread-safely, so that the different cells can be accessed concurrently.
+// data() is not provided since the blocks not accessed have undefined values.
+template <class T, int DIM, int NONCYCLIC, int BLOCK_WIDTH = 0x20>
+class LazyBlockMemGridmap : public BlockMemGridmapBase<T, DIM, NONCYCLIC>
+{
+private:
+  using Dense = BlockMemGridmap<T, DIM, NONCYCLIC, BLOCK_WIDTH>;
+
+protected:
+  constexpr static size_t block_bit_ = Dense::block_bit();
+  constexpr static size_t block_bit_mask_ = (1 << block_bit_) - 1;
+
+  std::unique_ptr<T[]> c_;
+  std::unique_ptr<std::atomic<uint32_t>[]> block_gen_;
+  std::mutex init_mutex_;
+  uint32_t gen_;
+  T zero_;
+  CyclicVecInt<DIM, NONCYCLIC> size_;
+  CyclicVecInt<DIM, NONCYCLIC> block_size_;
+  size_t ser_size_;
+  size_t block_ser_size_;
+  size_t block_num_;
+
+  inline void block_addr(
+      const CyclicVecInt<DIM, NONCYCLIC>& pos, size_t& baddr, size_t& addr) const
+  {
+    addr = 0;
+    baddr = 0;
+    for (int i = 0; i < NONCYCLIC; i++)
+    {
+      addr = (addr << block_bit_) + (pos[i] & block_bit_mask_);
+      baddr *= block_size_[i];
+      baddr += pos[i] >> block_bit_;
+    }
+    for (int i = NONCYCLIC; i < DIM; i++)
+    {
+      addr *= size_[i];
+      addr += pos[i];
+    }
+  }
+  void initBlock(const size_t baddr)
+  {
+    std::lock_guard<std::mutex> lock(init_mutex_);
+    if (block_gen_[baddr].load(std::memory_order_relaxed) == gen_)
+      return;
+    std::fill_n(c_.get() + baddr * block_ser_size_, block_ser_size_, zero_);
+    block_gen_[baddr].store(gen_, std::memory_order_release);
+  }
+
+public:
+  std::function<void(CyclicVecInt<DIM, NONCYCLIC>, size_t&, size_t&)> getAddressor() const final
+  {
+    return std::bind(
+        &LazyBlockMemGridmap<T, DIM, NONCYCLIC, BLOCK_WIDTH>::block_addr,
+        this,
+        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+  }
+  const CyclicVecInt<DIM, NONCYCLIC>& size() const final
+  {
+    return size_;
+  }
+  size_t ser_size() const final
+  {
+    return ser_size_;
+  }
+  // Number of the blocks initialized after the last clear().
+  size_t initialized_blocks() const
+  {
+    size_t num = 0;
+    for (size_t i = 0; i < block_num_; ++i)
+    {
+      if (block_gen_[i] == gen_)
+        ++num;
+    }
+    return num;
+  }
+  void clear(const T zero) final
+  {
+    zero_ = zero;
+    ++gen_;
+    if (gen_ == 0)
+    {
+      // Wrapped around
+      for (size_t i = 0; i < block_num_; ++i)
+        block_gen_[i] = 0;
+      gen_ = 1;
+    }
+  }
+  void reset(const CyclicVecInt<DIM, NONCYCLIC>& size) final
+  {
+    CyclicVecInt<DIM, NONCYCLIC> size_tmp = size;
+
+    for (int i = 0; i < NONCYCLIC; i++)
+    {
+      if (size_tmp[i] < BLOCK_WIDTH)
+        size_tmp[i] = BLOCK_WIDTH;
+    }
+
+    block_ser_size_ = 1;
+    block_num_ = 1;
+    for (int i = 0; i < DIM; i++)
+    {
+      int width;
+      if (i < NONCYCLIC)
+      {
+        width = BLOCK_WIDTH;
+        block_size_[i] = (size_tmp[i] + width - 1) / width;
+      }
+      else
+      {
+        width = size_tmp[i];
+        block_size_[i] = 1;
+      }
+
+      block_ser_size_ *= width;
+      block_num_ *= block_size_[i];
+    }
+    ser_size_ = block_ser_size_ * block_num_;
+
+    c_.reset(new T[ser_size_]);
+    block_gen_.reset(new std::atomic<uint32_t>[block_num_]);
+    for (size_t i = 0; i < block_num_; ++i)
+      block_gen_[i] = 0;
+    gen_ = 1;
+    zero_ = T();
+    size_ = size;
+  }
+  explicit LazyBlockMemGridmap(const CyclicVecInt<DIM, NONCYCLIC>& size_)
+    : LazyBlockMemGridmap()
+  {
+    reset(size_);
+  }
+  LazyBlockMemGridmap()
+    : gen_(1)
+    , zero_()
+    , ser_size_(0)
+    , block_ser_size_(0)
+    , block_num_(0)
+  {
+  }
+  T& operator[](const CyclicVecInt<DIM, NONCYCLIC>& pos) final
+  {
+    size_t baddr, addr;
+    block_addr(pos, baddr, addr);
+    if (block_gen_[baddr].load(std::memory_order_acquire) != gen_)
+      initBlock(baddr);
+    return c_[baddr * block_ser_size_ + addr];
+  }
+  const T operator[](const CyclicVecInt<DIM, NONCYCLIC>& pos) const final
+  {
+    size_t baddr, addr;
+    block_addr(pos, baddr, addr);
+    if (block_gen_[baddr].load(std::memory_order_acquire) != gen_)
+      return zero_;
+    return c_[baddr * block_ser_size_ + addr];
+  }
+  bool validate(const CyclicVecInt<DIM, NONCYCLIC>& pos, const int tolerance = 0) const
+  {
+    for (int i = 0; i < NONCYCLIC; i++)
+    {
+      if (pos[i] < tolerance || size_[i] - tolerance <= pos[i])
+        return false;
+    }
+    for (int i = NONCYCLIC; i < DIM; i++)
+    {
+      if (pos[i] < 0 || size_[i] <= pos[i])
+        return false;
+    }
+    return true;
+  }
+};
 }  // namespace planner_cspace
 
 #endif  // PLANNER_CSPACE_BLOCKMEM_GRIDMAP_H
@@ -0,0 +1,525 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_COMPACT_BLOCKMEM_GRIDMAP_H
+#define PLANNER_CSPACE_COMPACT_BLOCKMEM_GRIDMAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/cyclic_vec.h>
+
+namespace planner_cspace
+{
+// Costmap value (-1: unknown, 0-100) quantized to 2^BITS codes.
+// Unknown and lethal costs are kept exactly, and other costs are rounded up.
+template <int BITS>
+class QuantizedCostCodec
+{
+public:
+  using Value = char;
+  static constexpr int bits = BITS;
+
+private:
+  static constexpr int levels_ = (1 << BITS) - 2;
+
+public:
+  uint32_t encode(const Value v) const
+  {
+    if (v < 0)
+      return 0;
+    return 1 + (std::min<int>(v, 100) * levels_ + 99) / 100;
+  }
+  Value decode(const uint32_t code) const
+  {
+    if (code == 0)
+      return -1;
+    return static_cast<Value>((code - 1) * 100 / levels_);
+  }
+};
+
+// Non-negative cost in fixed point with the given resolution.
+// Costs are rounded up to keep them admissible as lower bounds of the path cost.
+// std::numeric_limits<float>::max() and the costs exceeding the range are stored as max(),
+// and negative values are decoded as -1.
+template <class STORAGE>
+class FixedPointCostCodec
+{
+public:
+  using Value = float;
+  static constexpr int bits = sizeof(STORAGE) * 8;
+
+private:
+  static constexpr uint32_t max_code_ = std::numeric_limits<STORAGE>::max();
+  static constexpr uint32_t negative_code_ = max_code_ - 1;
+  float resolution_;
+
+public:
+  FixedPointCostCodec()
+    : resolution_(1.0)
+  {
+  }
+  void setResolution(const float resolution)
+  {
+    resolution_ = resolution;
+  }
+  float resolution() const
+  {
+    return resolution_;
+  }
+  uint32_t encode(const Value v) const
+  {
+    if (v < 0)
+      return negative_code_;
+    const float code = std::ceil(v / resolution_);
+    if (code >= negative_code_)
+      return max_code_;
+    return static_cast<uint32_t>(code);
+  }
+  Value decode(const uint32_t code) const
+  {
+    if (code == max_code_)
+      return std::numeric_limits<float>::max();
+    if (code == negative_code_)
+      return -1;
+    return code * resolution_;
+  }
+};
+
+// BlockMemGridmap storing the values encoded by CODEC in CODEC::bits bit codes.
+// operator[] returns a proxy object which can be read and assigned as the value,
+// so that the code accessing BlockMemGridmap can be used as is.
+// Writing the codes sharing the same byte from multiple threads is not thread-safe.
+template <class CODEC, int DIM, int NONCYCLIC, int BLOCK_WIDTH = 0x20>
+class PackedBlockMemGridmap
+{
+public:
+  using Value = typename CODEC::Value;
+  using Vec = CyclicVecInt<DIM, NONCYCLIC>;
+
+private:
+  static_assert(CODEC::bits == 4 || CODEC::bits == 8 || CODEC::bits == 16,
+                "CODEC::bits must be 4, 8 or 16");
+  using Word = typename std::conditional<CODEC::bits == 16, uint16_t, uint8_t>::type;
+  static constexpr size_t codes_per_word_ = sizeof(Word) * 8 / CODEC::bits;
+  static constexpr uint32_t code_mask_ = (1u << CODEC::bits) - 1;
+
+  static constexpr int block_bit_ = BlockMemGridmap<Word, DIM, NONCYCLIC, BLOCK_WIDTH>::block_bit();
+  static constexpr int block_bit_mask_ = BLOCK_WIDTH - 1;
+
+  CODEC codec_;
+  std::unique_ptr<Word[]> c_;
+  Vec size_;
+  Vec block_size_;
+  size_t ser_size_;
+  size_t block_ser_size_;
+
+  // Same memory layout as BlockMemGridmap.
+  size_t address(const Vec& pos) const
+  {
+    size_t addr = 0;
+    size_t baddr = 0;
+    for (int i = 0; i < NONCYCLIC; i++)
+    {
+      addr = (addr << block_bit_) + (pos[i] & block_bit_mask_);
+      baddr *= block_size_[i];
+      baddr += pos[i] >> block_bit_;
+    }
+    for (int i = NONCYCLIC; i < DIM; i++)
+    {
+      addr *= size_[i];
+      addr += pos[i];
+    }
+    return baddr * block_ser_size_ + addr;
+  }
+  size_t numWords() const
+  {
+    return (ser_size_ + codes_per_word_ - 1) / codes_per_word_;
+  }
+
+  uint32_t getCode(const size_t a) const
+  {
+    return (c_[a / codes_per_word_] >> ((a % codes_per_word_) * CODEC::bits)) & code_mask_;
+  }
+  void setCode(const size_t a, const uint32_t code)
+  {
+    Word& w = c_[a / codes_per_word_];
+    const size_t shift = (a % codes_per_word_) * CODEC::bits;
+    w = static_cast<Word>((w & ~(code_mask_ << shift)) | (code << shift));
+  }
+
+public:
+  class Reference
+  {
+  private:
+    PackedBlockMemGridmap& map_;
+    const size_t a_;
+
+  public:
+    Reference(PackedBlockMemGridmap& map, const size_t a)
+      : map_(map)
+      , a_(a)
+    {
+    }
+    operator Value() const
+    {
+      return map_.codec_.decode(map_.getCode(a_));
+    }
+    Reference& operator=(const Value v)
+    {
+      map_.setCode(a_, map_.codec_.encode(v));
+      return *this;
+    }
+    Reference& operator=(const Reference& r)
+    {
+      return *this = static_cast<Value>(r);
+    }
+  };
+
+  PackedBlockMemGridmap()
+    : ser_size_(0)
+    , block_ser_size_(0)
+  {
+  }
+  explicit PackedBlockMemGridmap(const Vec& size)
+    : PackedBlockMemGridmap()
+  {
+    reset(size);
+  }
+  CODEC& codec()
+  {
+    return codec_;
+  }
+  const CODEC& codec() const
+  {
+    return codec_;
+  }
+  const Vec& size() const
+  {
+    return size_;
+  }
+  size_t ser_size() const
+  {
+    return ser_size_;
+  }
+  // Allocated memory in bytes.
+  size_t bytes() const
+  {
+    return numWords() * sizeof(Word);
+  }
+  void reset(const Vec& size)
+  {
+    block_ser_size_ = 1;
+    size_t block_num = 1;
+    for (int i = 0; i < DIM; i++)
+    {
+      if (i < NONCYCLIC)
+      {
+        block_size_[i] = (std::max(size[i], BLOCK_WIDTH) + BLOCK_WIDTH - 1) / BLOCK_WIDTH;
+        block_ser_size_ *= BLOCK_WIDTH;
+      }
+      else
+      {
+        block_size_[i] = 1;
+        block_ser_size_ *= size[i];
+      }
+      block_num *= block_size_[i];
+    }
+    ser_size_ = block_ser_size_ * block_num;
+    size_ = size;
+    c_.reset(new Word[numWords()]);
+  }
+  void clear(const Value zero)
+  {
+    const uint32_t code = codec_.encode(zero);
+    Word w = 0;
+    for (size_t i = 0; i < codes_per_word_; ++i)
+      w |= code << (i * CODEC::bits);
+    std::fill_n(c_.get(), numWords(), w);
+  }
+  bool validate(const Vec& pos, const int tolerance = 0) const
+  {
+    for (int i = 0; i < NONCYCLIC; i++)
+    {
+      if (pos[i] < tolerance || size_[i] - tolerance <= pos[i])
+        return false;
+    }
+    for (int i = NONCYCLIC; i < DIM; i++)
+    {
+      if (pos[i] < 0 || size_[i] <= pos[i])
+        return false;
+    }
+    return true;
+  }
+  Reference operator[](const Vec& pos)
+  {
+    return Reference(*this, address(pos));
+  }
+  const Value operator[](const Vec& pos) const
+  {
+    return codec_.decode(getCode(address(pos)));
+  }
+};
+
+// 3D gridmap storing the values of all angles by one value
+// on the (x, y) cells having the same value at every angle (e.g. free space).
+// Angles of the other cells are stored in a shared pool.
+// operator[] returns a proxy object which can be read and assigned as the value.
+template <class T, int BLOCK_WIDTH = 0x20>
+class AngleSparseGridmap
+{
+public:
+  using Vec = CyclicVecInt<3, 2>;
+
+private:
+  static constexpr uint32_t UNIFORM = std::numeric_limits<uint32_t>::max();
+
+  Vec size_;
+  BlockMemGridmap<T, 3, 2, BLOCK_WIDTH> uniform_;
+  // Offset of the angles of the cell in pool_ divided by the number of angles, or UNIFORM.
+  BlockMemGridmap<uint32_t, 3, 2, BLOCK_WIDTH> index_;
+  std::vector<T> pool_;
+
+  T get(const Vec& pos) const
+  {
+    const Vec p2(pos[0], pos[1], 0);
+    const uint32_t i = index_[p2];
+    if (i == UNIFORM)
+      return uniform_[p2];
+    return pool_[static_cast<size_t>(i) * size_[2] + pos[2]];
+  }
+  void set(const Vec& pos, const T v)
+  {
+    const Vec p2(pos[0], pos[1], 0);
+    uint32_t& i = index_[p2];
+    if (i == UNIFORM)
+    {
+      const T u = uniform_[p2];
+      if (u == v)
+        return;
+      i = pool_.size() / size_[2];
+      pool_.resize(pool_.size() + size_[2], u);
+    }
+    pool_[static_cast<size_t>(i) * size_[2] + pos[2]] = v;
+  }
+
+public:
+  class Reference
+  {
+  private:
+    AngleSparseGridmap& map_;
+    const Vec pos_;
+
+  public:
+    Reference(AngleSparseGridmap& map, const Vec& pos)
+      : map_(map)
+      , pos_(pos)
+    {
+    }
+    operator T() const
+    {
+      return map_.get(pos_);
+    }
+    Reference& operator=(const T v)
+    {
+      map_.set(pos_, v);
+      return *this;
+    }
+    Reference& operator=(const Reference& r)
+    {
+      return *this = static_cast<T>(r);
+    }
+  };
+
+  AngleSparseGridmap()
+  {
+  }
+  explicit AngleSparseGridmap(const Vec& size)
+  {
+    reset(size);
+  }
+  const Vec& size() const
+  {
+    return size_;
+  }
+  size_t ser_size() const
+  {
+    return uniform_.ser_size() * size_[2];
+  }
+  // Number of the cells stored with all angles.
+  size_t numNonUniformCells() const
+  {
+    return pool_.size() / size_[2];
+  }
+  // Allocated memory in bytes.
+  size_t bytes() const
+  {
+    return uniform_.ser_size() * (sizeof(T) + sizeof(uint32_t)) + pool_.capacity() * sizeof(T);
+  }
+  void reset(const Vec& size)
+  {
+    size_ = size;
+    uniform_.reset(Vec(size[0], size[1], 1));
+    index_.reset(Vec(size[0], size[1], 1));
+    clear(0);
+  }
+  void clear(const T zero)
+  {
+    uniform_.clear(zero);
+    index_.clear(UNIFORM);
+    pool_.clear();
+    pool_.shrink_to_fit();
+  }
+  bool validate(const Vec& pos, const int tolerance = 0) const
+  {
+    return pos[0] >= tolerance && pos[0] < size_[0] - tolerance &&
+           pos[1] >= tolerance && pos[1] < size_[1] - tolerance &&
+           pos[2] >= 0 && pos[2] < size_[2];
+  }
+  Reference operator[](const Vec& pos)
+  {
+    return Reference(*this, pos);
+  }
+  const T operator[](const Vec& pos) const
+  {
+    return get(pos);
+  }
+  // Stores the cells which became uniform by one value and releases unused memory.
+  void compact()
+  {
+    std::vector<T> pool;
+    Vec p(0, 0, 0);
+    for (p[1] = 0; p[1] < size_[1]; ++p[1])
+    {
+      for (p[0] = 0; p[0] < size_[0]; ++p[0])
+      {
+        uint32_t& i = index_[p];
+        if (i == UNIFORM)
+          continue;
+        const auto begin = pool_.cbegin() + static_cast<size_t>(i) * size_[2];
+        const auto end = begin + size_[2];
+        if (std::all_of(begin, end, [begin](const T v) { return v == *begin; }))
+        {
+          uniform_[p] = *begin;
+          i = UNIFORM;
+          continue;
+        }
+        i = pool.size() / size_[2];
+        pool.insert(pool.end(), begin, end);
+      }
+    }
+    pool.shrink_to_fit();
+    pool_.swap(pool);
+  }
+  // Copies from the dense gridmap of the same size in [min, max) of x-y plane. All angles are copied.
+  template <int BW, bool V>
+  void assign(const BlockMemGridmap<T, 3, 2, BW, V>& gm, const Vec& min, const Vec& max)
+  {
+    const int x_min = std::max(min[0], 0);
+    const int y_min = std::max(min[1], 0);
+    const int x_max = std::min(max[0], size_[0]);
+    const int y_max = std::min(max[1], size_[1]);
+    const auto addressor = gm.getAddressor();
+    Vec p(0, 0, 0);
+    for (p[1] = y_min; p[1] < y_max; ++p[1])
+    {
+      for (p[0] = x_min; p[0] < x_max; ++p[0])
+      {
+        // Angles of the cell are contiguous in BlockMemGridmap.
+        size_t baddr, addr;
+        addressor(p, baddr, addr);
+        const T* const angles = gm.data() + baddr * gm.block_ser_size() + addr;
+        uint32_t& i = index_[p];
+        if (std::all_of(angles, angles + size_[2], [angles](const T v) { return v == angles[0]; }))
+        {
+          // Pool entry of the cell, if any, is released by compact().
+          uniform_[p] = angles[0];
+          i = UNIFORM;
+          continue;
+        }
+        if (i == UNIFORM)
+        {
+          i = pool_.size() / size_[2];
+          pool_.insert(pool_.end(), angles, angles + size_[2]);
+        }
+        else
+        {
+          std::copy_n(angles, size_[2], pool_.begin() + static_cast<size_t>(i) * size_[2]);
+        }
+      }
+    }
+  }
+  // Copies from the dense gridmap.
+  template <int BW, bool V>
+  void assign(const BlockMemGridmap<T, 3, 2, BW, V>& gm)
+  {
+    reset(gm.size());
+    assign(gm, Vec(0, 0, 0), size_);
+    pool_.shrink_to_fit();
+  }
+  // Copies to the dense gridmap in [min, max) of x-y plane. All angles are copied.
+  template <int BW, bool V>
+  void copyTo(BlockMemGridmap<T, 3, 2, BW, V>& gm, const Vec& min, const Vec& max) const
+  {
+    const int x_min = std::max(min[0], 0);
+    const int y_min = std::max(min[1], 0);
+    const int x_max = std::min(max[0], size_[0]);
+    const int y_max = std::min(max[1], size_[1]);
+    Vec p(0, 0, 0);
+    for (p[1] = y_min; p[1] < y_max; ++p[1])
+    {
+      for (p[0] = x_min; p[0] < x_max; ++p[0])
+      {
+        T* const angles = &gm[p];
+        const uint32_t i = index_[p];
+        if (i == UNIFORM)
+          std::fill_n(angles, size_[2], uniform_[p]);
+        else
+          std::copy_n(pool_.cbegin() + static_cast<size_t>(i) * size_[2], size_[2], angles);
+      }
+    }
+  }
+  template <int BW, bool V>
+  void copyTo(BlockMemGridmap<T, 3, 2, BW, V>& gm) const
+  {
+    if (gm.size() != size_)
+      gm.reset(size_);
+    copyTo(gm, Vec(0, 0, 0), size_);
+  }
+};
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_COMPACT_BLOCKMEM_GRIDMAP_H
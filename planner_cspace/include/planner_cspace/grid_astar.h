@@ -31,18 +31,22 @@
 #define PLANNER_CSPACE_GRID_ASTAR_H
 
 #define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cassert>
 #include <cfloat>
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <list>
 #include <map>
 #include <memory>
-#include <unordered_map>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <boost/chrono.hpp>
 
+#include <planner_cspace/priority_queues.h>
 #include <planner_cspace/reservable_priority_queue.h>
 #include <planner_cspace/cyclic_vec.h>
 #include <planner_cspace/blockmem_gridmap.h>
@@ -52,7 +56,14 @@
 
 namespace planner_cspace
 {
-template <int DIM = 3, int NONCYCLIC = 2>
+// OPEN_LIST is a priority queue template having the interface of reservable_priority_queue.
+// Alternative implementations are provided in priority_queues.h.
+// Templates having extra parameters can be given through an alias template like:
+//   template <class T> using DaryHeap4 = dary_heap<T, 4>;
+// If LAZY_SEARCH_GRIDMAP is true, the cost and parent maps of the search are LazyBlockMemGridmap,
+// so that only the blocks touched by the search are allocated and initialized on each search.
+template <int DIM = 3, int NONCYCLIC = 2, template <class> class OPEN_LIST = reservable_priority_queue,
+          bool LAZY_SEARCH_GRIDMAP = false>
 class GridAstar
 {
 public:
@@ -65,6 +76,11 @@ public:
   {
     using BlockMemGridmap<T, DIM, NONCYCLIC, block_width>::BlockMemGridmap;
   };
+  template <class T>
+  using SearchGridmap = typename std::conditional<
+      LAZY_SEARCH_GRIDMAP,
+      LazyBlockMemGridmap<T, DIM, NONCYCLIC>,
+      Gridmap<T>>::type;
 
   class PriorityVec
   {
@@ -121,6 +137,15 @@ public:
     }
   };
 
+public:
+  struct SearchStats
+  {
+    size_t expansions_;
+    size_t open_size_;
+    float duration_;
+    bool budget_exceeded_;
+  };
+
 public:
   constexpr int getDim() const
   {
@@ -134,50 +159,180 @@ public:
   {
     search_task_num_ = search_task_num;
   }
+  // Distributed search assigns each grid to an owner thread by its hash.
+  // Each thread holds its own open list and applies updates only to the grids it owns,
+  // so that the updates are merged without the global critical section.
+  void enableDistributedSearch(const bool enable)
+  {
+    distributed_search_ = enable;
+  }
+
+  // Parent links are stored as 32-bit serialized indexes.
+  // Maps having NO_PARENT or more grids can't be searched.
+  static bool isSizeSupported(const Vec& size)
+  {
+    uint64_t num = 1;
+    for (int i = 0; i < DIM; ++i)
+      num *= static_cast<uint64_t>(std::max(size[i], 0));
+    return num < NO_PARENT;
+  }
 
   void reset(const Vec size)
   {
+    assert(isSizeSupported(size));
     g_.reset(size);
     g_.clear(std::numeric_limits<float>::max());
-    parents_.reserve(g_.ser_size() / 16);
+    parents_.reset(size);
+    parents_.clear(NO_PARENT);
     open_.reserve(g_.ser_size() / 16);
+    incremental_valid_ = false;
   }
   GridAstar()
     : queue_size_limit_(0)
     , search_task_num_(1)
+    , distributed_search_(false)
+    , budget_time_(0)
+    , budget_expansions_(0)
+    , stats_{0, 0, 0, false}
+    , closed_id_(0)
+    , incremental_valid_(false)
   {
   }
   explicit GridAstar(const Vec size)
+    : GridAstar()
   {
     reset(size);
-    queue_size_limit_ = 0;
   }
   void setQueueSizeLimit(const size_t size)
   {
     queue_size_limit_ = size;
   }
+  // Limits the elapsed time [sec] and the number of the expanded grids of a search call.
+  // Zero means unlimited. Anytime and incremental search check the budget every 256 steps.
+  // Search exceeding the budget is handled same as no feasible path,
+  // so the path to the grid closest to the goal is returned if return_best is set.
+  void setSearchBudget(const float time_limit, const size_t expansion_limit)
+  {
+    budget_time_ = time_limit;
+    budget_expansions_ = expansion_limit;
+  }
+  // Statistics of the last search call.
+  const SearchStats& getSearchStats() const
+  {
+    return stats_;
+  }
 
+  // MODEL is GridAstarModelBase or its derived class.
+  // If the concrete model type having final member functions is given,
+  // the search loop is compiled without virtual function calls.
+  template <class MODEL>
   bool search(
       const std::vector<VecWithCost>& ss, const Vec& e,
       std::list<Vec>& path,
-      const typename GridAstarModelBase<DIM, NONCYCLIC>::Ptr& model,
+      const std::shared_ptr<MODEL>& model,
       std::function<bool(const std::list<Vec>&)> cb_progress,
       const float cost_leave,
       const float progress_interval,
       const bool return_best = false)
   {
+    static_assert(
+        std::is_base_of<GridAstarModelBase<DIM, NONCYCLIC>, MODEL>::value,
+        "MODEL must be derived from GridAstarModelBase");
+    incremental_valid_ = false;
+    if (distributed_search_)
+    {
+      return searchImplDistributed(
+          g_, ss, e, path,
+          model, cb_progress,
+          cost_leave, progress_interval, return_best);
+    }
     return searchImpl(
         g_, ss, e, path,
         model, cb_progress,
         cost_leave, progress_interval, return_best);
   }
 
+  // Anytime Repairing A* (ARA*).
+  // The first solution is searched with the heuristic inflated by epsilon_start,
+  // and improved by decreasing epsilon by epsilon_step until reaching 1.0 or time_limit.
+  // OPEN and INCONS lists are reused between the iterations.
+  // cb_improved is called on each found or improved solution.
+  template <class MODEL>
+  bool searchAnytime(
+      const std::vector<VecWithCost>& ss, const Vec& e,
+      std::list<Vec>& path,
+      const std::shared_ptr<MODEL>& model,
+      std::function<bool(const std::list<Vec>&)> cb_improved,
+      const float cost_leave,
+      const float epsilon_start,
+      const float epsilon_step,
+      const float time_limit,
+      const bool return_best = false)
+  {
+    incremental_valid_ = false;
+    return searchImplAnytime(
+        g_, ss, e, path,
+        model, cb_improved,
+        cost_leave, epsilon_start, epsilon_step, time_limit, return_best);
+  }
+
+  // Lifelong Planning A* (LPA*).
+  // The search tree is kept between the calls while the start grids, goal and cost_leave are unchanged,
+  // and only the starts having changed costs, the grids notified by updateIncremental()
+  // and their descendants are repaired.
+  // Grids in the goal region (costEstim < cost_leave) are determined on their first visit
+  // and kept until the search tree is reset.
+  // Calling search() or searchAnytime() discards the search tree.
+  template <class MODEL>
+  bool searchIncremental(
+      const std::vector<VecWithCost>& ss, const Vec& e,
+      std::list<Vec>& path,
+      const std::shared_ptr<MODEL>& model,
+      const float cost_leave,
+      const bool return_best = false)
+  {
+    return searchImplIncremental(
+        g_, ss, e, path,
+        model, cost_leave, return_best);
+  }
+  // Notifies that the costs of the motions reaching the grids in [min, max) are changed.
+  // Cyclic elements are cycled, and noncyclic elements are clipped by the map size.
+  void updateIncremental(const Vec& min, const Vec& max)
+  {
+    if (incremental_valid_)
+      updated_regions_.emplace_back(min, max);
+  }
+  void resetIncremental()
+  {
+    incremental_valid_ = false;
+  }
+
 protected:
+  using Clock = boost::chrono::high_resolution_clock;
+
+  bool isBudgetExceeded(const Clock::time_point& ts, const size_t expansions) const
+  {
+    if (budget_expansions_ > 0 && expansions >= budget_expansions_)
+      return true;
+    return budget_time_ > 0 &&
+           boost::chrono::duration<float>(Clock::now() - ts).count() >= budget_time_;
+  }
+  void updateStats(
+      const Clock::time_point& ts, const size_t expansions, const size_t open_size,
+      const bool budget_exceeded)
+  {
+    stats_.expansions_ = expansions;
+    stats_.open_size_ = open_size;
+    stats_.duration_ = boost::chrono::duration<float>(Clock::now() - ts).count();
+    stats_.budget_exceeded_ = budget_exceeded;
+  }
+
+  template <class MODEL>
   bool searchImpl(
-      Gridmap<float>& g,
+      SearchGridmap<float>& g,
       const std::vector<VecWithCost>& sts, const Vec& en,
       std::list<Vec>& path,
-      const typename GridAstarModelBase<DIM, NONCYCLIC>::Ptr& model,
+      const std::shared_ptr<MODEL>& model,
       std::function<bool(const std::list<Vec>&)> cb_progress,
       const float cost_leave,
       const float progress_interval,
@@ -186,13 +341,14 @@ protected:
     if (sts.size() == 0)
       return false;
 
-    auto ts = boost::chrono::high_resolution_clock::now();
+    const auto ts_start = Clock::now();
+    auto ts = ts_start;
 
     Vec e = en;
     e.cycleUnsigned(g.size());
     g.clear(std::numeric_limits<float>::max());
     open_.clear();
-    parents_.clear();
+    parents_.clear(NO_PARENT);
 
     std::vector<VecWithCost> ss_normalized;
     Vec better;
@@ -220,6 +376,8 @@ protected:
     centers.reserve(search_task_num_);
 
     bool found(false);
+    bool exceeded(false);
+    size_t expansions = 0;
 #pragma omp parallel
     {
       std::vector<GridmapUpdate> updates;
@@ -253,6 +411,9 @@ protected:
             centers.emplace_back(std::move(center));
             ++i;
           }
+          expansions += centers.size();
+          if (!found && isBudgetExceeded(ts_start, expansions))
+            exceeded = true;
           const auto tnow = boost::chrono::high_resolution_clock::now();
           if (boost::chrono::duration<float>(tnow - ts).count() >= progress_interval)
           {
@@ -262,7 +423,7 @@ protected:
             cb_progress(path_tmp);
           }
         }
-        if (centers.size() < 1 || found)
+        if (centers.size() < 1 || found || exceeded)
           break;
         updates.clear();
         dont.clear();
@@ -283,7 +444,7 @@ protected:
             better = p;
           }
 
-          const std::vector<Vec> search_list = model->searchGrids(p, ss_normalized, e);
+          const std::vector<Vec>& search_list = model->searchGrids(p, ss_normalized, e);
 
           bool updated(false);
           for (auto it = search_list.cbegin(); it < search_list.cend(); ++it)
@@ -325,7 +486,7 @@ protected:
             if (g[u.getPos()] > u.getCost())
             {
               g[u.getPos()] = u.getCost();
-              parents_[u.getPos()] = u.getParentPos();
+              parents_[u.getPos()] = posToIndex(u.getParentPos());
               open_.push(std::move(u.getPriorityVec()));
               if (queue_size_limit_ > 0 && open_.size() > queue_size_limit_)
                 open_.pop_back();
@@ -338,6 +499,7 @@ protected:
         }  // omp critical
       }
     }  // omp parallel
+    updateStats(ts_start, expansions, open_.size(), exceeded);
 
     if (!found)
     {
@@ -350,40 +512,994 @@ protected:
     }
     return findPath(ss_normalized, e, path);
   }
+  static size_t partition(const Vec& v, const size_t num)
+  {
+    // Scatter neighboring grids to different owners
+    const uint64_t hash = static_cast<uint64_t>(Vec()(v)) * 0x9E3779B97F4A7C15ull;
+    return (hash >> 32) % num;
+  }
+  template <class MODEL>
+  bool searchImplDistributed(
+      SearchGridmap<float>& g,
+      const std::vector<VecWithCost>& sts, const Vec& en,
+      std::list<Vec>& path,
+      const std::shared_ptr<MODEL>& model,
+      std::function<bool(const std::list<Vec>&)> cb_progress,
+      const float cost_leave,
+      const float progress_interval,
+      const bool return_best = false)
+  {
+    if (sts.size() == 0)
+      return false;
+
+    const auto ts_start = Clock::now();
+    auto ts = ts_start;
+
+    Vec e = en;
+    e.cycleUnsigned(g.size());
+    g.clear(std::numeric_limits<float>::max());
+    parents_.clear(NO_PARENT);
+
+    std::vector<VecWithCost> ss_normalized;
+    for (const VecWithCost& st : sts)
+    {
+      if (st.v_ == en)
+        return false;
+
+      Vec s = st.v_;
+      s.cycleUnsigned(g.size());
+      ss_normalized.emplace_back(s, st.c_);
+      g[s] = st.c_;
+    }
+
+    size_t num_threads = 1;
+    // updates[from][to]: updates generated by the thread "from" to the grids owned by the thread "to"
+    std::vector<std::vector<std::vector<GridmapUpdate>>> updates;
+    std::vector<size_t> num_centers;
+    std::vector<float> found_cost;
+    std::vector<Vec> found_pos;
+    std::vector<float> cost_estim_min;
+    std::vector<Vec> better;
+    Vec better_all = ss_normalized[0].v_;
+    float cost_estim_min_all = std::numeric_limits<float>::max();
+    bool found(false);
+    bool finished(false);
+    bool exceeded(false);
+    size_t expansions = 0;
+
+#pragma omp parallel
+    {
+#pragma omp single
+      {
+        num_threads = omp_get_num_threads();
+        opens_.resize(num_threads);
+        for (auto& open : opens_)
+          open.clear();
+        updates.resize(num_threads);
+        for (auto& u : updates)
+          u.resize(num_threads);
+        num_centers.assign(num_threads, 0);
+        found_cost.assign(num_threads, std::numeric_limits<float>::max());
+        found_pos.assign(num_threads, e);
+        cost_estim_min.assign(num_threads, std::numeric_limits<float>::max());
+        better.assign(num_threads, ss_normalized[0].v_);
+
+        for (const VecWithCost& s : ss_normalized)
+        {
+          const float cost_estim = model->costEstim(s.v_, e);
+          opens_[partition(s.v_, num_threads)].emplace(cost_estim + s.c_, s.c_, s.v_);
+          if (cost_estim_min_all > cost_estim)
+          {
+            cost_estim_min_all = cost_estim;
+            better_all = s.v_;
+          }
+        }
+      }  // omp single
+
+      const size_t tid = omp_get_thread_num();
+      const size_t task_num = std::max<size_t>(1, search_task_num_ / num_threads);
+      const size_t queue_size_limit =
+          queue_size_limit_ > 0 ? std::max<size_t>(1, queue_size_limit_ / num_threads) : 0;
+      auto& open = opens_[tid];
+
+      std::vector<PriorityVec> centers;
+      centers.reserve(task_num);
+      std::vector<Vec> dont;
+      dont.reserve(task_num);
+
+      while (true)
+      {
+        // Fetch tasks from the thread local open list
+        centers.clear();
+        while (centers.size() < task_num && open.size() > 0)
+        {
+          PriorityVec center(open.top());
+          open.pop();
+          if (center.p_raw_ > g[center.v_])
+            continue;
+          if (center.v_ == e || center.p_ - center.p_raw_ < cost_leave)
+          {
+            found_cost[tid] = center.p_;
+            found_pos[tid] = center.v_;
+            break;
+          }
+          centers.emplace_back(std::move(center));
+        }
+        num_centers[tid] = centers.size();
+
+#pragma omp barrier
+#pragma omp single
+        {
+          bool has_task(false);
+          float found_cost_min = std::numeric_limits<float>::max();
+          for (size_t i = 0; i < num_threads; ++i)
+          {
+            if (found_cost[i] < found_cost_min)
+            {
+              found_cost_min = found_cost[i];
+              e = found_pos[i];
+              found = true;
+            }
+            if (cost_estim_min[i] < cost_estim_min_all)
+            {
+              cost_estim_min_all = cost_estim_min[i];
+              better_all = better[i];
+            }
+            if (opens_[i].size() > 0)
+              has_task = true;
+          }
+          for (const size_t n : num_centers)
+          {
+            if (n > 0)
+              has_task = true;
+            expansions += n;
+          }
+          if (!found && has_task && isBudgetExceeded(ts_start, expansions))
+            exceeded = true;
+          finished = found || !has_task || exceeded;
+
+          const auto tnow = boost::chrono::high_resolution_clock::now();
+          if (!finished &&
+              boost::chrono::duration<float>(tnow - ts).count() >= progress_interval)
+          {
+            std::list<Vec> path_tmp;
+            ts = tnow;
+            findPath(ss_normalized, better_all, path_tmp);
+            cb_progress(path_tmp);
+          }
+        }  // omp single
+        if (finished)
+          break;
+
+        for (auto& u : updates[tid])
+          u.clear();
+        dont.clear();
+
+        for (const PriorityVec& center : centers)
+        {
+          const Vec& p = center.v_;
+          const float c = center.p_raw_;
+          const float gp = g[p];
+
+          if (center.p_ - c < cost_estim_min[tid])
+          {
+            cost_estim_min[tid] = center.p_ - c;
+            better[tid] = p;
+          }
+
+          const std::vector<Vec>& search_list = model->searchGrids(p, ss_normalized, e);
+
+          bool updated(false);
+          for (auto it = search_list.cbegin(); it < search_list.cend(); ++it)
+          {
+            Vec next = p + *it;
+            next.cycleUnsigned(g.size());
+            if (next.isExceeded(g.size()))
+              continue;
+
+            if (g[next] < gp)
+            {
+              // Skip as this search task has no chance to find better way.
+              continue;
+            }
+
+            const float cost_estim = model->costEstim(next, e);
+            if (cost_estim < 0 || cost_estim == std::numeric_limits<float>::max())
+              continue;
+
+            const float cost = model->cost(p, next, ss_normalized, e);
+            if (cost < 0 || cost == std::numeric_limits<float>::max())
+              continue;
+
+            const float cost_next = c + cost;
+            if (g[next] > cost_next)
+            {
+              updated = true;
+              updates[tid][partition(next, num_threads)].emplace_back(
+                  p, next, cost_next + cost_estim, cost_next);
+            }
+          }
+          if (!updated)
+            dont.push_back(p);
+        }
+#pragma omp barrier
+        // Merge the updates to the grids owned by this thread
+        for (size_t from = 0; from < num_threads; ++from)
+        {
+          for (const GridmapUpdate& u : updates[from][tid])
+          {
+            if (g[u.getPos()] > u.getCost())
+            {
+              g[u.getPos()] = u.getCost();
+              parents_[u.getPos()] = posToIndex(u.getParentPos());
+              open.push(std::move(u.getPriorityVec()));
+              if (queue_size_limit > 0 && open.size() > queue_size_limit)
+                open.pop_back();
+            }
+          }
+        }
+        for (const Vec& p : dont)
+        {
+          g[p] = -1;
+        }
+      }
+    }  // omp parallel
+    size_t open_size = 0;
+    for (const auto& open : opens_)
+      open_size += open.size();
+    updateStats(ts_start, expansions, open_size, exceeded);
+
+    if (!found)
+    {
+      // No fesible path
+      if (return_best)
+      {
+        findPath(ss_normalized, better_all, path);
+      }
+      return false;
+    }
+    return findPath(ss_normalized, e, path);
+  }
+  struct AnytimeGoal
+  {
+    Vec pos_;
+    float cost_;
+  };
+  template <class MODEL>
+  bool searchImplAnytime(
+      SearchGridmap<float>& g,
+      const std::vector<VecWithCost>& sts, const Vec& en,
+      std::list<Vec>& path,
+      const std::shared_ptr<MODEL>& model,
+      std::function<bool(const std::list<Vec>&)> cb_improved,
+      const float cost_leave,
+      const float epsilon_start,
+      const float epsilon_step,
+      const float time_limit,
+      const bool return_best = false)
+  {
+    if (sts.size() == 0)
+      return false;
+
+    const auto ts = boost::chrono::high_resolution_clock::now();
+
+    Vec e = en;
+    e.cycleUnsigned(g.size());
+    g.clear(std::numeric_limits<float>::max());
+    open_.clear();
+    parents_.clear(NO_PARENT);
+    if (closed_.size() != g.size())
+    {
+      closed_.reset(g.size());
+      closed_.clear(0);
+      closed_id_ = 0;
+    }
+    incons_.clear();
+
+    float epsilon = std::max(1.0f, epsilon_start);
+    const float step = std::max(epsilon_step, std::numeric_limits<float>::epsilon());
+
+    AnytimeGoal goal;
+    goal.cost_ = std::numeric_limits<float>::max();
+    Vec better;
+    float cost_estim_min = std::numeric_limits<float>::max();
+
+    std::vector<VecWithCost> ss_normalized;
+    for (const VecWithCost& st : sts)
+    {
+      if (st.v_ == en)
+        return false;
+
+      Vec s = st.v_;
+      s.cycleUnsigned(g.size());
+      ss_normalized.emplace_back(s, st.c_);
+      g[s] = st.c_;
+
+      const float cost_estim = model->costEstim(s, e);
+      if (s == e || cost_estim < cost_leave)
+      {
+        if (st.c_ + cost_estim < goal.cost_)
+        {
+          goal.cost_ = st.c_ + cost_estim;
+          goal.pos_ = s;
+        }
+        continue;
+      }
+      open_.emplace(st.c_ + epsilon * cost_estim, st.c_, s);
+      if (cost_estim_min > cost_estim)
+      {
+        cost_estim_min = cost_estim;
+        better = s;
+      }
+    }
+
+    bool found(false);
+    bool exceeded(false);
+    size_t expansions = 0;
+    while (true)
+    {
+      ++closed_id_;
+      if (closed_id_ == 0)
+      {
+        // Wrapped around
+        closed_.clear(0);
+        closed_id_ = 1;
+      }
+      const float goal_cost_prev = goal.cost_;
+      const bool finished = improvePath(
+          g, ss_normalized, e, model, cost_leave, epsilon, ts, time_limit,
+          goal, better, cost_estim_min, expansions, exceeded);
+
+      if (goal.cost_ < goal_cost_prev)
+      {
+        found = true;
+        std::list<Vec> path_tmp;
+        findPath(ss_normalized, goal.pos_, path_tmp);
+        cb_improved(path_tmp);
+      }
+      if (!finished || epsilon <= 1.0f)
+        break;
+
+      // Move INCONS into OPEN and update the priorities by the new epsilon
+      const float epsilon_prev = epsilon;
+      epsilon = std::max(1.0f, epsilon - step);
+      std::vector<PriorityVec> entries;
+      entries.reserve(open_.size() + incons_.size());
+      while (open_.size() > 0)
+      {
+        entries.push_back(open_.top());
+        open_.pop();
+      }
+      entries.insert(entries.end(), incons_.cbegin(), incons_.cend());
+      incons_.clear();
+      for (const PriorityVec& p : entries)
+      {
+        if (p.p_raw_ > g[p.v_])
+          continue;
+        const float cost_estim = (p.p_ - p.p_raw_) / epsilon_prev;
+        open_.emplace(p.p_raw_ + epsilon * cost_estim, p.p_raw_, p.v_);
+      }
+    }
+    updateStats(ts, expansions, open_.size(), exceeded);
+
+    if (!found)
+    {
+      // No fesible path
+      if (return_best)
+      {
+        findPath(ss_normalized, better, path);
+      }
+      return false;
+    }
+    return findPath(ss_normalized, goal.pos_, path);
+  }
+  // Returns false if timed out or the search budget is exceeded.
+  template <class MODEL>
+  bool improvePath(
+      SearchGridmap<float>& g,
+      const std::vector<VecWithCost>& ss, const Vec& e,
+      const std::shared_ptr<MODEL>& model,
+      const float cost_leave,
+      const float epsilon,
+      const boost::chrono::high_resolution_clock::time_point& ts,
+      const float time_limit,
+      AnytimeGoal& goal,
+      Vec& better,
+      float& cost_estim_min,
+      size_t& expansions,
+      bool& exceeded)
+  {
+    size_t cnt = 0;
+    while (open_.size() > 0)
+    {
+      if (open_.top().p_ >= goal.cost_)
+        return true;
+
+      if ((cnt++ & 0xFF) == 0)
+      {
+        const auto tnow = boost::chrono::high_resolution_clock::now();
+        if (boost::chrono::duration<float>(tnow - ts).count() >= time_limit)
+        {
+          // Reaching the time limit before the first solution is handled as the budget exhaustion,
+          // since the goal is not proven to be unreachable.
+          if (goal.cost_ == std::numeric_limits<float>::max())
+            exceeded = true;
+          return false;
+        }
+        if (isBudgetExceeded(ts, expansions))
+        {
+          exceeded = true;
+          return false;
+        }
+      }
+
+      const PriorityVec center(open_.top());
+      open_.pop();
+      const Vec& p = center.v_;
+      const float c = center.p_raw_;
+      if (c > g[p] || closed_[p] == closed_id_)
+        continue;
+      closed_[p] = closed_id_;
+      ++expansions;
+
+      const float c_estim = (center.p_ - c) / epsilon;
+      if (c_estim < cost_estim_min)
+      {
+        cost_estim_min = c_estim;
+        better = p;
+      }
+
+      const std::vector<Vec>& search_list = model->searchGrids(p, ss, e);
+      for (auto it = search_list.cbegin(); it < search_list.cend(); ++it)
+      {
+        Vec next = p + *it;
+        next.cycleUnsigned(g.size());
+        if (next.isExceeded(g.size()))
+          continue;
+
+        const float cost_estim = model->costEstim(next, e);
+        if (cost_estim < 0 || cost_estim == std::numeric_limits<float>::max())
+          continue;
+
+        const float cost = model->cost(p, next, ss, e);
+        if (cost < 0 || cost == std::numeric_limits<float>::max())
+          continue;
+
+        const float cost_next = c + cost;
+        if (g[next] <= cost_next)
+          continue;
+
+        g[next] = cost_next;
+        parents_[next] = posToIndex(p);
+        if (next == e || cost_estim < cost_leave)
+        {
+          // Goal region is not expanded, same as searchImpl.
+          if (cost_next + cost_estim < goal.cost_)
+          {
+            goal.cost_ = cost_next + cost_estim;
+            goal.pos_ = next;
+          }
+          continue;
+        }
+        if (closed_[next] == closed_id_)
+          incons_.emplace_back(cost_next + epsilon * cost_estim, cost_next, next);
+        else
+          open_.emplace(cost_next + epsilon * cost_estim, cost_next, next);
+      }
+    }
+    return true;
+  }
+  template <class MODEL>
+  bool searchImplIncremental(
+      SearchGridmap<float>& g,
+      const std::vector<VecWithCost>& sts, const Vec& en,
+      std::list<Vec>& path,
+      const std::shared_ptr<MODEL>& model,
+      const float cost_leave,
+      const bool return_best = false)
+  {
+    if (sts.size() == 0)
+      return false;
+
+    const auto ts = Clock::now();
+
+    Vec e = en;
+    e.cycleUnsigned(g.size());
+
+    std::vector<VecWithCost> ss_normalized;
+    for (const VecWithCost& st : sts)
+    {
+      if (st.v_ == en)
+        return false;
+
+      Vec s = st.v_;
+      s.cycleUnsigned(g.size());
+      ss_normalized.emplace_back(s, st.c_);
+    }
+    // Costs in the search tree are relative to the cheapest start,
+    // since adding a common offset to the starts doesn't change the path.
+    float start_cost_min = std::numeric_limits<float>::max();
+    for (const VecWithCost& s : ss_normalized)
+      start_cost_min = std::min(start_cost_min, s.c_);
+    for (VecWithCost& s : ss_normalized)
+      s.c_ -= start_cost_min;
+
+    bool reuse =
+        incremental_valid_ &&
+        e == incremental_goal_ &&
+        cost_leave == incremental_cost_leave_ &&
+        ss_normalized.size() == incremental_starts_.size();
+    // Costs of the starts are given by the continuous pose and may change on every call.
+    // So the search tree is reused if the start grids are unchanged,
+    // and the changed start costs are repaired in the same way as the updated grids.
+    for (size_t i = 0; reuse && i < ss_normalized.size(); ++i)
+    {
+      if (!isStart(incremental_starts_, ss_normalized[i].v_))
+        reuse = false;
+    }
+
+    if (!reuse)
+    {
+      g.clear(std::numeric_limits<float>::max());
+      if (rhs_.size() != g.size())
+      {
+        rhs_.reset(g.size());
+        terminal_.reset(g.size());
+      }
+      rhs_.clear(std::numeric_limits<float>::max());
+      terminal_.clear(TERMINAL_UNKNOWN);
+      parents_.clear(NO_PARENT);
+      open_.clear();
+      incremental_goals_.clear();
+
+      for (const VecWithCost& s : ss_normalized)
+      {
+        rhs_[s.v_] = std::min(rhs_[s.v_], s.c_);
+        pushInconsistent(g, s.v_, e, model);
+      }
+      incremental_starts_ = ss_normalized;
+      incremental_goal_ = e;
+      incremental_cost_leave_ = cost_leave;
+      incremental_valid_ = true;
+    }
+    else
+    {
+      for (const VecWithCost& s : ss_normalized)
+      {
+        const float rhs = startCost(ss_normalized, s.v_);
+        if (rhs_[s.v_] != rhs)
+        {
+          rhs_[s.v_] = rhs;
+          pushInconsistent(g, s.v_, e, model);
+        }
+      }
+      incremental_starts_ = ss_normalized;
+      for (const std::pair<Vec, Vec>& region : updated_regions_)
+      {
+        forEachInRegion(
+            g.size(), region.first, region.second,
+            [this, &g, &ss_normalized, &e, &model](const Vec& p)
+            {
+              if (isStart(ss_normalized, p))
+                return;
+              updateVertex(g, ss_normalized, p, e, model);
+            });
+      }
+      rekeyIncremental(g, e, model);
+    }
+    updated_regions_.clear();
+
+    Vec better = ss_normalized[0].v_;
+    float cost_estim_min = std::numeric_limits<float>::max();
+    bool exceeded(false);
+    size_t expansions = 0;
+    size_t cnt = 0;
+    float checked_goal_cost = -1;
+    float checked_top_key = -1;
+    Vec checked_goal;
+    while (open_.size() > 0)
+    {
+      const float goal_cost = incrementalGoalCost(g);
+      const float top_key = open_.top().p_;
+      if (top_key >= goal_cost)
+      {
+        // Grids having the same key as the goal may be underconsistent ancestors of the goal.
+        // Walking the path is O(path length), so it is rechecked only if the goal or
+        // the key of the open list top is changed since the last check.
+        const Vec& goal = incremental_goals_.top().v_;
+        if (goal_cost != checked_goal_cost || goal != checked_goal || top_key != checked_top_key)
+        {
+          if (isConsistentPath(g, ss_normalized, goal))
+            break;
+          checked_goal_cost = goal_cost;
+          checked_goal = goal;
+          checked_top_key = top_key;
+        }
+      }
+      // Remaining inconsistent grids are kept in the open list and repaired on the next call.
+      if ((cnt++ & 0xFF) == 0 && isBudgetExceeded(ts, expansions))
+      {
+        exceeded = true;
+        break;
+      }
+
+      const PriorityVec center(open_.top());
+      open_.pop();
+      const Vec& p = center.v_;
+      const float gp = g[p];
+      const float rp = rhs_[p];
+      if (gp == rp)
+        continue;
+
+      const float cost_estim = model->costEstim(p, e);
+      const float key = std::min(gp, rp) + cost_estim;
+      if (key > center.p_)
+      {
+        open_.emplace(key, std::min(gp, rp), p);
+        continue;
+      }
+      if (cost_estim < cost_estim_min)
+      {
+        cost_estim_min = cost_estim;
+        better = p;
+      }
+      ++expansions;
+
+      const bool terminal = isTerminal(p, e, cost_leave, model);
+      if (gp > rp)
+      {
+        // Overconsistent: the grid got a better way
+        g[p] = rp;
+        if (terminal)
+        {
+          incremental_goals_.emplace(rp + cost_estim, rp, p);
+          continue;
+        }
+        const std::vector<Vec>& search_list = model->searchGrids(p, ss_normalized, e);
+        for (auto it = search_list.cbegin(); it < search_list.cend(); ++it)
+        {
+          Vec next = p + *it;
+          next.cycleUnsigned(g.size());
+          if (next.isExceeded(g.size()) || isStart(ss_normalized, next))
+            continue;
+          if (rhs_[next] <= rp)
+          {
+            // Skip as this search task has no chance to find better way.
+            continue;
+          }
+
+          const float cost_estim_next = model->costEstim(next, e);
+          if (cost_estim_next < 0 || cost_estim_next == std::numeric_limits<float>::max())
+            continue;
+
+          const float cost = model->cost(p, next, ss_normalized, e);
+          if (cost < 0 || cost == std::numeric_limits<float>::max())
+            continue;
+
+          const float cost_next = rp + cost;
+          if (rhs_[next] > cost_next)
+          {
+            rhs_[next] = cost_next;
+            parents_[next] = posToIndex(p);
+            if (g[next] != cost_next)
+              open_.emplace(cost_next + cost_estim_next, cost_next, next);
+          }
+        }
+      }
+      else
+      {
+        // Underconsistent: the way to the grid became expensive
+        g[p] = std::numeric_limits<float>::max();
+        if (isStart(ss_normalized, p))
+          pushInconsistent(g, p, e, model);
+        else
+          updateVertex(g, ss_normalized, p, e, model);
+        if (terminal)
+          continue;
+
+        const uint32_t index = posToIndex(p);
+        const std::vector<Vec>& search_list = model->searchGrids(p, ss_normalized, e);
+        for (auto it = search_list.cbegin(); it < search_list.cend(); ++it)
+        {
+          Vec next = p + *it;
+          next.cycleUnsigned(g.size());
+          if (next.isExceeded(g.size()) || isStart(ss_normalized, next))
+            continue;
+          if (parents_[next] == index)
+            updateVertex(g, ss_normalized, next, e, model);
+        }
+      }
+    }
+
+    updateStats(ts, expansions, open_.size(), exceeded);
+
+    const float goal_cost = incrementalGoalCost(g);
+    if (exceeded || goal_cost == std::numeric_limits<float>::max())
+    {
+      // No fesible path
+      if (return_best)
+      {
+        findPath(ss_normalized, better, path);
+      }
+      return false;
+    }
+    return findPath(ss_normalized, incremental_goals_.top().v_, path);
+  }
+  static float startCost(const std::vector<VecWithCost>& ss, const Vec& p)
+  {
+    float c = std::numeric_limits<float>::max();
+    for (const VecWithCost& s : ss)
+    {
+      if (s.v_ == p)
+        c = std::min(c, s.c_);
+    }
+    return c;
+  }
+  static bool isStart(const std::vector<VecWithCost>& ss, const Vec& p)
+  {
+    for (const VecWithCost& s : ss)
+    {
+      if (s.v_ == p)
+        return true;
+    }
+    return false;
+  }
+  template <class MODEL>
+  bool isTerminal(
+      const Vec& p, const Vec& e, const float cost_leave,
+      const std::shared_ptr<MODEL>& model)
+  {
+    char& t = terminal_[p];
+    if (t == TERMINAL_UNKNOWN)
+      t = (p == e || model->costEstim(p, e) < cost_leave) ? TERMINAL : NOT_TERMINAL;
+    return t == TERMINAL;
+  }
+  template <class MODEL>
+  void pushInconsistent(
+      const SearchGridmap<float>& g, const Vec& p, const Vec& e,
+      const std::shared_ptr<MODEL>& model)
+  {
+    if (g[p] == rhs_[p])
+      return;
+    const float cost_estim = model->costEstim(p, e);
+    if (cost_estim < 0 || cost_estim == std::numeric_limits<float>::max())
+      return;
+    const float c = std::min(g[p], rhs_[p]);
+    open_.emplace(c + cost_estim, c, p);
+  }
+  // Recalculates the cost to reach the grid from its predecessors.
+  template <class MODEL>
+  void updateVertex(
+      const SearchGridmap<float>& g,
+      const std::vector<VecWithCost>& ss, const Vec& p, const Vec& e,
+      const std::shared_ptr<MODEL>& model)
+  {
+    float rhs = std::numeric_limits<float>::max();
+    uint32_t parent = NO_PARENT;
+    const float cost_estim = model->costEstim(p, e);
+    if (cost_estim >= 0 && cost_estim != std::numeric_limits<float>::max())
+    {
+      const std::vector<Vec> search_list = model->searchGridsReverse(p, ss, e);
+      for (const Vec& d : search_list)
+      {
+        Vec prev = p + d;
+        prev.cycleUnsigned(g.size());
+        if (prev.isExceeded(g.size()))
+          continue;
+
+        // Grids with finite g are already visited and their terminal flags are known.
+        const float gp = g[prev];
+        if (gp == std::numeric_limits<float>::max() || terminal_[prev] == TERMINAL)
+          continue;
+
+        const float cost = model->cost(prev, p, ss, e);
+        if (cost < 0 || cost == std::numeric_limits<float>::max())
+          continue;
+
+        if (gp + cost < rhs)
+        {
+          rhs = gp + cost;
+          parent = posToIndex(prev);
+        }
+      }
+    }
+    rhs_[p] = rhs;
+    parents_[p] = parent;
+    pushInconsistent(g, p, e, model);
+  }
+  // Heuristic may be changed between the calls.
+  template <class MODEL>
+  void rekeyIncremental(
+      const SearchGridmap<float>& g, const Vec& e,
+      const std::shared_ptr<MODEL>& model)
+  {
+    std::vector<uint32_t> indexes;
+    indexes.reserve(open_.size());
+    while (open_.size() > 0)
+    {
+      const Vec& p = open_.top().v_;
+      if (g[p] != rhs_[p])
+        indexes.push_back(posToIndex(p));
+      open_.pop();
+    }
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+    for (const uint32_t index : indexes)
+      pushInconsistent(g, indexToPos(index), e, model);
+
+    indexes.clear();
+    while (incremental_goals_.size() > 0)
+    {
+      const PriorityVec& goal = incremental_goals_.top();
+      if (g[goal.v_] == goal.p_raw_ && g[goal.v_] == rhs_[goal.v_])
+        indexes.push_back(posToIndex(goal.v_));
+      incremental_goals_.pop();
+    }
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+    for (const uint32_t index : indexes)
+    {
+      const Vec p = indexToPos(index);
+      incremental_goals_.emplace(g[p] + model->costEstim(p, e), g[p], p);
+    }
+  }
+  // Returns the cost of the best consistent grid in the goal region.
+  float incrementalGoalCost(const SearchGridmap<float>& g)
+  {
+    while (incremental_goals_.size() > 0)
+    {
+      const PriorityVec& goal = incremental_goals_.top();
+      if (g[goal.v_] == goal.p_raw_ && g[goal.v_] == rhs_[goal.v_])
+        return goal.p_;
+      incremental_goals_.pop();
+    }
+    return std::numeric_limits<float>::max();
+  }
+  bool isConsistentPath(const SearchGridmap<float>& g, const std::vector<VecWithCost>& ss, const Vec& e) const
+  {
+    Vec n = e;
+    Vec n_check = e;
+    size_t steps = 0;
+    size_t steps_check = 1;
+    while (g[n] == rhs_[n])
+    {
+      if (isStart(ss, n))
+        return true;
+      const uint32_t parent = parents_[n];
+      if (parent == NO_PARENT)
+        return false;
+
+      n = indexToPos(parent);
+      if (n == n_check)
+        return false;
+      if (++steps == steps_check)
+      {
+        n_check = n;
+        steps_check *= 2;
+        steps = 0;
+      }
+    }
+    return false;
+  }
+  template <typename FUNC>
+  static void forEachInRegion(const Vec& size, const Vec& min, const Vec& max, FUNC func)
+  {
+    Vec lo = min;
+    Vec hi = max;
+    for (int i = 0; i < NONCYCLIC; ++i)
+    {
+      lo[i] = std::max(0, lo[i]);
+      hi[i] = std::min(size[i], hi[i]);
+      if (lo[i] >= hi[i])
+        return;
+    }
+    for (int i = NONCYCLIC; i < DIM; ++i)
+    {
+      hi[i] = std::min(hi[i], lo[i] + size[i]);
+      if (lo[i] >= hi[i])
+        return;
+    }
+    Vec d = lo;
+    while (true)
+    {
+      Vec p = d;
+      p.cycleUnsigned(size);
+      func(p);
+
+      int i = 0;
+      for (; i < DIM; ++i)
+      {
+        if (++d[i] < hi[i])
+          break;
+        d[i] = lo[i];
+      }
+      if (i == DIM)
+        return;
+    }
+  }
+  uint32_t posToIndex(const Vec& p) const
+  {
+    uint32_t index = p[DIM - 1];
+    for (int i = DIM - 2; i >= 0; --i)
+      index = index * g_.size()[i] + p[i];
+    return index;
+  }
+  Vec indexToPos(uint32_t index) const
+  {
+    Vec p;
+    for (int i = 0; i < DIM; ++i)
+    {
+      p[i] = index % g_.size()[i];
+      index /= g_.size()[i];
+    }
+    return p;
+  }
   bool findPath(const std::vector<VecWithCost>& ss, const Vec& e, std::list<Vec>& path) const
   {
-    std::unordered_map<Vec, Vec, Vec> parents = parents_;
     Vec n = e;
+    // Brent's cycle detection to avoid endless loop without recording visited grids
+    Vec n_check = e;
+    size_t steps = 0;
+    size_t steps_check = 1;
     while (true)
     {
       path.push_front(n);
 
-      bool found(false);
       for (const VecWithCost& s : ss)
       {
         if (n == s.v_)
-        {
-          found = true;
-          break;
-        }
+          return true;
       }
-      if (found)
-        break;
-      if (parents.find(n) == parents.end())
+      const uint32_t parent = parents_[n];
+      if (parent == NO_PARENT)
         return false;
 
-      const Vec child = n;
-      n = parents[child];
-      parents.erase(child);
+      n = indexToPos(parent);
+      if (n == n_check)
+        return false;
+      if (++steps == steps_check)
+      {
+        n_check = n;
+        steps_check *= 2;
+        steps = 0;
+      }
     }
-    return true;
   }
 
-  Gridmap<float> g_;
-  std::unordered_map<Vec, Vec, Vec> parents_;
-  reservable_priority_queue<PriorityVec> open_;
+  // Parent of each grid is stored as the serialized index of the parent grid.
+  static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+  SearchGridmap<float> g_;
+  SearchGridmap<uint32_t> parents_;
+  OPEN_LIST<PriorityVec> open_;
+  std::vector<OPEN_LIST<PriorityVec>> opens_;
   size_t queue_size_limit_;
   size_t search_task_num_;
+  bool distributed_search_;
+  float budget_time_;
+  size_t budget_expansions_;
+  SearchStats stats_;
+
+  // Anytime search
+  SearchGridmap<uint32_t> closed_;
+  uint32_t closed_id_;
+  std::vector<PriorityVec> incons_;
+
+  // Incremental search
+  enum TerminalFlag : char
+  {
+    TERMINAL_UNKNOWN = 0,
+    NOT_TERMINAL,
+    TERMINAL,
+  };
+  SearchGridmap<float> rhs_;
+  SearchGridmap<char> terminal_;
+  reservable_priority_queue<PriorityVec> incremental_goals_;
+  std::vector<VecWithCost> incremental_starts_;
+  Vec incremental_goal_;
+  float incremental_cost_leave_;
+  bool incremental_valid_;
+  std::vector<std::pair<Vec, Vec>> updated_regions_;
 };
 }  // namespace planner_cspace
 
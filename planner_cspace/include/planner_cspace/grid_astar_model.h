@@ -63,6 +63,17 @@ public:
       const Vec& cur, const Vec& next) const = 0;
   virtual const std::vector<Vec>& searchGrids(
       const Vec& cur, const std::vector<VecWithCost>& start, const Vec& goal) const = 0;
+  // Relative positions of the grids which may have cur in their searchGrids.
+  // Used by the incremental search to enumerate predecessors.
+  // Default implementation assumes that the search grids are symmetric.
+  virtual std::vector<Vec> searchGridsReverse(
+      const Vec& cur, const std::vector<VecWithCost>& start, const Vec& goal) const
+  {
+    std::vector<Vec> ret = searchGrids(cur, start, goal);
+    for (Vec& d : ret)
+      d = Vec() - d;
+    return ret;
+  }
 };
 }  // namespace planner_cspace
 
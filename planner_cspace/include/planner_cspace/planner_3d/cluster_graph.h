@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_CLUSTER_GRAPH_H
+#define PLANNER_CSPACE_PLANNER_3D_CLUSTER_GRAPH_H
+
+#include <vector>
+
+#include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/grid_astar.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// Abstract graph of the rough costmap for the hierarchical path planning (HPA*).
+// The map is divided into square clusters. Entrances are placed on the free segments
+// of the cluster borders and connected by the costs of the paths inside the clusters.
+// The corridor, which is the set of the clusters along the abstract path,
+// limits the region of the precise cost calculation.
+class ClusterGraph
+{
+public:
+  using Astar = GridAstar<3, 2>;
+  using Vec = Astar::Vec;
+  using Vecf = Astar::Vecf;
+  using Rough = Astar::Gridmap<char, 0x80>;
+
+  struct Params
+  {
+    // Same as DistanceMap::Params
+    Vecf euclid_cost;
+    float weight_costmap;
+    float linear_resolution;
+  };
+
+protected:
+  // Transition between the neighboring clusters across the border.
+  struct Transition
+  {
+    // Position along the border
+    int pos_;
+    // Cost to cross the border
+    float cost_;
+
+    bool operator==(const Transition& b) const
+    {
+      return pos_ == b.pos_ && cost_ == b.cost_;
+    }
+  };
+  struct Cluster
+  {
+    // Position of the entrance nodes ordered as +x, +y, -x, -y borders
+    std::vector<Vec> nodes_;
+    // Costs between the nodes (row major)
+    std::vector<float> costs_;
+  };
+
+  Params p_;
+  Vec size_;
+  int cluster_bit_;
+  int cluster_size_;
+  Vec num_clusters_;
+  // Transitions on the borders between the cluster and +x and +y neighbors
+  std::vector<std::vector<Transition>> borders_x_;
+  std::vector<std::vector<Transition>> borders_y_;
+  std::vector<Cluster> clusters_;
+  std::vector<char> corridor_;
+  std::vector<Vec> path_;
+  float path_cost_;
+
+  int clusterIndex(const int cx, const int cy) const
+  {
+    return cy * num_clusters_[0] + cx;
+  }
+  float stepCost(const Rough& cm_rough, const Vec& p, const Vec& d) const;
+  void updateBorder(const Rough& cm_rough, const int cx, const int cy, const bool along_x, bool& changed);
+  void updateNodes(const int cx, const int cy);
+  // Calculates the costs from the position to the given targets inside the cluster.
+  void searchCluster(
+      const Rough& cm_rough, const int cx, const int cy, const Vec& s,
+      const std::vector<Vec>& targets, std::vector<float>& costs) const;
+  void updateCluster(const Rough& cm_rough, const int cx, const int cy);
+
+public:
+  ClusterGraph();
+  void reset(const Vec& size, const int cluster_size, const Params& p);
+  // Rebuilds the clusters overlapping the region [min, max).
+  void update(const Rough& cm_rough, const Vec& min, const Vec& max);
+  // Searches the abstract graph from s to e and updates the corridor.
+  // Returns false if the abstract path is not found.
+  bool updateCorridor(const Rough& cm_rough, const Vec& s, const Vec& e, const int margin = 1);
+  void clearCorridor();
+
+  inline bool inCorridor(const Vec& p) const
+  {
+    return corridor_[clusterIndex(p[0] >> cluster_bit_, p[1] >> cluster_bit_)];
+  }
+  inline int clusterSize() const
+  {
+    return cluster_size_;
+  }
+  // Entrance nodes along the abstract path including the start and the goal.
+  inline const std::vector<Vec>& path() const
+  {
+    return path_;
+  }
+  inline float pathCost() const
+  {
+    return path_cost_;
+  }
+  size_t numNodes() const;
+};
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_CLUSTER_GRAPH_H
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_COST_REDUCTION_H
+#define PLANNER_CSPACE_PLANNER_3D_COST_REDUCTION_H
+
+#include <climits>
+
+#if defined(__SSE2__) && CHAR_MIN < 0
+#define PLANNER_CSPACE_COST_REDUCTION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// Returns the minimum of init and the n costs.
+inline char minCost(const char* c, const int n, const char init)
+{
+  int i = 0;
+  char cost_min = init;
+#ifdef PLANNER_CSPACE_COST_REDUCTION_SSE2
+  if (n >= 16)
+  {
+    // SSE2 has only unsigned 8-bit min. Flipping the sign bit keeps the order.
+    const __m128i sign = _mm_set1_epi8(-128);
+    __m128i vmin = _mm_set1_epi8(static_cast<char>(init ^ -128));
+    for (; i + 16 <= n; i += 16)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i));
+      vmin = _mm_min_epu8(vmin, _mm_xor_si128(v, sign));
+    }
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 8));
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 4));
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 2));
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 1));
+    cost_min = static_cast<char>((_mm_cvtsi128_si32(vmin) & 0xFF) ^ 0x80);
+  }
+#endif  // PLANNER_CSPACE_COST_REDUCTION_SSE2
+  for (; i < n; ++i)
+  {
+    if (c[i] < cost_min)
+      cost_min = c[i];
+  }
+  return cost_min;
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_COST_REDUCTION_H
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_DISTANCE_MAP_H
+#define PLANNER_CSPACE_PLANNER_3D_DISTANCE_MAP_H
+
+#include <vector>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/reservable_priority_queue.h>
+#include <planner_cspace/planner_3d/cluster_graph.h>
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// Fills the 2D cost-to-goal map used as the heuristic of the 3D search.
+class DistanceMap
+{
+public:
+  using Astar = GridAstar<3, 2>;
+  using Vec = Astar::Vec;
+  using Vecf = Astar::Vecf;
+  using Gridmap = Astar::Gridmap<float>;
+  using Rough = Astar::Gridmap<char, 0x80>;
+
+  struct Params
+  {
+    Vecf euclid_cost;
+    int range;
+    int local_range;
+    int longcut_range;
+    float weight_costmap;
+    float weight_remembered;
+    int num_cost_estim_task;
+    // Bucket width of the delta-stepping. Zero uses the priority queue based search.
+    float delta_stepping_width;
+  };
+
+protected:
+  struct SearchDiffs
+  {
+    Vec d;
+    std::vector<Vec> pos;
+    float grid_to_len;
+    float euclid_cost;
+  };
+
+  const Rough& cm_rough_;
+  const CostmapBBF& bbf_costmap_;
+  costmap_cspace_msgs::MapMetaData3D map_info_;
+  Params p_;
+  std::vector<SearchDiffs> search_diffs_;
+
+  // Calculates the cost from p to p + ds.d. Returns false if the move collides.
+  bool edgeCost(const Vec& p, const SearchDiffs& ds, float& cost) const;
+  // Returns the reference to the cost of the start which never reaches the cutoff if s is out of the map.
+  const float& startCost(Gridmap& g, const Vec& s) const;
+  // Calculates the minimum cost of q through the neighbors.
+  float minIncomingCost(const Gridmap& g, const Vec& q, const ClusterGraph* corridor) const;
+  void fillPriorityQueue(
+      reservable_priority_queue<Astar::PriorityVec>& open,
+      Gridmap& g,
+      const Vec& s,
+      const ClusterGraph* corridor) const;
+  void fillDeltaStepping(
+      reservable_priority_queue<Astar::PriorityVec>& open,
+      Gridmap& g,
+      const Vec& s,
+      const ClusterGraph* corridor) const;
+
+public:
+  DistanceMap(const Rough& cm_rough, const CostmapBBF& bbf_costmap);
+  void init(const costmap_cspace_msgs::MapMetaData3D& map_info, const Params& p);
+  const Params& params() const
+  {
+    return p_;
+  }
+  // Propagates the costs from the cells in the open list until the cost of the start is determined.
+  // If the corridor is given, the cells outside the corridor are left unchanged.
+  // If s is out of the map, the costs are propagated to the whole reachable region.
+  void fill(
+      reservable_priority_queue<Astar::PriorityVec>& open,
+      Gridmap& g,
+      const Vec& s,
+      const ClusterGraph* corridor = nullptr) const;
+  // Repairs the costs after the rough costmap is changed in the region [min, max).
+  // The open list must contain the remaining entries of the previous fill() or update().
+  // Only the grids which lost their path or got a cheaper path are recalculated.
+  void update(
+      reservable_priority_queue<Astar::PriorityVec>& open,
+      Gridmap& g,
+      const Vec& s,
+      const Vec& e,
+      const Vec& min,
+      const Vec& max,
+      const ClusterGraph* corridor = nullptr) const;
+};
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_DISTANCE_MAP_H
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_DISTANCE_MAP_WORKER_H
+#define PLANNER_CSPACE_PLANNER_3D_DISTANCE_MAP_WORKER_H
+
+#include <atomic>
+#include <limits>
+#include <thread>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/reservable_priority_queue.h>
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// Fills the cost-to-goal map in a background thread.
+// The costmaps are copied on start() so that the callers can keep updating them.
+class DistanceMapWorker
+{
+public:
+  using Astar = GridAstar<3, 2>;
+  using Vec = Astar::Vec;
+  using Gridmap = DistanceMap::Gridmap;
+  using Rough = DistanceMap::Rough;
+  using OpenList = reservable_priority_queue<Astar::PriorityVec>;
+
+protected:
+  Rough cm_rough_;
+  CostmapBBF bbf_costmap_;
+  DistanceMap distance_map_;
+  Gridmap g_;
+  OpenList open_;
+  std::thread thread_;
+  std::atomic<bool> done_;
+
+public:
+  DistanceMapWorker()
+    : distance_map_(cm_rough_, bbf_costmap_)
+    , done_(false)
+  {
+  }
+  ~DistanceMapWorker()
+  {
+    wait();
+  }
+  void init(const costmap_cspace_msgs::MapMetaData3D& map_info, const DistanceMap::Params& p)
+  {
+    wait();
+    distance_map_.init(map_info, p);
+  }
+  // Starts filling the costs from e until the cost of s is determined.
+  // The previous task is waited if running.
+  void start(
+      const Rough& cm_rough, const CostmapBBF& bbf_costmap,
+      const Vec& s, const Vec& e, const float e_cost)
+  {
+    wait();
+    cm_rough_ = cm_rough;
+    bbf_costmap_ = bbf_costmap;
+    g_.reset(cm_rough.size());
+    g_.clear(std::numeric_limits<float>::max());
+    open_.clear();
+    g_[e] = e_cost;
+    open_.emplace(e_cost, e_cost, e);
+    done_ = false;
+    thread_ = std::thread(
+        [this, s]
+        {
+          distance_map_.fill(open_, g_, s);
+          done_ = true;
+        });
+  }
+  // Returns true if the task is finished and the result is available.
+  bool done() const
+  {
+    return done_;
+  }
+  void wait()
+  {
+    if (thread_.joinable())
+      thread_.join();
+  }
+  // Copies the result. The remaining open list is also copied to continue the search.
+  void get(Gridmap& g, OpenList& open)
+  {
+    wait();
+    g = g_;
+    open = open_;
+  }
+};
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_DISTANCE_MAP_WORKER_H
@@ -30,7 +30,9 @@
 #ifndef PLANNER_CSPACE_PLANNER_3D_GRID_ASTAR_MODEL_H
 #define PLANNER_CSPACE_PLANNER_3D_GRID_ASTAR_MODEL_H
 
+#include <array>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -39,6 +41,7 @@
 #include <planner_cspace/blockmem_gridmap.h>
 #include <planner_cspace/cyclic_vec.h>
 #include <planner_cspace/grid_astar_model.h>
+#include <planner_cspace/planner_3d/lethal_mask.h>
 #include <planner_cspace/planner_3d/motion_cache.h>
 #include <planner_cspace/planner_3d/path_interpolator.h>
 #include <planner_cspace/planner_3d/rotation_cache.h>
@@ -66,12 +69,32 @@ public:
   float angle_resolution_aspect_;
 };
 
-class GridAstarModel3D : public GridAstarModelBase<3, 2>
+// Gridmaps accessed through the virtual interface.
+struct GridAstarModel3DVirtualGridmaps
+{
+  using CostEstim = BlockMemGridmapBase<float, 3, 2>;
+  using Costmap = BlockMemGridmapBase<char, 3, 2>;
+  using Hysteresis = BlockMemGridmapBase<char, 3, 2>;
+  using Rough = BlockMemGridmapBase<char, 3, 2>;
+};
+// Concrete gridmaps used in planner_3d.
+// Accesses to them are inlined into the cost calculation.
+// Costmap and Hysteresis share the layout to use the same cell offsets of MotionCache.
+struct GridAstarModel3DPlannerGridmaps
+{
+  using CostEstim = BlockMemGridmap<float, 3, 2, 0x20>;
+  using Costmap = BlockMemGridmap<char, 3, 2, 0x40>;
+  using Hysteresis = BlockMemGridmap<char, 3, 2, 0x40>;
+  using Rough = BlockMemGridmap<char, 3, 2, 0x80>;
+};
+
+// Model functions are final to be devirtualized when GridAstar is called with the concrete model type.
+template <class GRIDMAPS = GridAstarModel3DVirtualGridmaps>
+class GridAstarModel3DT : public GridAstarModelBase<3, 2>
 {
 public:
-  friend class GridAstarModel2D;
-  using Ptr = std::shared_ptr<GridAstarModel3D>;
-  using ConstPtr = std::shared_ptr<const GridAstarModel3D>;
+  using Ptr = std::shared_ptr<GridAstarModel3DT>;
+  using ConstPtr = std::shared_ptr<const GridAstarModel3DT>;
   using Vec = CyclicVecInt<3, 2>;
   using Vecf = CyclicVecFloat<3, 2>;
 
@@ -83,58 +106,98 @@ protected:
   Vecf euclid_cost_coef_;
   Vecf resolution_;
   std::vector<std::vector<Vec>> motion_primitives_;
+  std::vector<std::vector<Vec>> motion_primitives_reverse_;
+  float motion_primitives_len_max_;
   std::vector<Vec> search_list_rough_;
   int local_range_;
-  BlockMemGridmapBase<float, 3, 2>& cost_estim_cache_;
-  BlockMemGridmapBase<char, 3, 2>& cm_;
-  BlockMemGridmapBase<char, 3, 2>& cm_hyst_;
-  BlockMemGridmapBase<char, 3, 2>& cm_rough_;
+  typename GRIDMAPS::CostEstim& cost_estim_cache_;
+  typename GRIDMAPS::Costmap& cm_;
+  typename GRIDMAPS::Hysteresis& cm_hyst_;
+  typename GRIDMAPS::Rough& cm_rough_;
+  const LethalMask* cm_mask_;
   const CostCoeff& cc_;
   int range_;
   RotationCache rot_cache_;
   MotionCache motion_cache_;
-  MotionCache motion_cache_linear_;
   Vec min_boundary_;
   Vec max_boundary_;
   std::array<float, 1024> euclid_cost_lin_cache_;
 
+  // Motion primitives are used from the grid if true, otherwise search_list_rough_.
+  bool isLocal(const Vec& p, const std::vector<VecWithCost>& ss) const;
+
 public:
-  explicit GridAstarModel3D(
+  explicit GridAstarModel3DT(
       const costmap_cspace_msgs::MapMetaData3D& map_info,
       const Vecf& euclid_cost_coef,
       const int local_range,
-      BlockMemGridmapBase<float, 3, 2>& cost_estim_cache,
-      BlockMemGridmapBase<char, 3, 2>& cm,
-      BlockMemGridmapBase<char, 3, 2>& cm_hyst,
-      BlockMemGridmapBase<char, 3, 2>& cm_rough,
+      typename GRIDMAPS::CostEstim& cost_estim_cache,
+      typename GRIDMAPS::Costmap& cm,
+      typename GRIDMAPS::Hysteresis& cm_hyst,
+      typename GRIDMAPS::Rough& cm_rough,
       const CostCoeff& cc,
-      const int range);
+      const int range,
+      const std::string& motion_cache_dir = std::string());
   void enableHysteresis(const bool enable);
+  // Motions hitting lethal cells are rejected by the bitmask before summing the costs if set.
+  // The mask must be kept consistent with cm.
+  void setLethalMask(const LethalMask* cm_mask);
   void createEuclidCostCache();
   float euclidCost(const Vec& v) const;
   float euclidCostRough(const Vec& v) const;
   float cost(
-      const Vec& cur, const Vec& next, const std::vector<VecWithCost>& start, const Vec& goal) const override;
+      const Vec& cur, const Vec& next, const std::vector<VecWithCost>& start, const Vec& goal) const final;
 
   float costEstim(
-      const Vec& cur, const Vec& goal) const override;
+      const Vec& cur, const Vec& goal) const final;
   const std::vector<Vec>& searchGrids(
       const Vec& p,
       const std::vector<VecWithCost>& ss,
-      const Vec& es) const override;
+      const Vec& es) const final;
+  std::vector<Vec> searchGridsReverse(
+      const Vec& p,
+      const std::vector<VecWithCost>& ss,
+      const Vec& es) const final;
 };
 
-class GridAstarModel2D : public GridAstarModelBase<3, 2>
+// 2D model on the rough costmap.
+// It has its own linear motion cache and doesn't require the 3D motion cache of GridAstarModel3DT.
+template <class GRIDMAPS = GridAstarModel3DVirtualGridmaps>
+class GridAstarModel2DT : public GridAstarModelBase<3, 2>
 {
 public:
-  using Ptr = std::shared_ptr<GridAstarModel2D>;
-  const GridAstarModel3D::ConstPtr base_;
+  using Ptr = std::shared_ptr<GridAstarModel2DT>;
+  using Vec = CyclicVecInt<3, 2>;
+  using Vecf = CyclicVecFloat<3, 2>;
 
-  inline explicit GridAstarModel2D(const GridAstarModel3D::ConstPtr base)
-    : base_(base)
-  {
-  }
+protected:
+  costmap_cspace_msgs::MapMetaData3D map_info_;
+  Vecf euclid_cost_coef_;
+  typename GRIDMAPS::CostEstim& cost_estim_cache_;
+  typename GRIDMAPS::Rough& cm_rough_;
+  const LethalMask* cm_rough_mask_;
+  const CostCoeff& cc_;
+  int range_;
+  // Cost estimation cache is used as the heuristic instead of the euclidean distance if true.
+  bool use_cost_estim_cache_;
+  MotionCache motion_cache_linear_;
+  std::vector<Vec> search_list_rough_;
+  std::array<float, 1024> euclid_cost_lin_cache_;
 
+public:
+  explicit GridAstarModel2DT(
+      const costmap_cspace_msgs::MapMetaData3D& map_info,
+      const Vecf& euclid_cost_coef,
+      typename GRIDMAPS::CostEstim& cost_estim_cache,
+      typename GRIDMAPS::Rough& cm_rough,
+      const CostCoeff& cc,
+      const int range,
+      const bool use_cost_estim_cache = false,
+      const std::string& motion_cache_dir = std::string());
+  // Motions hitting lethal cells are rejected by the bitmask before summing the costs if set.
+  // The mask must be kept consistent with cm_rough.
+  void setLethalMask(const LethalMask* cm_rough_mask);
+  float euclidCostRough(const Vec& v) const;
   float cost(
       const Vec& cur, const Vec& next, const std::vector<VecWithCost>& start, const Vec& goal) const final;
   float costEstim(
@@ -142,6 +205,13 @@ public:
   const std::vector<Vec>& searchGrids(
       const Vec& cur, const std::vector<VecWithCost>& start, const Vec& goal) const final;
 };
+
+// Models with the virtual gridmaps are explicitly instantiated in grid_astar_model_3dof.cpp.
+// Models with the concrete gridmaps are instantiated by including grid_astar_model_impl.h.
+using GridAstarModel3D = GridAstarModel3DT<GridAstarModel3DVirtualGridmaps>;
+using GridAstarModel2D = GridAstarModel2DT<GridAstarModel3DVirtualGridmaps>;
+using GridAstarModel3DPlanner = GridAstarModel3DT<GridAstarModel3DPlannerGridmaps>;
+using GridAstarModel2DPlanner = GridAstarModel2DT<GridAstarModel3DPlannerGridmaps>;
 }  // namespace planner_3d
 }  // namespace planner_cspace
 
@@ -0,0 +1,512 @@
+/*
+ * Copyright (c) 2019-2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_GRID_ASTAR_MODEL_IMPL_H
+#define PLANNER_CSPACE_PLANNER_3D_GRID_ASTAR_MODEL_IMPL_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/cyclic_vec.h>
+#include <planner_cspace/planner_3d/grid_astar_model.h>
+#include <planner_cspace/planner_3d/motion_cache.h>
+#include <planner_cspace/planner_3d/motion_primitive_builder.h>
+#include <planner_cspace/planner_3d/path_interpolator.h>
+#include <planner_cspace/planner_3d/rotation_cache.h>
+
+// Definitions of GridAstarModel3DT and GridAstarModel2DT.
+// Include this file to instantiate the models with the concrete gridmaps,
+// so that cost(), costEstim() and searchGrids() can be inlined into the search loop.
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// Sums the costs of the cells swept by the motion through the virtual gridmap interface.
+template <class COSTMAP, class HYSTERESIS>
+inline bool sumSweptCost(
+    const MotionCache::Page& page, const CyclicVecInt<3, 2>& cur,
+    const COSTMAP& cm, const HYSTERESIS* cm_hyst,
+    int& sum, int& sum_hyst)
+{
+  sum = 0;
+  sum_hyst = 0;
+  for (const auto& pos_diff : page.getMotion())
+  {
+    const CyclicVecInt<3, 2> pos(
+        cur[0] + pos_diff[0], cur[1] + pos_diff[1], pos_diff[2]);
+    const auto c = cm[pos];
+    if (c > 99)
+      return false;
+    sum += c;
+
+    if (cm_hyst)
+      sum_hyst += (*cm_hyst)[pos];
+  }
+  return true;
+}
+
+// Concrete gridmaps are directly read by the vectorized kernel.
+template <int COSTMAP_BLOCK_WIDTH, int HYSTERESIS_BLOCK_WIDTH>
+inline bool sumSweptCost(
+    const MotionCache::Page& page, const CyclicVecInt<3, 2>& cur,
+    const BlockMemGridmap<char, 3, 2, COSTMAP_BLOCK_WIDTH>& cm,
+    const BlockMemGridmap<char, 3, 2, HYSTERESIS_BLOCK_WIDTH>* cm_hyst,
+    int& sum, int& sum_hyst)
+{
+  const MotionCache::GridmapView view(cm);
+  if (!cm_hyst)
+    return page.sumCost(cur[0], cur[1], view, nullptr, sum, sum_hyst);
+
+  const MotionCache::GridmapView view_hyst(*cm_hyst);
+  return page.sumCost(cur[0], cur[1], view, &view_hyst, sum, sum_hyst);
+}
+// Relative positions of the grids within the range on the 2D plane.
+inline std::vector<CyclicVecInt<3, 2>> roughSearchList(const int range)
+{
+  std::vector<CyclicVecInt<3, 2>> search_list;
+  CyclicVecInt<3, 2> d;
+  for (d[0] = -range; d[0] <= range; d[0]++)
+  {
+    for (d[1] = -range; d[1] <= range; d[1]++)
+    {
+      if (d.sqlen() > range * range)
+        continue;
+      d[2] = 0;
+      search_list.push_back(d);
+    }
+  }
+  return search_list;
+}
+
+template <class GRIDMAPS>
+GridAstarModel3DT<GRIDMAPS>::GridAstarModel3DT(
+    const costmap_cspace_msgs::MapMetaData3D& map_info,
+    const Vecf& euclid_cost_coef,
+    const int local_range,
+    typename GRIDMAPS::CostEstim& cost_estim_cache,
+    typename GRIDMAPS::Costmap& cm,
+    typename GRIDMAPS::Hysteresis& cm_hyst,
+    typename GRIDMAPS::Rough& cm_rough,
+    const CostCoeff& cc,
+    const int range,
+    const std::string& motion_cache_dir)
+  : hysteresis_(false)
+  , map_info_(map_info)
+  , euclid_cost_coef_(euclid_cost_coef)
+  , resolution_(
+        1.0f / map_info.linear_resolution,
+        1.0f / map_info.linear_resolution,
+        1.0f / map_info.angular_resolution)
+  , local_range_(local_range)
+  , cost_estim_cache_(cost_estim_cache)
+  , cm_(cm)
+  , cm_hyst_(cm_hyst)
+  , cm_rough_(cm_rough)
+  , cm_mask_(nullptr)
+  , cc_(cc)
+  , range_(range)
+{
+  rot_cache_.reset(map_info_.linear_resolution, map_info_.angular_resolution, range_);
+
+  motion_cache_.reset(
+      map_info_.linear_resolution,
+      map_info_.angular_resolution,
+      range_,
+      cm_.getAddressor(),
+      motion_cache_dir);
+
+  // Make boundary check threshold
+  min_boundary_ = motion_cache_.getMaxRange();
+  max_boundary_ =
+      Vec(static_cast<int>(map_info_.width),
+          static_cast<int>(map_info_.height),
+          static_cast<int>(map_info_.angle)) -
+      min_boundary_;
+  ROS_INFO("x:%d, y:%d grids around the boundary is ignored on path search", min_boundary_[0], min_boundary_[1]);
+
+  createEuclidCostCache();
+
+  motion_primitives_ = MotionPrimitiveBuilder::build(map_info_, cc_, range_);
+  motion_primitives_reverse_.clear();
+  motion_primitives_reverse_.resize(map_info_.angle);
+  motion_primitives_len_max_ = 0;
+  for (size_t yaw = 0; yaw < motion_primitives_.size(); ++yaw)
+  {
+    for (const Vec& prim : motion_primitives_[yaw])
+    {
+      Vec next(0, 0, static_cast<int>(yaw) + prim[2]);
+      next.cycleUnsigned(map_info_.angle);
+      motion_primitives_reverse_[next[2]].push_back(Vec() - prim);
+      motion_primitives_len_max_ = std::max(motion_primitives_len_max_, prim.len());
+    }
+  }
+  search_list_rough_ = roughSearchList(range_);
+  path_interpolator_.reset(map_info_.angular_resolution, range_);
+}
+
+template <class GRIDMAPS>
+void GridAstarModel3DT<GRIDMAPS>::enableHysteresis(const bool enable)
+{
+  hysteresis_ = enable;
+}
+template <class GRIDMAPS>
+void GridAstarModel3DT<GRIDMAPS>::setLethalMask(const LethalMask* cm_mask)
+{
+  cm_mask_ = cm_mask;
+}
+template <class GRIDMAPS>
+void GridAstarModel3DT<GRIDMAPS>::createEuclidCostCache()
+{
+  for (int rootsum = 0;
+       rootsum < static_cast<int>(euclid_cost_lin_cache_.size()); ++rootsum)
+  {
+    euclid_cost_lin_cache_[rootsum] = std::sqrt(rootsum) * euclid_cost_coef_[0];
+  }
+}
+template <class GRIDMAPS>
+inline float GridAstarModel3DT<GRIDMAPS>::euclidCost(const Vec& v) const
+{
+  float cost = euclidCostRough(v);
+
+  int angle = v[2];
+  while (angle > static_cast<int>(map_info_.angle) / 2)
+    angle -= static_cast<int>(map_info_.angle);
+  while (angle < -static_cast<int>(map_info_.angle) / 2)
+    angle += static_cast<int>(map_info_.angle);
+  cost += std::abs(euclid_cost_coef_[2] * angle);
+  return cost;
+}
+template <class GRIDMAPS>
+inline float GridAstarModel3DT<GRIDMAPS>::euclidCostRough(const Vec& v) const
+{
+  int rootsum = 0;
+  for (int i = 0; i < 2; ++i)
+    rootsum += v[i] * v[i];
+
+  if (rootsum < static_cast<int>(euclid_cost_lin_cache_.size()))
+    return euclid_cost_lin_cache_[rootsum];
+
+  return std::sqrt(rootsum) * euclid_cost_coef_[0];
+}
+template <class GRIDMAPS>
+inline float GridAstarModel3DT<GRIDMAPS>::cost(
+    const Vec& cur, const Vec& next, const std::vector<VecWithCost>& start, const Vec& goal) const
+{
+  Vec d_raw = next - cur;
+  d_raw.cycle(map_info_.angle);
+  const Vec d = d_raw;
+  float cost = euclidCost(d);
+
+  if (d[0] == 0 && d[1] == 0)
+  {
+    // In-place turn
+    int sum = 0;
+    const int dir = d[2] < 0 ? -1 : 1;
+    Vec pos = cur;
+    for (int i = 0; i < std::abs(d[2]); i++)
+    {
+      pos[2] += dir;
+      if (pos[2] < 0)
+        pos[2] += map_info_.angle;
+      else if (pos[2] >= static_cast<int>(map_info_.angle))
+        pos[2] -= map_info_.angle;
+      const auto c = cm_[pos];
+      if (c > 99)
+        return -1;
+      sum += c;
+    }
+
+    cost +=
+        sum * map_info_.angular_resolution * euclid_cost_coef_[2] / euclid_cost_coef_[0] +
+        sum * map_info_.angular_resolution * cc_.weight_costmap_turn_ / 100.0;
+    // simplified from sum * map_info_.angular_resolution * abs(d[2]) * cc_.weight_costmap_turn_ / (100.0 * abs(d[2]))
+    return cc_.in_place_turn_ + cost;
+  }
+
+  const Vec d2(d[0] + range_, d[1] + range_, next[2]);
+  const Vecf motion = rot_cache_.getMotion(cur[2], d2);
+  const float dist = motion.len();
+
+  if (motion[0] < 0)
+  {
+    // Going backward
+    cost *= 1.0 + cc_.weight_backward_;
+  }
+
+  if (d[2] == 0)
+  {
+    const float aspect = motion[0] / motion[1];
+    cost += euclid_cost_coef_[2] * std::abs(1.0 / aspect) * map_info_.angular_resolution / (M_PI * 2.0);
+
+    // Go-straight
+    int sum = 0, sum_hyst = 0;
+    Vec d_index(d[0], d[1], next[2]);
+    d_index.cycleUnsigned(map_info_.angle);
+
+    const auto cache_page = motion_cache_.find(cur[2], d_index);
+    if (cache_page == motion_cache_.end(cur[2]))
+      return -1;
+    if (cm_mask_ && cache_page->second.hitsLethal(*cm_mask_, cur[0], cur[1]))
+      return -1;
+    const int num = cache_page->second.getMotion().size();
+    if (!sumSweptCost(cache_page->second, cur, cm_, hysteresis_ ? &cm_hyst_ : nullptr, sum, sum_hyst))
+      return -1;
+    const float distf = cache_page->second.getDistance();
+    cost += sum * map_info_.linear_resolution * distf * cc_.weight_costmap_ / (100.0 * num);
+    cost += sum_hyst * map_info_.linear_resolution * distf * cc_.weight_hysteresis_ / (100.0 * num);
+  }
+  else
+  {
+    const std::pair<float, float>& radiuses = rot_cache_.getRadiuses(cur[2], d2);
+    const float r1 = radiuses.first;
+    const float r2 = radiuses.second;
+    const float curv_radius = (r1 + r2) / 2;
+
+    // Ignore boundary
+    if (cur[0] < min_boundary_[0] || cur[1] < min_boundary_[1] ||
+        cur[0] >= max_boundary_[0] || cur[1] >= max_boundary_[1])
+      return -1;
+
+    if (std::abs(cc_.max_vel_ / r1) > cc_.max_ang_vel_)
+    {
+      const float vel = std::abs(curv_radius) * cc_.max_ang_vel_;
+      // Curve deceleration penalty
+      cost += dist * std::abs(vel / cc_.max_vel_) * cc_.weight_decel_;
+    }
+
+    {
+      int sum = 0, sum_hyst = 0;
+      Vec d_index(d[0], d[1], next[2]);
+      d_index.cycleUnsigned(map_info_.angle);
+
+      const auto cache_page = motion_cache_.find(cur[2], d_index);
+      if (cache_page == motion_cache_.end(cur[2]))
+        return -1;
+      if (cm_mask_ && cache_page->second.hitsLethal(*cm_mask_, cur[0], cur[1]))
+        return -1;
+      const int num = cache_page->second.getMotion().size();
+      if (!sumSweptCost(cache_page->second, cur, cm_, hysteresis_ ? &cm_hyst_ : nullptr, sum, sum_hyst))
+        return -1;
+      const float distf = cache_page->second.getDistance();
+      cost += sum * map_info_.linear_resolution * distf * cc_.weight_costmap_ / (100.0 * num);
+      cost += sum * map_info_.angular_resolution * std::abs(d[2]) * cc_.weight_costmap_turn_ / (100.0 * num);
+      cost += sum_hyst * map_info_.linear_resolution * distf * cc_.weight_hysteresis_ / (100.0 * num);
+    }
+  }
+
+  return cost;
+}
+template <class GRIDMAPS>
+inline float GridAstarModel3DT<GRIDMAPS>::costEstim(
+    const Vec& cur, const Vec& goal) const
+{
+  Vec s2(cur[0], cur[1], 0);
+  float cost = cost_estim_cache_[s2];
+  if (cost == std::numeric_limits<float>::max())
+    return std::numeric_limits<float>::max();
+
+  int diff = cur[2] - goal[2];
+  while (diff > static_cast<int>(map_info_.angle) / 2)
+    diff -= static_cast<int>(map_info_.angle);
+  while (diff < -static_cast<int>(map_info_.angle) / 2)
+    diff += static_cast<int>(map_info_.angle);
+
+  cost += euclid_cost_coef_[2] * std::abs(diff);
+
+  return cost;
+}
+template <class GRIDMAPS>
+inline bool GridAstarModel3DT<GRIDMAPS>::isLocal(const Vec& p, const std::vector<VecWithCost>& ss) const
+{
+  const float local_range_sq = local_range_ * local_range_;
+  for (const VecWithCost& s : ss)
+  {
+    const Vec ds = s.v_ - p;
+
+    if (ds.sqlen() < local_range_sq)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+template <class GRIDMAPS>
+inline const std::vector<typename GridAstarModel3DT<GRIDMAPS>::Vec>& GridAstarModel3DT<GRIDMAPS>::searchGrids(
+    const Vec& p,
+    const std::vector<VecWithCost>& ss,
+    const Vec& es) const
+{
+  if (isLocal(p, ss))
+    return motion_primitives_[p[2]];
+  return search_list_rough_;
+}
+template <class GRIDMAPS>
+std::vector<typename GridAstarModel3DT<GRIDMAPS>::Vec> GridAstarModel3DT<GRIDMAPS>::searchGridsReverse(
+    const Vec& p,
+    const std::vector<VecWithCost>& ss,
+    const Vec&) const
+{
+  // The search grids are chosen by the predecessor, not by p.
+  // Take the both kinds of the candidates and keep the ones having p in their searchGrids().
+  float dist_min = std::numeric_limits<float>::max();
+  for (const VecWithCost& s : ss)
+    dist_min = std::min(dist_min, (s.v_ - p).len());
+
+  // Distance thresholds have one grid margin for the rounding errors.
+  std::vector<Vec> ret;
+  if (dist_min < local_range_ + motion_primitives_len_max_ + 1)
+  {
+    for (const Vec& d : motion_primitives_reverse_[p[2]])
+    {
+      if (isLocal(p + d, ss))
+        ret.push_back(d);
+    }
+  }
+  if (dist_min + range_ + 1 < local_range_)
+  {
+    // All rough predecessors are in the local range.
+    return ret;
+  }
+  if (dist_min - range_ - 1 > local_range_)
+  {
+    // No rough predecessor is in the local range.
+    ret.insert(ret.end(), search_list_rough_.cbegin(), search_list_rough_.cend());
+    return ret;
+  }
+  // search_list_rough_ is symmetric.
+  for (const Vec& d : search_list_rough_)
+  {
+    if (!isLocal(p + d, ss))
+      ret.push_back(d);
+  }
+  return ret;
+}
+
+template <class GRIDMAPS>
+GridAstarModel2DT<GRIDMAPS>::GridAstarModel2DT(
+    const costmap_cspace_msgs::MapMetaData3D& map_info,
+    const Vecf& euclid_cost_coef,
+    typename GRIDMAPS::CostEstim& cost_estim_cache,
+    typename GRIDMAPS::Rough& cm_rough,
+    const CostCoeff& cc,
+    const int range,
+    const bool use_cost_estim_cache,
+    const std::string& motion_cache_dir)
+  : map_info_(map_info)
+  , euclid_cost_coef_(euclid_cost_coef)
+  , cost_estim_cache_(cost_estim_cache)
+  , cm_rough_(cm_rough)
+  , cm_rough_mask_(nullptr)
+  , cc_(cc)
+  , range_(range)
+  , use_cost_estim_cache_(use_cost_estim_cache)
+{
+  motion_cache_linear_.reset(
+      map_info_.linear_resolution,
+      map_info_.angular_resolution,
+      range_,
+      cm_rough_.getAddressor(),
+      motion_cache_dir);
+  search_list_rough_ = roughSearchList(range_);
+  for (int rootsum = 0;
+       rootsum < static_cast<int>(euclid_cost_lin_cache_.size()); ++rootsum)
+  {
+    euclid_cost_lin_cache_[rootsum] = std::sqrt(rootsum) * euclid_cost_coef_[0];
+  }
+}
+template <class GRIDMAPS>
+void GridAstarModel2DT<GRIDMAPS>::setLethalMask(const LethalMask* cm_rough_mask)
+{
+  cm_rough_mask_ = cm_rough_mask;
+}
+template <class GRIDMAPS>
+inline float GridAstarModel2DT<GRIDMAPS>::euclidCostRough(const Vec& v) const
+{
+  const int rootsum = v[0] * v[0] + v[1] * v[1];
+  if (rootsum < static_cast<int>(euclid_cost_lin_cache_.size()))
+    return euclid_cost_lin_cache_[rootsum];
+
+  return std::sqrt(rootsum) * euclid_cost_coef_[0];
+}
+template <class GRIDMAPS>
+inline float GridAstarModel2DT<GRIDMAPS>::cost(
+    const Vec& cur, const Vec& next, const std::vector<VecWithCost>& start, const Vec& goal) const
+{
+  Vec d = next - cur;
+  d[2] = 0;
+  float cost = euclidCostRough(d);
+
+  int sum = 0, sum_hyst = 0;
+  const auto cache_page = motion_cache_linear_.find(0, d);
+  if (cache_page == motion_cache_linear_.end(0))
+    return -1;
+  if (cm_rough_mask_ && cache_page->second.hitsLethal(*cm_rough_mask_, cur[0], cur[1]))
+    return -1;
+  const int num = cache_page->second.getMotion().size();
+  if (!sumSweptCost(
+          cache_page->second, cur, cm_rough_,
+          static_cast<const typename GRIDMAPS::Rough*>(nullptr), sum, sum_hyst))
+    return -1;
+  const float distf = cache_page->second.getDistance();
+  cost += sum * map_info_.linear_resolution *
+          distf * cc_.weight_costmap_ / (100.0 * num);
+
+  return cost;
+}
+template <class GRIDMAPS>
+inline float GridAstarModel2DT<GRIDMAPS>::costEstim(
+    const Vec& cur, const Vec& goal) const
+{
+  if (use_cost_estim_cache_)
+    return cost_estim_cache_[Vec(cur[0], cur[1], 0)];
+
+  const Vec d = goal - cur;
+  const float cost = euclidCostRough(d);
+
+  return cost;
+}
+template <class GRIDMAPS>
+inline const std::vector<typename GridAstarModel2DT<GRIDMAPS>::Vec>& GridAstarModel2DT<GRIDMAPS>::searchGrids(
+    const Vec& cur, const std::vector<VecWithCost>& start, const Vec& goal) const
+{
+  return search_list_rough_;
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_GRID_ASTAR_MODEL_IMPL_H
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_HEURISTIC_CACHE_H
+#define PLANNER_CSPACE_PLANNER_3D_HEURISTIC_CACHE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <utility>
+
+#include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/reservable_priority_queue.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// LRU cache of the estimated cost maps to the goals.
+// The cached maps are invalidated on the new static map. The regions changed by the costmap updates
+// and the remembered costs after caching are recorded to repair the cost map on reuse.
+class HeuristicCache
+{
+public:
+  using Astar = GridAstar<3, 2>;
+  using Vec = Astar::Vec;
+  using Gridmap = Astar::Gridmap<float>;
+  using OpenList = reservable_priority_queue<Astar::PriorityVec>;
+
+protected:
+  struct Entry
+  {
+    Vec goal_;
+    Gridmap g_;
+    OpenList open_;
+    bool dirty_;
+    Vec dirty_min_;
+    Vec dirty_max_;
+    size_t bytes_;
+  };
+
+  std::list<std::unique_ptr<Entry>> entries_;
+  size_t max_bytes_;
+  size_t bytes_;
+  size_t hits_;
+  size_t misses_;
+
+  void shrink(const size_t max_bytes)
+  {
+    while (bytes_ > max_bytes && !entries_.empty())
+    {
+      bytes_ -= entries_.back()->bytes_;
+      entries_.pop_back();
+    }
+  }
+
+public:
+  HeuristicCache()
+    : max_bytes_(0)
+    , bytes_(0)
+    , hits_(0)
+    , misses_(0)
+  {
+  }
+  void setMemoryLimit(const size_t max_bytes)
+  {
+    max_bytes_ = max_bytes;
+    shrink(max_bytes_);
+  }
+  bool enabled() const
+  {
+    return max_bytes_ > 0;
+  }
+  void clear()
+  {
+    entries_.clear();
+    bytes_ = 0;
+  }
+  // Stores the copy of the cost map to the goal as the most recently used one.
+  void store(const Vec& goal, const Gridmap& g, const OpenList& open)
+  {
+    const Vec e(goal[0], goal[1], 0);
+    const size_t bytes = g.ser_size() * sizeof(float) + open.size() * sizeof(Astar::PriorityVec);
+    if (bytes > max_bytes_)
+      return;
+
+    for (auto it = entries_.begin(); it != entries_.end(); ++it)
+    {
+      if ((*it)->goal_ == e)
+      {
+        bytes_ -= (*it)->bytes_;
+        entries_.erase(it);
+        break;
+      }
+    }
+    shrink(max_bytes_ - bytes);
+
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->goal_ = e;
+    entry->g_ = g;
+    entry->open_ = open;
+    entry->dirty_ = false;
+    entry->bytes_ = bytes;
+    bytes_ += bytes;
+    entries_.emplace_front(std::move(entry));
+  }
+  // Copies the cached cost map to the goal if available.
+  // dirty is set true if the region [dirty_min, dirty_max) must be repaired.
+  bool load(
+      const Vec& goal, Gridmap& g, OpenList& open,
+      bool& dirty, Vec& dirty_min, Vec& dirty_max)
+  {
+    const Vec e(goal[0], goal[1], 0);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it)
+    {
+      if ((*it)->goal_ != e)
+        continue;
+      const Entry& entry = **it;
+      g = entry.g_;
+      open = entry.open_;
+      dirty = entry.dirty_;
+      dirty_min = entry.dirty_min_;
+      dirty_max = entry.dirty_max_;
+      entries_.splice(entries_.begin(), entries_, it);
+      ++hits_;
+      return true;
+    }
+    ++misses_;
+    return false;
+  }
+  // Records the region [min, max) of the rough costmap changed after caching.
+  void markDirty(const Vec& min, const Vec& max)
+  {
+    for (auto& entry : entries_)
+    {
+      if (!entry->dirty_)
+      {
+        entry->dirty_ = true;
+        entry->dirty_min_ = min;
+        entry->dirty_max_ = max;
+        continue;
+      }
+      for (int i = 0; i < 2; ++i)
+      {
+        entry->dirty_min_[i] = std::min(entry->dirty_min_[i], min[i]);
+        entry->dirty_max_[i] = std::max(entry->dirty_max_[i], max[i]);
+      }
+    }
+  }
+  size_t size() const
+  {
+    return entries_.size();
+  }
+  size_t bytes() const
+  {
+    return bytes_;
+  }
+  size_t hits() const
+  {
+    return hits_;
+  }
+  size_t misses() const
+  {
+    return misses_;
+  }
+};
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_HEURISTIC_CACHE_H
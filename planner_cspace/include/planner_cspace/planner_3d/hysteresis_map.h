@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_HYSTERESIS_MAP_H
+#define PLANNER_CSPACE_PLANNER_3D_HYSTERESIS_MAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <planner_cspace/cyclic_vec.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// Generates the hysteresis costmap along the path.
+// The cost is 0 within expand_dist from the path segments of the same yaw,
+// linearly increases to 100 at expand_dist + max_dist, and 100 outside.
+// Only the cells within the band around the segments are computed,
+// and the cells updated previously are restored to 100 by tracking the bounding region.
+class HysteresisMap
+{
+public:
+  using Vec = CyclicVecInt<3, 2>;
+  using Vecf = CyclicVecFloat<3, 2>;
+
+protected:
+  struct Segment
+  {
+    Vecf a;
+    Vecf b;
+  };
+  std::vector<std::vector<Segment>> segments_;
+  Vec region_min_;
+  Vec region_max_;
+
+public:
+  HysteresisMap()
+    : region_min_(0, 0, 0)
+    , region_max_(0, 0, 0)
+  {
+  }
+  // Forgets the previously updated region, when the whole map is cleared externally.
+  void reset()
+  {
+    region_min_ = Vec(0, 0, 0);
+    region_max_ = Vec(0, 0, 0);
+  }
+  const Vec& regionMin() const
+  {
+    return region_min_;
+  }
+  const Vec& regionMax() const
+  {
+    return region_max_;
+  }
+  template <class GRIDMAP>
+  void update(
+      GRIDMAP& cm_hyst, const std::vector<Vecf>& path,
+      const float expand_dist, const float max_dist)
+  {
+    const Vec& size = cm_hyst.size();
+    const int angle = size[2];
+
+    Vec p;
+    for (p[0] = region_min_[0]; p[0] < region_max_[0]; ++p[0])
+    {
+      for (p[1] = region_min_[1]; p[1] < region_max_[1]; ++p[1])
+      {
+        for (p[2] = 0; p[2] < angle; ++p[2])
+        {
+          cm_hyst[p] = 100;
+        }
+      }
+    }
+
+    segments_.resize(angle);
+    for (auto& s : segments_)
+      s.clear();
+    const float band = expand_dist + max_dist;
+    const int margin = std::ceil(band) + 1;
+    int path_min[2] = {std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
+    int path_max[2] = {std::numeric_limits<int>::lowest(), std::numeric_limits<int>::lowest()};
+    for (size_t i = 1; i < path.size(); ++i)
+    {
+      const int yaw = cycleYaw(path[i][2], angle);
+      const int yaw_prev = cycleYaw(path[i - 1][2], angle);
+      segments_[yaw].push_back(Segment{path[i - 1], path[i]});
+      if (yaw_prev != yaw)
+        segments_[yaw_prev].push_back(Segment{path[i - 1], path[i]});
+      for (int j = 0; j < 2; ++j)
+      {
+        path_min[j] = std::min(path_min[j], static_cast<int>(std::floor(std::min(path[i - 1][j], path[i][j]))));
+        path_max[j] = std::max(path_max[j], static_cast<int>(std::ceil(std::max(path[i - 1][j], path[i][j]))));
+      }
+    }
+    if (path.size() < 2)
+    {
+      reset();
+      return;
+    }
+    for (int j = 0; j < 2; ++j)
+    {
+      region_min_[j] = std::max(path_min[j] - margin, 0);
+      region_max_[j] = std::min(path_max[j] + margin + 1, size[j]);
+    }
+    region_min_[2] = 0;
+    region_max_[2] = angle;
+
+    // Yaw layers are independent.
+#pragma omp parallel for schedule(dynamic)
+    for (int yaw = 0; yaw < angle; ++yaw)
+    {
+      for (const Segment& s : segments_[yaw])
+      {
+        const int x_min = std::max(static_cast<int>(std::floor(std::min(s.a[0], s.b[0]) - band)), 0);
+        const int y_min = std::max(static_cast<int>(std::floor(std::min(s.a[1], s.b[1]) - band)), 0);
+        const int x_max = std::min(static_cast<int>(std::ceil(std::max(s.a[0], s.b[0]) + band)) + 1, size[0]);
+        const int y_max = std::min(static_cast<int>(std::ceil(std::max(s.a[1], s.b[1]) + band)) + 1, size[1]);
+        Vec c(0, 0, yaw);
+        for (c[0] = x_min; c[0] < x_max; ++c[0])
+        {
+          for (c[1] = y_min; c[1] < y_max; ++c[1])
+          {
+            const float d = Vecf(c).distLinestrip2d(s.a, s.b);
+            if (d >= band)
+              continue;
+            const char cost = std::lround((std::max(expand_dist, d) - expand_dist) * 100.0 / max_dist);
+            if (cost < cm_hyst[c])
+              cm_hyst[c] = cost;
+          }
+        }
+      }
+    }
+  }
+
+protected:
+  static inline int cycleYaw(const float yaw, const int angle)
+  {
+    int y = std::lround(yaw) % angle;
+    if (y < 0)
+      y += angle;
+    return y;
+  }
+};
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_HYSTERESIS_MAP_H
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_LANDMARK_HEURISTIC_H
+#define PLANNER_CSPACE_PLANNER_3D_LANDMARK_HEURISTIC_H
+
+#include <cstdint>
+#include <vector>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// Lower bound of the cost-to-goal map based on the costs from the landmarks (ALT heuristic).
+// Costs from the landmarks are calculated on the static map and quantized to 16 bits.
+// Since the costmap updates and the remembered costs only increase the costs,
+// the bound is kept valid until the static map is changed.
+class LandmarkHeuristic
+{
+public:
+  using Astar = GridAstar<3, 2>;
+  using Vec = Astar::Vec;
+  using Gridmap = Astar::Gridmap<float>;
+  using Rough = DistanceMap::Rough;
+
+  static constexpr uint16_t UNREACHABLE = 0xFFFF;
+
+protected:
+  Vec size_;
+  std::vector<Vec> landmarks_;
+  // Quantized costs from the landmarks arranged landmark by landmark.
+  std::vector<uint16_t> costs_;
+  // Cost per quantization step of each landmark.
+  std::vector<float> resolutions_;
+
+  inline size_t addr(const Vec& p) const
+  {
+    return static_cast<size_t>(p[1]) * size_[0] + p[0];
+  }
+  inline size_t numGrids() const
+  {
+    return static_cast<size_t>(size_[0]) * size_[1];
+  }
+
+public:
+  LandmarkHeuristic();
+  // Selects the landmarks by the farthest point sampling and calculates the costs from them.
+  void build(
+      const Rough& cm_rough,
+      const costmap_cspace_msgs::MapMetaData3D& map_info,
+      const DistanceMap::Params& p,
+      const int num_landmarks);
+  void clear();
+  inline bool enabled() const
+  {
+    return !landmarks_.empty();
+  }
+  inline const std::vector<Vec>& landmarks() const
+  {
+    return landmarks_;
+  }
+  inline size_t bytes() const
+  {
+    return costs_.size() * sizeof(uint16_t);
+  }
+  // Returns the lower bound of the cost from e to p.
+  float estimate(const Vec& p, const Vec& e) const;
+  // Fills g by the lower bounds of the costs from e.
+  // Grids unreachable from e are set to std::numeric_limits<float>::max().
+  void fill(const Vec& e, Gridmap& g) const;
+};
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_LANDMARK_HEURISTIC_H
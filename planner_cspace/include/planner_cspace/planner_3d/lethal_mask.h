@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_LETHAL_MASK_H
+#define PLANNER_CSPACE_PLANNER_3D_LETHAL_MASK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <planner_cspace/cyclic_vec.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// Packed bitmask of the lethal cells (cost > 99) of the costmap.
+// Bits are arranged along x axis to check the cells swept by a motion
+// by a few word-wide operations.
+class LethalMask
+{
+public:
+  using Vec = CyclicVecInt<3, 2>;
+
+protected:
+  // Bytes at the both ends of the rows to read the words around the boundary.
+  // They are always zero.
+  static constexpr int MARGIN = 8;
+
+  std::vector<uint8_t> data_;
+  Vec size_;
+  int row_bytes_;
+
+  inline size_t rowAddr(const int y, const int yaw) const
+  {
+    return (static_cast<size_t>(yaw) * size_[1] + y) * row_bytes_ + MARGIN;
+  }
+
+public:
+  // Maximum length of the pattern given to any()
+  static constexpr int PATTERN_BITS = 57;
+
+  inline LethalMask()
+    : size_(0, 0, 0)
+    , row_bytes_(0)
+  {
+  }
+  inline void reset(const Vec& size)
+  {
+    size_ = size;
+    row_bytes_ = (size[0] + 7) / 8 + MARGIN * 2;
+    data_.assign(static_cast<size_t>(row_bytes_) * size[1] * size[2], 0);
+  }
+  inline const Vec& size() const
+  {
+    return size_;
+  }
+  inline void clear()
+  {
+    std::fill(data_.begin(), data_.end(), 0);
+  }
+  inline void set(const Vec& p, const bool lethal)
+  {
+    uint8_t& byte = data_[rowAddr(p[1], p[2]) + (p[0] >> 3)];
+    const uint8_t bit = 1 << (p[0] & 7);
+    if (lethal)
+      byte |= bit;
+    else
+      byte &= ~bit;
+  }
+  inline bool get(const Vec& p) const
+  {
+    return (data_[rowAddr(p[1], p[2]) + (p[0] >> 3)] >> (p[0] & 7)) & 1;
+  }
+  // Updates the bits in the region [min, max) from the costmap.
+  template <class GRIDMAP>
+  void update(const GRIDMAP& cm, const Vec& min, const Vec& max)
+  {
+    const Vec min_clamped(std::max(min[0], 0), std::max(min[1], 0), std::max(min[2], 0));
+    const Vec max_clamped(std::min(max[0], size_[0]), std::min(max[1], size_[1]), std::min(max[2], size_[2]));
+    Vec p;
+    for (p[2] = min_clamped[2]; p[2] < max_clamped[2]; ++p[2])
+    {
+      for (p[1] = min_clamped[1]; p[1] < max_clamped[1]; ++p[1])
+      {
+        for (p[0] = min_clamped[0]; p[0] < max_clamped[0]; ++p[0])
+        {
+          set(p, cm[p] > 99);
+        }
+      }
+    }
+  }
+  // Copies the bits in the region [min, max) from the mask of the same size.
+  // Bits sharing the bytes with the region along x axis are also copied,
+  // so they must be same in the both masks.
+  inline void copyRegion(const LethalMask& src, const Vec& min, const Vec& max)
+  {
+    const int x_min = std::max(min[0], 0);
+    const int x_max = std::min(max[0], size_[0]);
+    if (x_min >= x_max)
+      return;
+    const size_t byte_min = x_min >> 3;
+    const size_t bytes = ((x_max + 7) >> 3) - byte_min;
+    for (int yaw = std::max(min[2], 0); yaw < std::min(max[2], size_[2]); ++yaw)
+    {
+      for (int y = std::max(min[1], 0); y < std::min(max[1], size_[1]); ++y)
+      {
+        const size_t addr = rowAddr(y, yaw) + byte_min;
+        std::memcpy(&data_[addr], &src.data_[addr], bytes);
+      }
+    }
+  }
+  // Returns true if any of (x + i, y, yaw) is lethal for the bits i set in the pattern.
+  // Cells outside of the map are not lethal.
+  inline bool any(const int x, const int y, const int yaw, const uint64_t pattern) const
+  {
+    if (static_cast<unsigned int>(y) >= static_cast<unsigned int>(size_[1]) ||
+        x < -MARGIN * 8 || (x >> 3) + MARGIN * 2 > row_bytes_)
+      return false;
+
+    uint64_t word;
+    std::memcpy(&word, &data_[rowAddr(y, yaw) + (x >> 3)], sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return (word >> (x & 7)) & pattern;
+  }
+};
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_LETHAL_MASK_H
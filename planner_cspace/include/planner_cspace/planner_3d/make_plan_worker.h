@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PLANNER_3D_MAKE_PLAN_WORKER_H
+#define PLANNER_CSPACE_PLANNER_3D_MAKE_PLAN_WORKER_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/reservable_priority_queue.h>
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+#include <planner_cspace/planner_3d/grid_astar_model.h>
+#include <planner_cspace/planner_3d/lethal_mask.h>
+#include <planner_cspace/planner_3d/path_interpolator.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+// 2D path search for make_plan service on the snapshot of the rough costmap.
+// Each worker has its own search buffers to run concurrently with the main planner.
+// The cost map to the goal filled by DistanceMap is used as the heuristic
+// and is reused by the queries to the same goal until the costmap is updated.
+class MakePlanWorker
+{
+public:
+  using Astar = GridAstar<3, 2>;
+  using Vec = Astar::Vec;
+  using Vecf = Astar::Vecf;
+  using Rough = DistanceMap::Rough;
+
+  struct Params
+  {
+    costmap_cspace_msgs::MapMetaData3D map_info;
+    Vecf euclid_cost;
+    int range;
+    CostCoeff cc;
+    DistanceMap::Params distance_map;
+    float time_limit;
+    bool find_best;
+    std::string motion_cache_dir;
+  };
+  struct Query
+  {
+    Vec start;
+    Vec goal;
+  };
+
+protected:
+  Params p_;
+  Astar as_;
+  Rough cm_rough_;
+  Astar::Gridmap<float> cost_estim_cache_;
+  reservable_priority_queue<Astar::PriorityVec> cost_estim_open_;
+  LethalMask cm_rough_mask_;
+  CostmapBBF bbf_costmap_;
+  DistanceMap distance_map_;
+  PathInterpolator path_interpolator_;
+  GridAstarModel2DPlanner::Ptr model_2d_;
+  bool has_cost_estim_;
+  Vec cost_estim_goal_;
+
+public:
+  MakePlanWorker();
+  void reset(const Params& p);
+  // Copies the rough costmap and its lethal mask. The cost map to the goal is discarded.
+  void setMap(const Rough& cm_rough, const LethalMask& cm_rough_mask);
+  inline const Rough& roughCostmap() const
+  {
+    return cm_rough_;
+  }
+  inline const PathInterpolator& pathInterpolator() const
+  {
+    return path_interpolator_;
+  }
+  // Finds the 2D path from s to e. Angular elements of s and e are ignored.
+  bool search(const Vec& s, const Vec& e, std::list<Vec>& path);
+  // Processes the queries grouped by the goals to reuse the cost maps to the goals.
+  // The path of the failed query is left empty.
+  void search(const std::vector<Query>& queries, std::vector<std::list<Vec>>& paths);
+  // Calculates the 2D path costs from all starts to all goals.
+  // costs[i * goals.size() + j] is the cost from starts[i] to goals[j],
+  // or std::numeric_limits<float>::max() if unreachable.
+  // Starts and goals out of the map or on the lethal cells are unreachable.
+  // One cost map is filled per goal and shared by all starts.
+  // Goals are processed in parallel on the local buffers, so the cached cost map is kept.
+  void costs(
+      const std::vector<Vec>& starts, const std::vector<Vec>& goals,
+      std::vector<float>& costs) const;
+};
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PLANNER_3D_MAKE_PLAN_WORKER_H
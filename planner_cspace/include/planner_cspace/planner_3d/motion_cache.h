@@ -30,11 +30,17 @@
 #ifndef PLANNER_CSPACE_PLANNER_3D_MOTION_CACHE_H
 #define PLANNER_CSPACE_PLANNER_3D_MOTION_CACHE_H
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
+#include <planner_cspace/blockmem_gridmap.h>
 #include <planner_cspace/cyclic_vec.h>
+#include <planner_cspace/planner_3d/lethal_mask.h>
 
 namespace planner_cspace
 {
@@ -43,6 +49,35 @@ namespace planner_3d
 class MotionCache
 {
 public:
+  // Memory layout of the 3-DOF char gridmap to be read by Page::sumCost().
+  class GridmapView
+  {
+  public:
+    const char* data_;
+    int32_t block_bit_;
+    int32_t block_mask_;
+    int32_t block_size_y_;
+    size_t block_ser_size_;
+    int32_t angle_;
+
+    template <int BLOCK_WIDTH>
+    explicit GridmapView(const BlockMemGridmap<char, 3, 2, BLOCK_WIDTH>& gm)
+      : data_(gm.data())
+      , block_bit_(gm.block_bit())
+      , block_mask_(BLOCK_WIDTH - 1)
+      , block_size_y_(gm.block_size()[1])
+      , block_ser_size_(gm.block_ser_size())
+      , angle_(gm.size()[2])
+    {
+    }
+    inline size_t addr(const int32_t x, const int32_t y, const int32_t yaw) const
+    {
+      const size_t baddr = static_cast<size_t>(x >> block_bit_) * block_size_y_ + (y >> block_bit_);
+      const size_t addr = (((x & block_mask_) << block_bit_) + (y & block_mask_)) * angle_ + yaw;
+      return baddr * block_ser_size_ + addr;
+    }
+  };
+
   class Page
   {
   protected:
@@ -51,6 +86,35 @@ public:
     std::vector<CyclicVecInt<3, 2>> motion_;
     float distance_;
 
+    // Linear offsets of the cells from the address of (cur_x, cur_y, 0).
+    // Valid if all the cells are in the same block as the current position.
+    std::vector<int32_t> offset_;
+    int32_t min_x_, max_x_;
+    int32_t min_y_, max_y_;
+    // Layout of the gridmap offset_ is calculated for
+    int32_t offset_block_mask_;
+    int32_t offset_angle_;
+
+    // Cells of the motion packed into the rows of LethalMask
+    struct MaskRow
+    {
+      int32_t x_;
+      int32_t y_;
+      int32_t yaw_;
+      uint64_t pattern_;
+    };
+    std::vector<MaskRow> mask_rows_;
+
+    inline bool inBlock(const GridmapView& gm, const int32_t cur_x, const int32_t cur_y) const
+    {
+      const int32_t bx = cur_x & gm.block_mask_;
+      const int32_t by = cur_y & gm.block_mask_;
+      return gm.block_mask_ == offset_block_mask_ && gm.angle_ == offset_angle_ &&
+             bx + min_x_ >= 0 && bx + max_x_ <= gm.block_mask_ &&
+             by + min_y_ >= 0 && by + max_y_ <= gm.block_mask_;
+    }
+    bool sumCostOffsetAVX2(const char* cm, const char* cm_hyst, int& sum, int& sum_hyst) const;
+
   public:
     inline float getDistance() const
     {
@@ -60,6 +124,61 @@ public:
     {
       return motion_;
     }
+
+    // Returns true if the motion from (cur_x, cur_y) hits lethal cell.
+    inline bool hitsLethal(const LethalMask& mask, const int32_t cur_x, const int32_t cur_y) const
+    {
+      for (const MaskRow& row : mask_rows_)
+      {
+        if (mask.any(cur_x + row.x_, cur_y + row.y_, row.yaw_, row.pattern_))
+          return true;
+      }
+      return false;
+    }
+    // Sums the costs of the cells swept by the motion from (cur_x, cur_y).
+    // Returns false if the motion hits lethal cell (>99).
+    // Hysteresis costs are summed if cm_hyst is not null.
+    inline bool sumCost(
+        const int32_t cur_x, const int32_t cur_y,
+        const GridmapView& cm, const GridmapView* cm_hyst,
+        int& sum, int& sum_hyst) const
+    {
+      sum = 0;
+      sum_hyst = 0;
+      if (!inBlock(cm, cur_x, cur_y) || (cm_hyst && !inBlock(*cm_hyst, cur_x, cur_y)))
+      {
+        for (const auto& pos_diff : motion_)
+        {
+          const int32_t x = cur_x + pos_diff[0];
+          const int32_t y = cur_y + pos_diff[1];
+          const char c = cm.data_[cm.addr(x, y, pos_diff[2])];
+          if (c > 99)
+            return false;
+          sum += c;
+
+          if (cm_hyst)
+            sum_hyst += cm_hyst->data_[cm_hyst->addr(x, y, pos_diff[2])];
+        }
+        return true;
+      }
+
+      const char* const cm_base = cm.data_ + cm.addr(cur_x, cur_y, 0);
+      const char* const cm_hyst_base = cm_hyst ? cm_hyst->data_ + cm_hyst->addr(cur_x, cur_y, 0) : nullptr;
+      if (offset_.size() >= SIMD_WIDTH_MIN && avx2_)
+        return sumCostOffsetAVX2(cm_base, cm_hyst_base, sum, sum_hyst);
+
+      for (const int32_t offset : offset_)
+      {
+        const char c = cm_base[offset];
+        if (c > 99)
+          return false;
+        sum += c;
+
+        if (cm_hyst_base)
+          sum_hyst += cm_hyst_base[offset];
+      }
+      return true;
+    }
   };
 
   using Cache =
@@ -90,16 +209,61 @@ public:
     return max_range_;
   }
 
+  // Parameters determining the cache contents.
+  struct CacheKey
+  {
+    float linear_resolution;
+    float angular_resolution;
+    int32_t range;
+    int32_t block_bit;
+    int32_t gridmap_angle;
+
+    bool operator==(const CacheKey& b) const;
+    std::string fileName() const;
+    static uint32_t floatBits(const float v);
+  };
+  inline const CacheKey& getKey() const
+  {
+    return key_;
+  }
+
+  // If cache_dir is given, the cache is loaded from the file generated
+  // with the same parameters in cache_dir, or saved to it after generation.
   void reset(
       const float linear_resolution,
       const float angular_resolution,
       const int range,
-      const std::function<void(CyclicVecInt<3, 2>, size_t&, size_t&)> gm_addr);
+      const std::function<void(CyclicVecInt<3, 2>, size_t&, size_t&)> gm_addr,
+      const std::string& cache_dir = std::string());
+  bool save(const std::string& file) const;
+  // Returns false if the file doesn't exist, is broken, or is generated with the different key.
+  bool load(const std::string& file, const CacheKey& key);
 
 protected:
+  // Pages with fewer cells are processed by the scalar loop.
+  static constexpr size_t SIMD_WIDTH_MIN = 8;
+  static const bool avx2_;
+
   std::vector<Cache> cache_;
   int page_size_;
   CyclicVecInt<3, 2> max_range_;
+  CacheKey key_;
+
+  void buildPages(
+      const int syaw,
+      const float linear_resolution,
+      const float angular_resolution,
+      const int range,
+      const int angle,
+      const int block_bit,
+      const std::function<void(CyclicVecInt<3, 2>, size_t&, size_t&)>& gm_addr,
+      CyclicVecInt<3, 2>& max_range);
+  // Motions have only tens of cells, so linear search is faster than hashing.
+  static inline bool isNewCell(
+      const Page& page, const CyclicVecInt<3, 2>& goal, const CyclicVecInt<3, 2>& pos)
+  {
+    return pos != goal && std::find(page.motion_.begin(), page.motion_.end(), pos) == page.motion_.end();
+  }
 };
 }  // namespace planner_3d
 }  // namespace planner_cspace
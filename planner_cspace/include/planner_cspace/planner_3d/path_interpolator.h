@@ -31,6 +31,7 @@
 #define PLANNER_CSPACE_PLANNER_3D_PATH_INTERPOLATOR_H
 
 #include <list>
+#include <vector>
 
 #include <planner_cspace/cyclic_vec.h>
 #include <planner_cspace/planner_3d/rotation_cache.h>
@@ -55,7 +56,7 @@ public:
     angle_ = std::lround(M_PI * 2 / angular_resolution);
     rot_cache_.reset(1.0, angular_resolution, range);
   }
-  std::list<CyclicVecFloat<3, 2>> interpolate(
+  std::vector<CyclicVecFloat<3, 2>> interpolate(
       const std::list<CyclicVecInt<3, 2>>& path_grid,
       const float interval,
       const int local_range) const;
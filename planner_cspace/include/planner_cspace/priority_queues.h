@@ -0,0 +1,664 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLANNER_CSPACE_PRIORITY_QUEUES_H
+#define PLANNER_CSPACE_PRIORITY_QUEUES_H
+
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace planner_cspace
+{
+// Alternative open lists having the same interface as reservable_priority_queue.
+// As std::priority_queue, top() returns the element which is not less than any other elements.
+// pop_back() removes an element to limit the queue size.
+
+// Implicit d-ary heap. Shallower than the binary heap and the children of a node
+// are placed in a contiguous memory.
+// pop_back() removes the last leaf which is not necessarily the worst element.
+template <class T, int ARITY = 4>
+class dary_heap
+{
+  static_assert(ARITY >= 2, "ARITY must be 2 or greater");
+
+public:
+  using value_type = T;
+  using size_type = typename std::vector<T>::size_type;
+
+  explicit dary_heap(const size_type capacity = 0)
+  {
+    reserve(capacity);
+  }
+  void reserve(const size_type capacity)
+  {
+    c_.reserve(capacity);
+  }
+  size_type capacity() const
+  {
+    return c_.capacity();
+  }
+  size_type size() const
+  {
+    return c_.size();
+  }
+  bool empty() const
+  {
+    return c_.empty();
+  }
+  void clear()
+  {
+    c_.clear();
+  }
+  const T& top() const
+  {
+    return c_.front();
+  }
+  void push(const T& v)
+  {
+    c_.push_back(v);
+    siftUp(c_.size() - 1);
+  }
+  void push(T&& v)
+  {
+    c_.push_back(std::move(v));
+    siftUp(c_.size() - 1);
+  }
+  template <class... ARGS>
+  void emplace(ARGS&&... args)
+  {
+    c_.emplace_back(std::forward<ARGS>(args)...);
+    siftUp(c_.size() - 1);
+  }
+  void pop()
+  {
+    if (c_.size() > 1)
+    {
+      c_.front() = std::move(c_.back());
+      c_.pop_back();
+      siftDown(0);
+      return;
+    }
+    c_.pop_back();
+  }
+  void pop_back()
+  {
+    c_.pop_back();
+  }
+
+protected:
+  std::vector<T> c_;
+
+  void siftUp(size_type i)
+  {
+    T v(std::move(c_[i]));
+    while (i > 0)
+    {
+      const size_type parent = (i - 1) / ARITY;
+      if (!(c_[parent] < v))
+        break;
+      c_[i] = std::move(c_[parent]);
+      i = parent;
+    }
+    c_[i] = std::move(v);
+  }
+  void siftDown(size_type i)
+  {
+    const size_type n = c_.size();
+    T v(std::move(c_[i]));
+    while (true)
+    {
+      const size_type first = i * ARITY + 1;
+      if (first >= n)
+        break;
+      const size_type last = std::min(first + ARITY, n);
+      size_type best = first;
+      for (size_type j = first + 1; j < last; ++j)
+      {
+        if (c_[best] < c_[j])
+          best = j;
+      }
+      if (!(v < c_[best]))
+        break;
+      c_[i] = std::move(c_[best]);
+      i = best;
+    }
+    c_[i] = std::move(v);
+  }
+};
+
+// Min-max heap which provides both of the best and the worst elements in O(log n).
+// pop_back() removes the worst element so that the bounded queue keeps the best candidates.
+template <class T>
+class min_max_heap
+{
+public:
+  using value_type = T;
+  using size_type = typename std::vector<T>::size_type;
+
+  explicit min_max_heap(const size_type capacity = 0)
+  {
+    reserve(capacity);
+  }
+  void reserve(const size_type capacity)
+  {
+    c_.reserve(capacity);
+  }
+  size_type capacity() const
+  {
+    return c_.capacity();
+  }
+  size_type size() const
+  {
+    return c_.size();
+  }
+  bool empty() const
+  {
+    return c_.empty();
+  }
+  void clear()
+  {
+    c_.clear();
+  }
+  const T& top() const
+  {
+    return c_.front();
+  }
+  const T& bottom() const
+  {
+    return c_[worstIndex()];
+  }
+  void push(const T& v)
+  {
+    c_.push_back(v);
+    pushUp(c_.size() - 1);
+  }
+  void push(T&& v)
+  {
+    c_.push_back(std::move(v));
+    pushUp(c_.size() - 1);
+  }
+  template <class... ARGS>
+  void emplace(ARGS&&... args)
+  {
+    c_.emplace_back(std::forward<ARGS>(args)...);
+    pushUp(c_.size() - 1);
+  }
+  void pop()
+  {
+    erase(0);
+  }
+  void pop_back()
+  {
+    erase(worstIndex());
+  }
+
+protected:
+  // Even levels hold the better elements and odd levels hold the worse elements.
+  std::vector<T> c_;
+
+  static bool isBetterLevel(const size_type i)
+  {
+    const int level = 63 - __builtin_clzll(static_cast<uint64_t>(i) + 1);
+    return (level & 1) == 0;
+  }
+  static bool isBetter(const T& a, const T& b)
+  {
+    return b < a;
+  }
+  size_type worstIndex() const
+  {
+    if (c_.size() < 3)
+      return c_.size() - 1;
+    return isBetter(c_[1], c_[2]) ? 2 : 1;
+  }
+  void erase(const size_type i)
+  {
+    if (i + 1 == c_.size())
+    {
+      c_.pop_back();
+      return;
+    }
+    c_[i] = std::move(c_.back());
+    c_.pop_back();
+    pushDown(i);
+  }
+  template <bool BETTER>
+  bool compare(const T& a, const T& b) const
+  {
+    return BETTER ? isBetter(a, b) : isBetter(b, a);
+  }
+  template <bool BETTER>
+  void pushUpLevel(size_type i)
+  {
+    while (i > 2)
+    {
+      const size_type grandparent = ((i - 1) / 2 - 1) / 2;
+      if (!compare<BETTER>(c_[i], c_[grandparent]))
+        break;
+      std::swap(c_[i], c_[grandparent]);
+      i = grandparent;
+    }
+  }
+  void pushUp(const size_type i)
+  {
+    if (i == 0)
+      return;
+    const size_type parent = (i - 1) / 2;
+    if (isBetterLevel(i))
+    {
+      if (isBetter(c_[parent], c_[i]))
+      {
+        std::swap(c_[i], c_[parent]);
+        pushUpLevel<false>(parent);
+        return;
+      }
+      pushUpLevel<true>(i);
+    }
+    else
+    {
+      if (isBetter(c_[i], c_[parent]))
+      {
+        std::swap(c_[i], c_[parent]);
+        pushUpLevel<true>(parent);
+        return;
+      }
+      pushUpLevel<false>(i);
+    }
+  }
+  template <bool BETTER>
+  void pushDownLevel(size_type i)
+  {
+    const size_type n = c_.size();
+    while (true)
+    {
+      const size_type child = i * 2 + 1;
+      if (child >= n)
+        return;
+      // Find the best (or the worst) one in the children and grandchildren
+      size_type m = child;
+      if (child + 1 < n && compare<BETTER>(c_[child + 1], c_[m]))
+        m = child + 1;
+      const size_type grandchild = child * 2 + 1;
+      for (size_type j = grandchild; j < std::min(grandchild + 4, n); ++j)
+      {
+        if (compare<BETTER>(c_[j], c_[m]))
+          m = j;
+      }
+      if (!compare<BETTER>(c_[m], c_[i]))
+        return;
+      std::swap(c_[m], c_[i]);
+      if (m < grandchild)
+        return;
+      const size_type parent = (m - 1) / 2;
+      if (compare<BETTER>(c_[parent], c_[m]))
+        std::swap(c_[m], c_[parent]);
+      i = m;
+    }
+  }
+  void pushDown(const size_type i)
+  {
+    if (isBetterLevel(i))
+      pushDownLevel<true>(i);
+    else
+      pushDownLevel<false>(i);
+  }
+};
+
+// Bucket queue (Dial's algorithm) keyed on the priority T::p_ (smaller first)
+// quantized by 1 / KEY_SCALE.
+// Elements in a bucket are popped in LIFO order, so the order of the elements
+// having the priority difference smaller than 1 / KEY_SCALE is not guaranteed.
+// Priorities further than NUM_BUCKETS / KEY_SCALE from the lowest one
+// (e.g. unreachable grids having the infinite cost estimation) share the last bucket.
+// pop_back() removes one of the elements in the worst bucket.
+template <class T, int KEY_SCALE = 16>
+class bucket_queue
+{
+  static_assert(KEY_SCALE > 0, "KEY_SCALE must be positive");
+
+public:
+  using value_type = T;
+  using size_type = typename std::vector<T>::size_type;
+
+  static constexpr size_t NUM_BUCKETS = 0x10000;
+
+  explicit bucket_queue(const size_type capacity = 0)
+    : size_(0)
+    , base_(0)
+    , min_(0)
+    , max_(0)
+    , num_rebases_(0)
+  {
+    reserve(capacity);
+  }
+  void reserve(const size_type)
+  {
+  }
+  size_type size() const
+  {
+    return size_;
+  }
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+  void clear()
+  {
+    for (size_t i = min_; size_ > 0 && i <= max_; ++i)
+    {
+      size_ -= buckets_[i].size();
+      buckets_[i].clear();
+    }
+    size_ = 0;
+    std::fill(occupied_.begin(), occupied_.end(), 0);
+    std::fill(occupied_words_.begin(), occupied_words_.end(), 0);
+  }
+  const T& top() const
+  {
+    return buckets_[min_].back();
+  }
+  void push(const T& v)
+  {
+    buckets_[bucketIndex(v.p_)].push_back(v);
+  }
+  void push(T&& v)
+  {
+    buckets_[bucketIndex(v.p_)].push_back(std::move(v));
+  }
+  template <class... ARGS>
+  void emplace(ARGS&&... args)
+  {
+    push(T(std::forward<ARGS>(args)...));
+  }
+  void pop()
+  {
+    buckets_[min_].pop_back();
+    removed(min_);
+  }
+  void pop_back()
+  {
+    buckets_[max_].pop_back();
+    removed(max_);
+  }
+
+protected:
+  static constexpr size_t NUM_WORDS = NUM_BUCKETS / 64;
+  static constexpr size_t NUM_SUMMARY_WORDS = NUM_WORDS / 64;
+
+  std::vector<std::vector<T>> buckets_;
+  size_type size_;
+  int64_t base_;
+  size_t min_;
+  size_t max_;
+  size_t num_rebases_;
+
+  // Bitmaps of the non-empty buckets and the non-zero words of occupied_
+  // to skip empty buckets quickly.
+  std::vector<uint64_t> occupied_;
+  std::vector<uint64_t> occupied_words_;
+
+  static int64_t quantize(const float p)
+  {
+    const float k = std::floor(p * KEY_SCALE);
+    if (!(k > static_cast<float>(std::numeric_limits<int32_t>::min())))
+      return std::numeric_limits<int32_t>::min();
+    if (k > static_cast<float>(std::numeric_limits<int32_t>::max()))
+      return std::numeric_limits<int32_t>::max();
+    return static_cast<int64_t>(k);
+  }
+  void setOccupied(const size_t i)
+  {
+    occupied_[i >> 6] |= static_cast<uint64_t>(1) << (i & 63);
+    occupied_words_[i >> 12] |= static_cast<uint64_t>(1) << ((i >> 6) & 63);
+  }
+  void resetOccupied(const size_t i)
+  {
+    uint64_t& word = occupied_[i >> 6];
+    word &= ~(static_cast<uint64_t>(1) << (i & 63));
+    if (word == 0)
+      occupied_words_[i >> 12] &= ~(static_cast<uint64_t>(1) << ((i >> 6) & 63));
+  }
+  // Returns the first non-empty bucket after i. The queue must not be empty.
+  size_t nextOccupied(const size_t i) const
+  {
+    const size_t w = i >> 6;
+    const uint64_t bits = occupied_[w] & (~static_cast<uint64_t>(0) << (i & 63));
+    if (bits)
+      return (w << 6) + __builtin_ctzll(bits);
+    const size_t w0 = w + 1;
+    for (size_t s = w0 >> 6; s < NUM_SUMMARY_WORDS; ++s)
+    {
+      uint64_t words = occupied_words_[s];
+      if (s == (w0 >> 6))
+        words &= ~static_cast<uint64_t>(0) << (w0 & 63);
+      if (words)
+      {
+        const size_t nw = (s << 6) + __builtin_ctzll(words);
+        return (nw << 6) + __builtin_ctzll(occupied_[nw]);
+      }
+    }
+    return NUM_BUCKETS;
+  }
+  // Returns the last non-empty bucket before i. The queue must not be empty.
+  size_t prevOccupied(const size_t i) const
+  {
+    const size_t w = i >> 6;
+    const uint64_t bits = occupied_[w] & (~static_cast<uint64_t>(0) >> (63 - (i & 63)));
+    if (bits)
+      return (w << 6) + 63 - __builtin_clzll(bits);
+    if (w == 0)
+      return 0;
+    const size_t w0 = w - 1;
+    for (size_t s = (w0 >> 6) + 1; s-- > 0;)
+    {
+      uint64_t words = occupied_words_[s];
+      if (s == (w0 >> 6))
+        words &= ~static_cast<uint64_t>(0) >> (63 - (w0 & 63));
+      if (words)
+      {
+        const size_t pw = (s << 6) + 63 - __builtin_clzll(words);
+        return (pw << 6) + 63 - __builtin_clzll(occupied_[pw]);
+      }
+    }
+    return 0;
+  }
+  // Updates the bounds after removing an element from the bucket i.
+  void removed(const size_t i)
+  {
+    --size_;
+    if (!buckets_[i].empty())
+      return;
+    resetOccupied(i);
+    if (size_ == 0)
+      return;
+    if (i == min_)
+      min_ = nextOccupied(i);
+    if (i == max_)
+      max_ = prevOccupied(i);
+  }
+  // Redistributes all elements with the new lowest key.
+  // This is rarely called since the priority of A* search is almost monotonic.
+  void rebase(const int64_t base)
+  {
+    std::vector<T> elements;
+    elements.reserve(size_);
+    for (size_t i = min_; i <= max_; ++i)
+    {
+      std::move(buckets_[i].begin(), buckets_[i].end(), std::back_inserter(elements));
+      buckets_[i].clear();
+    }
+    std::fill(occupied_.begin(), occupied_.end(), 0);
+    std::fill(occupied_words_.begin(), occupied_words_.end(), 0);
+    base_ = base;
+    size_ = 0;
+    ++num_rebases_;
+    for (T& v : elements)
+      buckets_[bucketIndexAt(quantize(v.p_))].push_back(std::move(v));
+  }
+  size_t bucketIndex(const float p)
+  {
+    const int64_t k = quantize(p);
+    if (size_ == 0)
+      base_ = k;
+    else if (k < base_)
+      rebase(k - static_cast<int64_t>(NUM_BUCKETS / 8));
+    else if (k - base_ >= static_cast<int64_t>(NUM_BUCKETS - 1) && min_ > NUM_BUCKETS / 2)
+      rebase(base_ + min_);
+    return bucketIndexAt(k);
+  }
+  size_t bucketIndexAt(const int64_t k)
+  {
+    const size_t i = std::min<int64_t>(k - base_, NUM_BUCKETS - 1);
+    if (i >= buckets_.size())
+    {
+      buckets_.resize(i + 1);
+      occupied_.resize(NUM_WORDS, 0);
+      occupied_words_.resize(NUM_SUMMARY_WORDS, 0);
+    }
+    if (size_ == 0)
+    {
+      min_ = max_ = i;
+    }
+    else
+    {
+      min_ = std::min(min_, i);
+      max_ = std::max(max_, i);
+    }
+    if (buckets_[i].empty())
+      setOccupied(i);
+    ++size_;
+    return i;
+  }
+};
+
+// Two-level bucket queue keyed on the priority T::p_ (smaller first).
+// The elements are roughly distributed to the unsorted buckets by the priority
+// quantized by 1 / KEY_SCALE and the lowest bucket is heap ordered when it is reached.
+// Unlike bucket_queue, the elements are popped in the exact priority order.
+// pop_back() removes the worst element.
+template <class T, int KEY_SCALE = 1>
+class two_level_bucket_queue : public bucket_queue<T, KEY_SCALE>
+{
+  using Base = bucket_queue<T, KEY_SCALE>;
+
+public:
+  using typename Base::size_type;
+
+  explicit two_level_bucket_queue(const size_type capacity = 0)
+    : Base(capacity)
+    , heap_rebases_(0)
+  {
+  }
+  void clear()
+  {
+    Base::clear();
+    std::fill(heap_.begin(), heap_.end(), false);
+  }
+  const T& top() const
+  {
+    return this->buckets_[this->min_].front();
+  }
+  void push(const T& v)
+  {
+    push(T(v));
+  }
+  void push(T&& v)
+  {
+    const size_t i = this->bucketIndex(v.p_);
+    if (heap_rebases_ != this->num_rebases_)
+    {
+      heap_rebases_ = this->num_rebases_;
+      std::fill(heap_.begin(), heap_.end(), false);
+    }
+    if (heap_.size() < this->buckets_.size())
+      heap_.resize(this->buckets_.size(), false);
+
+    std::vector<T>& b = this->buckets_[i];
+    b.push_back(std::move(v));
+    if (heap_[i])
+      std::push_heap(b.begin(), b.end());
+    makeHeap(this->min_);
+  }
+  template <class... ARGS>
+  void emplace(ARGS&&... args)
+  {
+    push(T(std::forward<ARGS>(args)...));
+  }
+  void pop()
+  {
+    std::vector<T>& b = this->buckets_[this->min_];
+    std::pop_heap(b.begin(), b.end());
+    b.pop_back();
+    this->removed(this->min_);
+    if (this->size_ > 0)
+      makeHeap(this->min_);
+  }
+  void pop_back()
+  {
+    std::vector<T>& b = this->buckets_[this->max_];
+    // Worst element of the heap ordered bucket is one of the leaves.
+    const auto it = std::min_element(heap_[this->max_] ? b.begin() + b.size() / 2 : b.begin(), b.end());
+    if (it + 1 != b.end())
+    {
+      *it = std::move(b.back());
+      b.pop_back();
+      if (heap_[this->max_])
+        std::push_heap(b.begin(), it + 1);
+    }
+    else
+    {
+      b.pop_back();
+    }
+    this->removed(this->max_);
+  }
+
+protected:
+  // Buckets once reached are kept heap ordered.
+  // Other buckets are unsorted to push the elements in O(1).
+  std::vector<bool> heap_;
+  size_t heap_rebases_;
+
+  void makeHeap(const size_t i)
+  {
+    if (heap_[i])
+      return;
+    std::vector<T>& b = this->buckets_[i];
+    std::make_heap(b.begin(), b.end());
+    heap_[i] = true;
+  }
+};
+}  // namespace planner_cspace
+
+#endif  // PLANNER_CSPACE_PRIORITY_QUEUES_H
@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <omp.h>
+
+#include <planner_cspace/planner_3d/cluster_graph.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+namespace
+{
+// Entrances on the free segments longer than this are placed at the both ends.
+constexpr int MAX_ENTRANCE_WIDTH = 6;
+}  // namespace
+
+ClusterGraph::ClusterGraph()
+  : cluster_bit_(0)
+  , cluster_size_(1)
+  , path_cost_(std::numeric_limits<float>::max())
+{
+}
+
+void ClusterGraph::reset(const Vec& size, const int cluster_size, const Params& p)
+{
+  p_ = p;
+  size_ = Vec(size[0], size[1], 1);
+  cluster_bit_ = 0;
+  while ((1 << cluster_bit_) < cluster_size)
+    ++cluster_bit_;
+  cluster_size_ = 1 << cluster_bit_;
+  num_clusters_ = Vec(
+      (size_[0] + cluster_size_ - 1) >> cluster_bit_,
+      (size_[1] + cluster_size_ - 1) >> cluster_bit_,
+      1);
+  const size_t num = num_clusters_[0] * num_clusters_[1];
+  borders_x_.clear();
+  borders_x_.resize(num);
+  borders_y_.clear();
+  borders_y_.resize(num);
+  clusters_.clear();
+  clusters_.resize(num);
+  corridor_.assign(num, 1);
+  path_.clear();
+  path_cost_ = std::numeric_limits<float>::max();
+}
+
+float ClusterGraph::stepCost(const Rough& cm_rough, const Vec& p, const Vec& d) const
+{
+  const Vec next = p + d;
+  if (static_cast<unsigned int>(next[0]) >= static_cast<unsigned int>(size_[0]) ||
+      static_cast<unsigned int>(next[1]) >= static_cast<unsigned int>(size_[1]))
+    return -1;
+  const char c = cm_rough[p];
+  if (c > 99 || cm_rough[next] > 99)
+    return -1;
+  // Same as DistanceMap::fill()
+  const float len = (d[0] != 0 && d[1] != 0) ? static_cast<float>(M_SQRT2) : 1.0f;
+  return len * p_.euclid_cost[0] + p_.linear_resolution * len / 100.0 * c * p_.weight_costmap;
+}
+
+void ClusterGraph::updateBorder(
+    const Rough& cm_rough, const int cx, const int cy, const bool along_x, bool& changed)
+{
+  std::vector<Transition> transitions;
+  // along_x: border between (cx, cy) and (cx + 1, cy)
+  const int n = along_x ? cx + 1 : cy + 1;
+  if (n < num_clusters_[along_x ? 0 : 1])
+  {
+    const int axis = along_x ? 1 : 0;
+    const int begin = (along_x ? cy : cx) << cluster_bit_;
+    const int end = std::min(begin + cluster_size_, size_[axis]);
+    Vec a(0, 0, 0);
+    Vec d(0, 0, 0);
+    a[1 - axis] = (n << cluster_bit_) - 1;
+    d[1 - axis] = 1;
+
+    int run_begin = -1;
+    for (int i = begin; i <= end; ++i)
+    {
+      bool free = false;
+      if (i < end)
+      {
+        a[axis] = i;
+        free = cm_rough[a] <= 99 && cm_rough[a + d] <= 99;
+      }
+      if (free && run_begin < 0)
+      {
+        run_begin = i;
+      }
+      else if (!free && run_begin >= 0)
+      {
+        const int run_end = i - 1;
+        std::vector<int> positions;
+        if (run_end - run_begin + 1 < MAX_ENTRANCE_WIDTH)
+        {
+          positions.push_back((run_begin + run_end) / 2);
+        }
+        else
+        {
+          positions.push_back(run_begin);
+          positions.push_back(run_end);
+        }
+        for (const int pos : positions)
+        {
+          a[axis] = pos;
+          transitions.push_back(Transition{pos, stepCost(cm_rough, a, d)});
+        }
+        run_begin = -1;
+      }
+    }
+  }
+  std::vector<Transition>& border =
+      (along_x ? borders_x_ : borders_y_)[clusterIndex(cx, cy)];
+  if (border == transitions)
+    return;
+  border.swap(transitions);
+  changed = true;
+}
+
+void ClusterGraph::updateNodes(const int cx, const int cy)
+{
+  const int x0 = cx << cluster_bit_;
+  const int y0 = cy << cluster_bit_;
+  const int x1 = std::min(x0 + cluster_size_, size_[0]) - 1;
+  const int y1 = std::min(y0 + cluster_size_, size_[1]) - 1;
+  const int c = clusterIndex(cx, cy);
+
+  std::vector<Vec>& nodes = clusters_[c].nodes_;
+  nodes.clear();
+  for (const Transition& t : borders_x_[c])
+    nodes.emplace_back(x1, t.pos_, 0);
+  for (const Transition& t : borders_y_[c])
+    nodes.emplace_back(t.pos_, y1, 0);
+  if (cx > 0)
+  {
+    for (const Transition& t : borders_x_[clusterIndex(cx - 1, cy)])
+      nodes.emplace_back(x0, t.pos_, 0);
+  }
+  if (cy > 0)
+  {
+    for (const Transition& t : borders_y_[clusterIndex(cx, cy - 1)])
+      nodes.emplace_back(t.pos_, y0, 0);
+  }
+}
+
+void ClusterGraph::searchCluster(
+    const Rough& cm_rough, const int cx, const int cy, const Vec& s,
+    const std::vector<Vec>& targets, std::vector<float>& costs) const
+{
+  const int x0 = cx << cluster_bit_;
+  const int y0 = cy << cluster_bit_;
+  const int w = std::min(x0 + cluster_size_, size_[0]) - x0;
+  const int h = std::min(y0 + cluster_size_, size_[1]) - y0;
+
+  costs.assign(targets.size(), std::numeric_limits<float>::max());
+  if (cm_rough[s] > 99)
+    return;
+
+  std::vector<float> g(w * h, std::numeric_limits<float>::max());
+  std::vector<char> is_target(w * h, 0);
+  size_t num_targets = 0;
+  for (const Vec& t : targets)
+  {
+    char& flag = is_target[(t[1] - y0) * w + (t[0] - x0)];
+    if (!flag)
+      ++num_targets;
+    flag = 1;
+  }
+
+  using Entry = std::pair<float, int>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+  const int s_index = (s[1] - y0) * w + (s[0] - x0);
+  g[s_index] = 0;
+  open.emplace(0, s_index);
+  while (!open.empty() && num_targets > 0)
+  {
+    const Entry center = open.top();
+    open.pop();
+    if (center.first > g[center.second])
+      continue;
+    if (is_target[center.second])
+    {
+      // Settled
+      is_target[center.second] = 0;
+      --num_targets;
+    }
+    const Vec p(x0 + center.second % w, y0 + center.second / w, 0);
+    Vec d(0, 0, 0);
+    for (d[0] = -1; d[0] <= 1; ++d[0])
+    {
+      for (d[1] = -1; d[1] <= 1; ++d[1])
+      {
+        if (d[0] == 0 && d[1] == 0)
+          continue;
+        const Vec next = p + d;
+        if (next[0] < x0 || next[1] < y0 || next[0] >= x0 + w || next[1] >= y0 + h)
+          continue;
+        const float cost = stepCost(cm_rough, p, d);
+        if (cost < 0)
+          continue;
+        const int next_index = (next[1] - y0) * w + (next[0] - x0);
+        const float cost_next = center.first + cost;
+        if (g[next_index] > cost_next)
+        {
+          g[next_index] = cost_next;
+          open.emplace(cost_next, next_index);
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < targets.size(); ++i)
+    costs[i] = g[(targets[i][1] - y0) * w + (targets[i][0] - x0)];
+}
+
+void ClusterGraph::updateCluster(const Rough& cm_rough, const int cx, const int cy)
+{
+  updateNodes(cx, cy);
+
+  Cluster& cluster = clusters_[clusterIndex(cx, cy)];
+  const size_t n = cluster.nodes_.size();
+  cluster.costs_.resize(n * n);
+  std::vector<float> costs;
+  for (size_t i = 0; i < n; ++i)
+  {
+    searchCluster(cm_rough, cx, cy, cluster.nodes_[i], cluster.nodes_, costs);
+    std::copy(costs.begin(), costs.end(), cluster.costs_.begin() + i * n);
+  }
+}
+
+void ClusterGraph::update(const Rough& cm_rough, const Vec& min, const Vec& max)
+{
+  const int cx0 = std::max(0, min[0]) >> cluster_bit_;
+  const int cy0 = std::max(0, min[1]) >> cluster_bit_;
+  const int cx1 = std::min(std::min(max[0], size_[0]) - 1, size_[0] - 1) >> cluster_bit_;
+  const int cy1 = std::min(std::min(max[1], size_[1]) - 1, size_[1] - 1) >> cluster_bit_;
+  if (cx1 < cx0 || cy1 < cy0)
+    return;
+
+  std::vector<char> dirty(clusters_.size(), 0);
+  for (int cy = cy0; cy <= cy1; ++cy)
+  {
+    for (int cx = cx0; cx <= cx1; ++cx)
+      dirty[clusterIndex(cx, cy)] = 1;
+  }
+  // Borders of the updated clusters
+  for (int cy = cy0; cy <= cy1; ++cy)
+  {
+    for (int cx = std::max(0, cx0 - 1); cx <= cx1; ++cx)
+    {
+      bool changed = false;
+      updateBorder(cm_rough, cx, cy, true, changed);
+      if (changed)
+      {
+        dirty[clusterIndex(cx, cy)] = 1;
+        if (cx + 1 < num_clusters_[0])
+          dirty[clusterIndex(cx + 1, cy)] = 1;
+      }
+    }
+  }
+  for (int cy = std::max(0, cy0 - 1); cy <= cy1; ++cy)
+  {
+    for (int cx = cx0; cx <= cx1; ++cx)
+    {
+      bool changed = false;
+      updateBorder(cm_rough, cx, cy, false, changed);
+      if (changed)
+      {
+        dirty[clusterIndex(cx, cy)] = 1;
+        if (cy + 1 < num_clusters_[1])
+          dirty[clusterIndex(cx, cy + 1)] = 1;
+      }
+    }
+  }
+
+  std::vector<int> dirty_clusters;
+  for (size_t i = 0; i < dirty.size(); ++i)
+  {
+    if (dirty[i])
+      dirty_clusters.push_back(i);
+  }
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < dirty_clusters.size(); ++i)
+  {
+    const int c = dirty_clusters[i];
+    updateCluster(cm_rough, c % num_clusters_[0], c / num_clusters_[0]);
+  }
+}
+
+bool ClusterGraph::updateCorridor(const Rough& cm_rough, const Vec& s_raw, const Vec& e_raw, const int margin)
+{
+  path_.clear();
+  path_cost_ = std::numeric_limits<float>::max();
+  std::fill(corridor_.begin(), corridor_.end(), 0);
+
+  const Vec s(s_raw[0], s_raw[1], 0);
+  const Vec e(e_raw[0], e_raw[1], 0);
+  if (static_cast<unsigned int>(s[0]) >= static_cast<unsigned int>(size_[0]) ||
+      static_cast<unsigned int>(s[1]) >= static_cast<unsigned int>(size_[1]) ||
+      static_cast<unsigned int>(e[0]) >= static_cast<unsigned int>(size_[0]) ||
+      static_cast<unsigned int>(e[1]) >= static_cast<unsigned int>(size_[1]))
+    return false;
+
+  const int scx = s[0] >> cluster_bit_;
+  const int scy = s[1] >> cluster_bit_;
+  const int ecx = e[0] >> cluster_bit_;
+  const int ecy = e[1] >> cluster_bit_;
+  const int sc = clusterIndex(scx, scy);
+  const int ec = clusterIndex(ecx, ecy);
+
+  // Node IDs are assigned in the order of the clusters. Goal node has the last ID.
+  std::vector<int> offsets(clusters_.size() + 1, 0);
+  for (size_t c = 0; c < clusters_.size(); ++c)
+    offsets[c + 1] = offsets[c] + clusters_[c].nodes_.size();
+  const int goal_id = offsets.back();
+  const int start_parent = -2;
+
+  std::vector<float> g(goal_id + 1, std::numeric_limits<float>::max());
+  std::vector<int> parents(goal_id + 1, -1);
+  std::vector<int> node_clusters(goal_id + 1, -1);
+  for (size_t c = 0; c < clusters_.size(); ++c)
+    std::fill(node_clusters.begin() + offsets[c], node_clusters.begin() + offsets[c + 1], c);
+
+  const auto position = [this, &offsets, &node_clusters, &e, goal_id](const int id)
+  {
+    if (id == goal_id)
+      return e;
+    const int c = node_clusters[id];
+    return clusters_[c].nodes_[id - offsets[c]];
+  };
+  const auto heuristic = [this, &e](const Vec& p)
+  {
+    return std::sqrt(static_cast<float>((e - p).sqlen())) * p_.euclid_cost[0];
+  };
+
+  using Entry = std::pair<float, int>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+  const auto relax = [&g, &parents, &open, &heuristic, &position](const int id, const int parent, const float cost)
+  {
+    if (g[id] <= cost)
+      return;
+    g[id] = cost;
+    parents[id] = parent;
+    open.emplace(cost + heuristic(position(id)), id);
+  };
+
+  std::vector<float> goal_costs;
+  searchCluster(cm_rough, ecx, ecy, e, clusters_[ec].nodes_, goal_costs);
+  {
+    std::vector<float> start_costs;
+    searchCluster(cm_rough, scx, scy, s, clusters_[sc].nodes_, start_costs);
+    for (size_t i = 0; i < start_costs.size(); ++i)
+    {
+      if (start_costs[i] != std::numeric_limits<float>::max())
+        relax(offsets[sc] + i, start_parent, start_costs[i]);
+    }
+    if (sc == ec)
+    {
+      std::vector<float> direct_cost;
+      searchCluster(cm_rough, scx, scy, s, std::vector<Vec>(1, e), direct_cost);
+      if (direct_cost[0] != std::numeric_limits<float>::max())
+        relax(goal_id, start_parent, direct_cost[0]);
+    }
+  }
+
+  while (!open.empty())
+  {
+    const Entry center = open.top();
+    open.pop();
+    const int id = center.second;
+    if (id == goal_id)
+      break;
+    const float gc = g[id];
+    if (center.first > gc + heuristic(position(id)))
+      continue;
+
+    const int c = node_clusters[id];
+    const int cx = c % num_clusters_[0];
+    const int cy = c / num_clusters_[0];
+    const Cluster& cluster = clusters_[c];
+    const size_t n = cluster.nodes_.size();
+    const size_t i = id - offsets[c];
+
+    // Intra-cluster edges
+    for (size_t j = 0; j < n; ++j)
+    {
+      const float cost = cluster.costs_[i * n + j];
+      if (j != i && cost != std::numeric_limits<float>::max())
+        relax(offsets[c] + j, id, gc + cost);
+    }
+    if (c == ec && goal_costs[i] != std::numeric_limits<float>::max())
+      relax(goal_id, id, gc + goal_costs[i]);
+
+    // Inter-cluster edge. See updateNodes() for the order of the nodes.
+    const size_t num_px = borders_x_[c].size();
+    const size_t num_py = borders_y_[c].size();
+    const size_t num_mx = cx > 0 ? borders_x_[clusterIndex(cx - 1, cy)].size() : 0;
+    if (i < num_px)
+    {
+      const int nc = clusterIndex(cx + 1, cy);
+      const size_t k = i;
+      relax(
+          offsets[nc] + borders_x_[nc].size() + borders_y_[nc].size() + k, id,
+          gc + borders_x_[c][k].cost_);
+    }
+    else if (i < num_px + num_py)
+    {
+      const int nc = clusterIndex(cx, cy + 1);
+      const size_t k = i - num_px;
+      const size_t num_nc_mx = cx > 0 ? borders_x_[clusterIndex(cx - 1, cy + 1)].size() : 0;
+      relax(
+          offsets[nc] + borders_x_[nc].size() + borders_y_[nc].size() + num_nc_mx + k, id,
+          gc + borders_y_[c][k].cost_);
+    }
+    else if (i < num_px + num_py + num_mx)
+    {
+      const int nc = clusterIndex(cx - 1, cy);
+      const size_t k = i - num_px - num_py;
+      relax(offsets[nc] + k, id, gc + borders_x_[nc][k].cost_);
+    }
+    else
+    {
+      const int nc = clusterIndex(cx, cy - 1);
+      const size_t k = i - num_px - num_py - num_mx;
+      relax(offsets[nc] + borders_x_[nc].size() + k, id, gc + borders_y_[nc][k].cost_);
+    }
+  }
+  if (g[goal_id] == std::numeric_limits<float>::max())
+    return false;
+
+  path_cost_ = g[goal_id];
+  for (int id = goal_id; id != start_parent; id = parents[id])
+    path_.push_back(position(id));
+  path_.push_back(s);
+  std::reverse(path_.begin(), path_.end());
+
+  for (const Vec& p : path_)
+  {
+    const int cx = p[0] >> cluster_bit_;
+    const int cy = p[1] >> cluster_bit_;
+    for (int y = std::max(0, cy - margin); y <= std::min(num_clusters_[1] - 1, cy + margin); ++y)
+    {
+      for (int x = std::max(0, cx - margin); x <= std::min(num_clusters_[0] - 1, cx + margin); ++x)
+        corridor_[clusterIndex(x, y)] = 1;
+    }
+  }
+  return true;
+}
+
+void ClusterGraph::clearCorridor()
+{
+  std::fill(corridor_.begin(), corridor_.end(), 1);
+  path_.clear();
+  path_cost_ = std::numeric_limits<float>::max();
+}
+
+size_t ClusterGraph::numNodes() const
+{
+  size_t num = 0;
+  for (const Cluster& c : clusters_)
+    num += c.nodes_.size();
+  return num;
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
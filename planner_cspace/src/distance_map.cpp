@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <omp.h>
+#include <ros/console.h>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/reservable_priority_queue.h>
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+DistanceMap::DistanceMap(const Rough& cm_rough, const CostmapBBF& bbf_costmap)
+  : cm_rough_(cm_rough)
+  , bbf_costmap_(bbf_costmap)
+{
+}
+
+void DistanceMap::init(const costmap_cspace_msgs::MapMetaData3D& map_info, const Params& p)
+{
+  map_info_ = map_info;
+  p_ = p;
+
+  search_diffs_.clear();
+  Vec d;
+  d[2] = 0;
+  const int range_rough = 4;
+  for (d[0] = -range_rough; d[0] <= range_rough; d[0]++)
+  {
+    for (d[1] = -range_rough; d[1] <= range_rough; d[1]++)
+    {
+      if (d[0] == 0 && d[1] == 0)
+        continue;
+      if (d.sqlen() > range_rough * range_rough)
+        continue;
+
+      SearchDiffs diffs;
+
+      const int dist = d.len();
+      const float dpx = static_cast<float>(d[0]) / dist;
+      const float dpy = static_cast<float>(d[1]) / dist;
+      Vecf pos(0, 0, 0);
+      for (int i = 0; i < dist; i++)
+      {
+        Vec ipos(pos);
+        if (diffs.pos.size() == 0 || diffs.pos.back() != ipos)
+        {
+          diffs.pos.push_back(std::move(ipos));
+        }
+        pos[0] += dpx;
+        pos[1] += dpy;
+      }
+      diffs.grid_to_len = d.gridToLenFactor();
+      // Same as GridAstarModel3D::euclidCostRough()
+      diffs.euclid_cost = std::sqrt(d[0] * d[0] + d[1] * d[1]) * p_.euclid_cost[0];
+      diffs.d = d;
+      search_diffs_.push_back(std::move(diffs));
+    }
+  }
+}
+
+bool DistanceMap::edgeCost(const Vec& p, const SearchDiffs& ds, float& cost) const
+{
+  float sum = 0, sum_hist = 0;
+  for (const auto& d : ds.pos)
+  {
+    const Vec pos = p + d;
+    const char c = cm_rough_[pos];
+    if (c > 99)
+      return false;
+    sum += c;
+    sum_hist += bbf_costmap_.getCost(pos);
+  }
+  cost =
+      ds.euclid_cost +
+      (map_info_.linear_resolution * ds.grid_to_len / 100.0) *
+          (sum * p_.weight_costmap + sum_hist * p_.weight_remembered);
+
+  if (cost < 0)
+  {
+    cost = 0;
+    ROS_WARN_THROTTLE(1.0, "Negative cost value is detected. Limited to zero.");
+  }
+  return true;
+}
+
+const float& DistanceMap::startCost(Gridmap& g, const Vec& s) const
+{
+  static const float unreachable = std::numeric_limits<float>::max();
+  if (static_cast<size_t>(s[0]) >= static_cast<size_t>(map_info_.width) ||
+      static_cast<size_t>(s[1]) >= static_cast<size_t>(map_info_.height))
+    return unreachable;
+  return g[s];
+}
+
+void DistanceMap::fill(
+    reservable_priority_queue<Astar::PriorityVec>& open,
+    Gridmap& g,
+    const Vec& s,
+    const ClusterGraph* corridor) const
+{
+  if (p_.delta_stepping_width > 0)
+    fillDeltaStepping(open, g, s, corridor);
+  else
+    fillPriorityQueue(open, g, s, corridor);
+}
+
+void DistanceMap::fillPriorityQueue(
+    reservable_priority_queue<Astar::PriorityVec>& open,
+    Gridmap& g,
+    const Vec& s,
+    const ClusterGraph* corridor) const
+{
+  const Vec s_rough(s[0], s[1], 0);
+  const float& g_start = startCost(g, s_rough);
+
+  std::vector<Astar::PriorityVec> centers;
+  centers.reserve(p_.num_cost_estim_task);
+
+#pragma omp parallel
+  {
+    std::vector<Astar::GridmapUpdate> updates;
+    updates.reserve(p_.num_cost_estim_task * search_diffs_.size() / omp_get_num_threads());
+
+    const float range_overshoot = p_.euclid_cost[0] * (p_.range + p_.local_range + p_.longcut_range);
+
+    while (true)
+    {
+#pragma omp barrier
+#pragma omp single
+      {
+        centers.clear();
+        for (size_t i = 0; i < static_cast<size_t>(p_.num_cost_estim_task);)
+        {
+          if (open.size() < 1)
+            break;
+          // Entries beyond the range are kept in the open list to continue the search on update().
+          if (open.top().p_raw_ - range_overshoot > g_start)
+            break;
+          Astar::PriorityVec center(open.top());
+          open.pop();
+          if (center.p_raw_ != g[center.v_])
+            continue;
+          centers.emplace_back(std::move(center));
+          ++i;
+        }
+      }  // omp single
+
+      if (centers.size() == 0)
+        break;
+      updates.clear();
+
+#pragma omp for schedule(static)
+      for (auto it = centers.cbegin(); it < centers.cend(); ++it)
+      {
+        const Vec p = it->v_;
+
+        for (const SearchDiffs& ds : search_diffs_)
+        {
+          const Vec d = ds.d;
+          const Vec next = p + d;
+
+          if (static_cast<size_t>(next[0]) >= static_cast<size_t>(map_info_.width) ||
+              static_cast<size_t>(next[1]) >= static_cast<size_t>(map_info_.height))
+            continue;
+          if (corridor && !corridor->inCorridor(next))
+            continue;
+
+          const float gnext = g[next];
+
+          if (gnext < g[p] + ds.euclid_cost)
+          {
+            // Skip as this search task has no chance to find better way.
+            continue;
+          }
+
+          float cost;
+          if (!edgeCost(p, ds, cost))
+            continue;
+
+          const float cost_next = it->p_raw_ + cost;
+          if (gnext > cost_next)
+          {
+            updates.emplace_back(p, next, cost_next, cost_next);
+          }
+        }
+      }
+#pragma omp barrier
+#pragma omp critical
+      {
+        for (const Astar::GridmapUpdate& u : updates)
+        {
+          if (g[u.getPos()] > u.getCost())
+          {
+            g[u.getPos()] = u.getCost();
+            open.push(std::move(u.getPriorityVec()));
+          }
+        }
+      }  // omp critical
+    }
+  }  // omp parallel
+}
+
+void DistanceMap::fillDeltaStepping(
+    reservable_priority_queue<Astar::PriorityVec>& open,
+    Gridmap& g,
+    const Vec& s,
+    const ClusterGraph* corridor) const
+{
+  const Vec s_rough(s[0], s[1], 0);
+  const float& g_start = startCost(g, s_rough);
+  const float range_overshoot = p_.euclid_cost[0] * (p_.range + p_.local_range + p_.longcut_range);
+  const float delta = p_.delta_stepping_width;
+  // Nested parallel regions run on a single thread unless nesting is enabled.
+  const int num_owners = omp_in_parallel() ? 1 : omp_get_max_threads();
+
+  // Each owner updates the cells on the diagonal stripes of the 16x16 grids,
+  // so that the cost map is written without locks.
+  const auto owner = [num_owners](const Vec& p)
+  {
+    return ((p[0] >> 4) + (p[1] >> 4)) % num_owners;
+  };
+  const auto bucketIndex = [delta](const float cost)
+  {
+    return static_cast<int64_t>(std::floor(cost / delta));
+  };
+
+  using Bucket = std::vector<Astar::PriorityVec>;
+  std::vector<std::map<int64_t, Bucket>> buckets(num_owners);
+  // Relaxation requests from the searching thread to the owner.
+  std::vector<std::vector<Bucket>> requests(num_owners, std::vector<Bucket>(num_owners));
+
+  while (open.size() > 0)
+  {
+    const Astar::PriorityVec& center = open.top();
+    if (center.p_raw_ == g[center.v_])
+      buckets[owner(center.v_)][bucketIndex(center.p_raw_)].push_back(center);
+    open.pop();
+  }
+
+  Bucket frontier;
+  bool finished = false;
+
+#pragma omp parallel num_threads(num_owners)
+  {
+    const int id = omp_get_thread_num();
+    while (true)
+    {
+#pragma omp single
+      {
+        int64_t current = std::numeric_limits<int64_t>::max();
+        for (const auto& b : buckets)
+        {
+          if (!b.empty() && b.begin()->first < current)
+            current = b.begin()->first;
+        }
+        finished =
+            current == std::numeric_limits<int64_t>::max() ||
+            current * delta - range_overshoot > g_start;
+        frontier.clear();
+        if (!finished)
+        {
+          for (auto& b : buckets)
+          {
+            const auto it = b.find(current);
+            if (it == b.end())
+              continue;
+            frontier.insert(frontier.end(), it->second.begin(), it->second.end());
+            b.erase(it);
+          }
+        }
+      }  // omp single
+      if (finished)
+        break;
+
+      // Relax all the edges from the current bucket. g is read-only in this phase.
+#pragma omp for schedule(dynamic, 64)
+      for (size_t i = 0; i < frontier.size(); ++i)
+      {
+        const Astar::PriorityVec& center = frontier[i];
+        const Vec& p = center.v_;
+        if (center.p_raw_ != g[p])
+          continue;
+
+        for (const SearchDiffs& ds : search_diffs_)
+        {
+          const Vec next = p + ds.d;
+          if (static_cast<size_t>(next[0]) >= static_cast<size_t>(map_info_.width) ||
+              static_cast<size_t>(next[1]) >= static_cast<size_t>(map_info_.height))
+            continue;
+          if (corridor && !corridor->inCorridor(next))
+            continue;
+          const float gnext = g[next];
+          if (gnext < center.p_raw_ + ds.euclid_cost)
+            continue;
+
+          float cost;
+          if (!edgeCost(p, ds, cost))
+            continue;
+          const float cost_next = center.p_raw_ + cost;
+          if (gnext > cost_next)
+            requests[id][owner(next)].emplace_back(cost_next, cost_next, next);
+        }
+      }  // omp for
+
+      // Apply the requests. Each owner writes its own cells and buckets.
+#pragma omp for schedule(static, 1)
+      for (int o = 0; o < num_owners; ++o)
+      {
+        for (std::vector<Bucket>& r : requests)
+        {
+          for (const Astar::PriorityVec& u : r[o])
+          {
+            if (g[u.v_] > u.p_raw_)
+            {
+              g[u.v_] = u.p_raw_;
+              buckets[o][bucketIndex(u.p_raw_)].push_back(u);
+            }
+          }
+          r[o].clear();
+        }
+      }  // omp for
+    }
+  }  // omp parallel
+
+  // Keep the remaining entries for update().
+  for (const auto& b : buckets)
+  {
+    for (const auto& bucket : b)
+    {
+      for (const Astar::PriorityVec& center : bucket.second)
+        open.push(center);
+    }
+  }
+}
+
+float DistanceMap::minIncomingCost(const Gridmap& g, const Vec& q, const ClusterGraph* corridor) const
+{
+  float cost_min = std::numeric_limits<float>::max();
+  for (const SearchDiffs& ds : search_diffs_)
+  {
+    const Vec p = q - ds.d;
+    if (static_cast<size_t>(p[0]) >= static_cast<size_t>(map_info_.width) ||
+        static_cast<size_t>(p[1]) >= static_cast<size_t>(map_info_.height))
+      continue;
+    if (corridor && !corridor->inCorridor(p))
+      continue;
+    const float gp = g[p];
+    if (gp == std::numeric_limits<float>::max() || gp + ds.euclid_cost >= cost_min)
+      continue;
+    float cost;
+    if (!edgeCost(p, ds, cost))
+      continue;
+    // Same arithmetic as fill() to compare the costs exactly.
+    const float cost_next = gp + cost;
+    if (cost_next < cost_min)
+      cost_min = cost_next;
+  }
+  return cost_min;
+}
+
+void DistanceMap::update(
+    reservable_priority_queue<Astar::PriorityVec>& open,
+    Gridmap& g,
+    const Vec& s,
+    const Vec& e,
+    const Vec& min,
+    const Vec& max,
+    const ClusterGraph* corridor) const
+{
+  const Vec e_rough(e[0], e[1], 0);
+  // Edges from the grids within the search range of the changed grids are affected.
+  const int margin = 8;
+  const Vec region_min(
+      std::max(0, min[0] - margin),
+      std::max(0, min[1] - margin), 0);
+  const Vec region_max(
+      std::min(static_cast<int>(map_info_.width), max[0] + margin),
+      std::min(static_cast<int>(map_info_.height), max[1] + margin), 1);
+
+  const auto isSupported = [](const float cost, const float g_current)
+  {
+    return cost <= g_current + std::abs(g_current) * 1e-6f;
+  };
+
+  // Find the grids which lost the path giving the current cost.
+  reservable_priority_queue<Astar::PriorityVec> invalid_open;
+  for (Vec p(region_min[0], region_min[1], 0); p[1] < region_max[1]; ++p[1])
+  {
+    for (p[0] = region_min[0]; p[0] < region_max[0]; ++p[0])
+    {
+      const float gp = g[p];
+      if (gp == std::numeric_limits<float>::max() || p == e_rough)
+        continue;
+      if (!isSupported(minIncomingCost(g, p, corridor), gp))
+        invalid_open.emplace(gp, gp, p);
+    }
+  }
+
+  // Invalidate the grids depending on them in the ascending order of the cost,
+  // so that the grids which still have another path are kept.
+  std::vector<Vec> invalidated;
+  while (invalid_open.size() > 0)
+  {
+    const Astar::PriorityVec center = invalid_open.top();
+    invalid_open.pop();
+    const Vec& p = center.v_;
+    if (g[p] != center.p_raw_)
+      continue;
+    if (isSupported(minIncomingCost(g, p, corridor), center.p_raw_))
+      continue;
+    g[p] = std::numeric_limits<float>::max();
+    invalidated.push_back(p);
+
+    for (const SearchDiffs& ds : search_diffs_)
+    {
+      const Vec next = p + ds.d;
+      if (static_cast<size_t>(next[0]) >= static_cast<size_t>(map_info_.width) ||
+          static_cast<size_t>(next[1]) >= static_cast<size_t>(map_info_.height))
+        continue;
+      const float gnext = g[next];
+      // Costs supported within the tolerance must also be checked.
+      if (gnext == std::numeric_limits<float>::max() || !isSupported(center.p_raw_ + ds.euclid_cost, gnext) ||
+          next == e_rough)
+        continue;
+      invalid_open.emplace(gnext, gnext, next);
+    }
+  }
+
+  // Reopen the invalidated grids and the grids which got a cheaper path.
+  const auto reopen = [this, &g, &open, corridor](const Vec& p)
+  {
+    const float cost = minIncomingCost(g, p, corridor);
+    if (cost < g[p])
+    {
+      g[p] = cost;
+      open.emplace(cost, cost, p);
+    }
+  };
+  for (const Vec& p : invalidated)
+    reopen(p);
+  for (Vec p(region_min[0], region_min[1], 0); p[1] < region_max[1]; ++p[1])
+  {
+    for (p[0] = region_min[0]; p[0] < region_max[0]; ++p[0])
+    {
+      if (p == e_rough)
+        continue;
+      if (corridor && !corridor->inCorridor(p))
+        continue;
+      reopen(p);
+    }
+  }
+
+  fill(open, g, s, corridor);
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/reservable_priority_queue.h>
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+#include <planner_cspace/planner_3d/landmark_heuristic.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+constexpr uint16_t LandmarkHeuristic::UNREACHABLE;
+
+LandmarkHeuristic::LandmarkHeuristic()
+  : size_(0, 0, 0)
+{
+}
+
+void LandmarkHeuristic::clear()
+{
+  landmarks_.clear();
+  costs_.clear();
+  resolutions_.clear();
+}
+
+void LandmarkHeuristic::build(
+    const Rough& cm_rough,
+    const costmap_cspace_msgs::MapMetaData3D& map_info,
+    const DistanceMap::Params& p,
+    const int num_landmarks)
+{
+  clear();
+  size_ = Vec(static_cast<int>(map_info.width), static_cast<int>(map_info.height), 1);
+  if (num_landmarks <= 0)
+    return;
+
+  // Remembered costs are not counted since they may be forgotten later.
+  CostmapBBF bbf;
+  bbf.reset(size_);
+  bbf.clear();
+  DistanceMap dm(cm_rough, bbf);
+  dm.init(map_info, p);
+
+  Gridmap g;
+  g.reset(size_);
+  reservable_priority_queue<Astar::PriorityVec> open;
+  open.reserve(numGrids() / 2);
+  const auto fillFrom = [&g, &open, &dm](const Vec& l)
+  {
+    g.clear(std::numeric_limits<float>::max());
+    open.clear();
+    g[l] = 0;
+    open.emplace(0.0f, 0.0f, l);
+    // The start out of the map propagates the costs to the whole map.
+    dm.fill(open, g, Vec(-1, -1, 0));
+  };
+
+  // The farthest grid from an arbitrary free grid is the first landmark.
+  Vec next(0, 0, 0);
+  bool found = false;
+  Vec pos(0, 0, 0);
+  for (pos[1] = 0; pos[1] < size_[1] && !found; pos[1]++)
+  {
+    for (pos[0] = 0; pos[0] < size_[0]; pos[0]++)
+    {
+      if (cm_rough[pos] < 100)
+      {
+        next = pos;
+        found = true;
+        break;
+      }
+    }
+  }
+  if (!found)
+    return;
+  fillFrom(next);
+  float farthest_cost = -1;
+  for (pos[1] = 0; pos[1] < size_[1]; pos[1]++)
+  {
+    for (pos[0] = 0; pos[0] < size_[0]; pos[0]++)
+    {
+      const float c = g[pos];
+      if (c != std::numeric_limits<float>::max() && c > farthest_cost)
+      {
+        farthest_cost = c;
+        next = pos;
+      }
+    }
+  }
+
+  // The next landmark is the farthest grid from the selected landmarks.
+  std::vector<float> min_costs(numGrids(), std::numeric_limits<float>::max());
+  for (int i = 0; i < num_landmarks; ++i)
+  {
+    fillFrom(next);
+    landmarks_.push_back(next);
+
+    float max_cost = 0;
+    for (pos[1] = 0; pos[1] < size_[1]; pos[1]++)
+    {
+      for (pos[0] = 0; pos[0] < size_[0]; pos[0]++)
+      {
+        const float c = g[pos];
+        if (c != std::numeric_limits<float>::max() && c > max_cost)
+          max_cost = c;
+      }
+    }
+    const float resolution = max_cost > 0 ? max_cost / (UNREACHABLE - 1) : 1.0f;
+    resolutions_.push_back(resolution);
+
+    costs_.resize(costs_.size() + numGrids());
+    uint16_t* const q = &costs_[costs_.size() - numGrids()];
+    farthest_cost = 0;
+    for (pos[1] = 0; pos[1] < size_[1]; pos[1]++)
+    {
+      for (pos[0] = 0; pos[0] < size_[0]; pos[0]++)
+      {
+        const size_t a = addr(pos);
+        const float c = g[pos];
+        if (c == std::numeric_limits<float>::max())
+        {
+          q[a] = UNREACHABLE;
+          continue;
+        }
+        // Rounded down to keep the lower bound.
+        q[a] = static_cast<uint16_t>(std::min<float>(std::floor(c / resolution), UNREACHABLE - 1));
+        min_costs[a] = std::min(min_costs[a], c);
+        if (min_costs[a] > farthest_cost)
+        {
+          farthest_cost = min_costs[a];
+          next = pos;
+        }
+      }
+    }
+    // All reachable grids are the landmarks.
+    if (farthest_cost <= 0)
+      break;
+  }
+}
+
+float LandmarkHeuristic::estimate(const Vec& p, const Vec& e) const
+{
+  const size_t n = numGrids();
+  const size_t ap = addr(p);
+  const size_t ae = addr(e);
+  float cost = 0;
+  for (size_t k = 0; k < landmarks_.size(); ++k)
+  {
+    const uint16_t qe = costs_[k * n + ae];
+    if (qe == UNREACHABLE)
+      continue;
+    const uint16_t qp = costs_[k * n + ap];
+    // p is not reachable from e if p is not reachable from the landmark but e is.
+    if (qp == UNREACHABLE)
+      return std::numeric_limits<float>::max();
+    // cost(l, p) <= cost(l, e) + cost(e, p)
+    // The quantized cost of e is rounded down, so one step is subtracted.
+    if (qp > qe + 1)
+      cost = std::max(cost, (qp - qe - 1) * resolutions_[k]);
+  }
+  return cost;
+}
+
+void LandmarkHeuristic::fill(const Vec& e, Gridmap& g) const
+{
+  const size_t n = numGrids();
+  const size_t ae = addr(e);
+  std::vector<uint16_t> qe(landmarks_.size());
+  for (size_t k = 0; k < landmarks_.size(); ++k)
+    qe[k] = costs_[k * n + ae];
+
+#pragma omp parallel for schedule(static)
+  for (int y = 0; y < size_[1]; ++y)
+  {
+    Vec p(0, y, 0);
+    for (p[0] = 0; p[0] < size_[0]; p[0]++)
+    {
+      const size_t ap = addr(p);
+      float cost = 0;
+      for (size_t k = 0; k < landmarks_.size(); ++k)
+      {
+        if (qe[k] == UNREACHABLE)
+          continue;
+        const uint16_t qp = costs_[k * n + ap];
+        if (qp == UNREACHABLE)
+        {
+          cost = std::numeric_limits<float>::max();
+          break;
+        }
+        if (qp > qe[k] + 1)
+          cost = std::max(cost, (qp - qe[k] - 1) * resolutions_[k]);
+      }
+      g[p] = cost;
+    }
+  }
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <numeric>
+#include <vector>
+
+#include <omp.h>
+
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/planner_3d/grid_astar_model.h>
+#include <planner_cspace/planner_3d/grid_astar_model_impl.h>
+#include <planner_cspace/planner_3d/make_plan_worker.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+MakePlanWorker::MakePlanWorker()
+  : distance_map_(cm_rough_, bbf_costmap_)
+  , has_cost_estim_(false)
+{
+}
+
+void MakePlanWorker::reset(const Params& p)
+{
+  p_ = p;
+  // Remembered costs are not used in 2D search.
+  p_.distance_map.weight_remembered = 0;
+
+  const Vec size(static_cast<int>(p_.map_info.width), static_cast<int>(p_.map_info.height), 1);
+  as_.reset(size);
+  cm_rough_.reset(size);
+  cost_estim_cache_.reset(size);
+  cost_estim_open_.clear();
+  cost_estim_open_.reserve(p_.map_info.width * p_.map_info.height / 2);
+  cm_rough_mask_.reset(size);
+  bbf_costmap_.reset(size);
+  bbf_costmap_.clear();
+  distance_map_.init(p_.map_info, p_.distance_map);
+
+  // Only the 2D model is built, since the 3D motion cache is not used by the 2D search.
+  model_2d_.reset(
+      new GridAstarModel2DPlanner(
+          p_.map_info, p_.euclid_cost,
+          cost_estim_cache_, cm_rough_,
+          p_.cc, p_.range, true, p_.motion_cache_dir));
+  model_2d_->setLethalMask(&cm_rough_mask_);
+  path_interpolator_.reset(p_.map_info.angular_resolution, p_.range);
+  has_cost_estim_ = false;
+}
+
+void MakePlanWorker::setMap(const Rough& cm_rough, const LethalMask& cm_rough_mask)
+{
+  cm_rough_ = cm_rough;
+  cm_rough_mask_ = cm_rough_mask;
+  has_cost_estim_ = false;
+}
+
+bool MakePlanWorker::search(const Vec& s, const Vec& e, std::list<Vec>& path)
+{
+  const Vec s_rough(s[0], s[1], 0);
+  const Vec e_rough(e[0], e[1], 0);
+  if (!has_cost_estim_ || cost_estim_goal_ != e_rough)
+  {
+    cost_estim_cache_.clear(std::numeric_limits<float>::max());
+    cost_estim_open_.clear();
+    cost_estim_cache_[e_rough] = 0;
+    cost_estim_open_.emplace(0.0f, 0.0f, e_rough);
+    cost_estim_goal_ = e_rough;
+    has_cost_estim_ = true;
+  }
+  // Continues the previous fill to the same goal until the cost of the start is determined.
+  distance_map_.fill(cost_estim_open_, cost_estim_cache_, s_rough);
+  if (cost_estim_cache_[s_rough] == std::numeric_limits<float>::max())
+    return false;
+
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+  std::vector<GridAstarModel3D::VecWithCost> starts;
+  starts.emplace_back(s_rough);
+  return as_.search(
+      starts, e_rough, path,
+      model_2d_,
+      cb_progress,
+      0, p_.time_limit, p_.find_best);
+}
+
+void MakePlanWorker::search(const std::vector<Query>& queries, std::vector<std::list<Vec>>& paths)
+{
+  std::vector<size_t> order(queries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(
+      order.begin(), order.end(),
+      [&queries](const size_t a, const size_t b)
+      {
+        const Vec& ga = queries[a].goal;
+        const Vec& gb = queries[b].goal;
+        return ga[1] < gb[1] || (ga[1] == gb[1] && ga[0] < gb[0]);
+      });
+
+  paths.clear();
+  paths.resize(queries.size());
+  for (const size_t i : order)
+  {
+    if (!search(queries[i].start, queries[i].goal, paths[i]))
+      paths[i].clear();
+  }
+}
+
+void MakePlanWorker::costs(
+    const std::vector<Vec>& starts, const std::vector<Vec>& goals,
+    std::vector<float>& costs) const
+{
+  const Vec size(static_cast<int>(p_.map_info.width), static_cast<int>(p_.map_info.height), 1);
+  const auto valid = [this, &size](const Vec& p)
+  {
+    return 0 <= p[0] && p[0] < size[0] && 0 <= p[1] && p[1] < size[1] &&
+           cm_rough_[p] < 100;
+  };
+  const size_t num_goals = goals.size();
+  costs.clear();
+  costs.resize(starts.size() * num_goals, std::numeric_limits<float>::max());
+
+#pragma omp parallel
+  {
+    DistanceMap::Gridmap g;
+    reservable_priority_queue<Astar::PriorityVec> open;
+    g.reset(size);
+    open.reserve(p_.map_info.width * p_.map_info.height / 2 / omp_get_num_threads());
+
+#pragma omp for schedule(dynamic)
+    for (size_t j = 0; j < num_goals; ++j)
+    {
+      const Vec e(goals[j][0], goals[j][1], 0);
+      if (!valid(e))
+        continue;
+
+      g.clear(std::numeric_limits<float>::max());
+      open.clear();
+      g[e] = 0;
+      open.emplace(0.0f, 0.0f, e);
+      for (size_t i = 0; i < starts.size(); ++i)
+      {
+        const Vec s(starts[i][0], starts[i][1], 0);
+        if (!valid(s))
+          continue;
+        // Resumes the fill until the cost of the start is determined.
+        distance_map_.fill(open, g, s);
+        costs[i * num_goals + j] = g[s];
+      }
+    }
+  }
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
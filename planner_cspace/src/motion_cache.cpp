@@ -29,9 +29,26 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define PLANNER_CSPACE_MOTION_CACHE_AVX2
+#include <immintrin.h>
+#endif
+
 #include <planner_cspace/cyclic_vec.h>
 #include <planner_cspace/planner_3d/motion_cache.h>
 
@@ -39,140 +56,612 @@ namespace planner_cspace
 {
 namespace planner_3d
 {
+#ifdef PLANNER_CSPACE_MOTION_CACHE_AVX2
+const bool MotionCache::avx2_ = __builtin_cpu_supports("avx2");
+
+namespace
+{
+// Gathers 8 signed chars and extends them to 32-bit.
+// BlockMemGridmap has padding to read the last cell by 32-bit word.
+__attribute__((target("avx2")))
+inline __m256i gatherAVX2(const char* base, const __m256i offset)
+{
+  const __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base), offset, 1);
+  return _mm256_srai_epi32(_mm256_slli_epi32(words, 24), 24);
+}
+
+__attribute__((target("avx2")))
+inline int hsumAVX2(const __m256i v)
+{
+  const __m128i s4 = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  const __m128i s2 = _mm_add_epi32(s4, _mm_shuffle_epi32(s4, _MM_SHUFFLE(1, 0, 3, 2)));
+  const __m128i s1 = _mm_add_epi32(s2, _mm_shuffle_epi32(s2, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(s1);
+}
+}  // namespace
+
+__attribute__((target("avx2")))
+bool MotionCache::Page::sumCostOffsetAVX2(
+    const char* cm, const char* cm_hyst, int& sum, int& sum_hyst) const
+{
+  const __m256i lethal = _mm256_set1_epi32(99);
+  __m256i vsum = _mm256_setzero_si256();
+  __m256i vsum_hyst = _mm256_setzero_si256();
+
+  size_t i = 0;
+  for (; i + 8 <= offset_.size(); i += 8)
+  {
+    const __m256i offset = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&offset_[i]));
+    const __m256i c = gatherAVX2(cm, offset);
+    const __m256i hit = _mm256_cmpgt_epi32(c, lethal);
+    if (!_mm256_testz_si256(hit, hit))
+      return false;
+    vsum = _mm256_add_epi32(vsum, c);
+
+    if (cm_hyst)
+      vsum_hyst = _mm256_add_epi32(vsum_hyst, gatherAVX2(cm_hyst, offset));
+  }
+  sum = hsumAVX2(vsum);
+  sum_hyst = hsumAVX2(vsum_hyst);
+  for (; i < offset_.size(); ++i)
+  {
+    const char c = cm[offset_[i]];
+    if (c > 99)
+      return false;
+    sum += c;
+
+    if (cm_hyst)
+      sum_hyst += cm_hyst[offset_[i]];
+  }
+  return true;
+}
+#else
+const bool MotionCache::avx2_ = false;
+
+bool MotionCache::Page::sumCostOffsetAVX2(
+    const char* cm, const char* cm_hyst, int& sum, int& sum_hyst) const
+{
+  return false;
+}
+#endif  // PLANNER_CSPACE_MOTION_CACHE_AVX2
+
+namespace
+{
+constexpr char CACHE_MAGIC[8] = {'M', 'O', 'T', 'I', 'O', 'N', 'C', '2'};
+
+struct CacheHeader
+{
+  char magic[8];
+  MotionCache::CacheKey key;
+  int32_t page_size;
+  int32_t max_range[3];
+};
+
+struct PageHeader
+{
+  int32_t goal[3];
+  float distance;
+  int32_t min_x, max_x;
+  int32_t min_y, max_y;
+  int32_t offset_block_mask;
+  int32_t offset_angle;
+  uint32_t num_motion;
+  uint32_t num_mask_rows;
+};
+
+template <class T>
+void writeValue(std::ofstream& ofs, const T& v)
+{
+  ofs.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <class T>
+void writeArray(std::ofstream& ofs, const std::vector<T>& v)
+{
+  ofs.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+// MaskRow has padding bytes, so the fields are serialized one by one.
+constexpr size_t MASK_ROW_SERIALIZED_SIZE = sizeof(int32_t) * 3 + sizeof(uint64_t);
+
+// Reads the values from the memory mapped file with the boundary check.
+class MappedReader
+{
+public:
+  MappedReader(const char* data, const size_t size)
+    : data_(data)
+    , remaining_(size)
+  {
+  }
+  template <class T>
+  bool read(T& v)
+  {
+    if (remaining_ < sizeof(T))
+      return false;
+    std::memcpy(&v, data_, sizeof(T));
+    data_ += sizeof(T);
+    remaining_ -= sizeof(T);
+    return true;
+  }
+  template <class T>
+  bool readArray(std::vector<T>& v, const size_t num)
+  {
+    if (remaining_ / sizeof(T) < num)
+      return false;
+    v.resize(num);
+    std::memcpy(v.data(), data_, num * sizeof(T));
+    data_ += num * sizeof(T);
+    remaining_ -= num * sizeof(T);
+    return true;
+  }
+  size_t remaining() const
+  {
+    return remaining_;
+  }
+  bool end() const
+  {
+    return remaining_ == 0;
+  }
+
+private:
+  const char* data_;
+  size_t remaining_;
+};
+}  // namespace
+
+bool MotionCache::CacheKey::operator==(const CacheKey& b) const
+{
+  return linear_resolution == b.linear_resolution &&
+         angular_resolution == b.angular_resolution &&
+         range == b.range &&
+         block_bit == b.block_bit &&
+         gridmap_angle == b.gridmap_angle;
+}
+
+std::string MotionCache::CacheKey::fileName() const
+{
+  char name[128];
+  std::snprintf(
+      name, sizeof(name), "motion_cache_%08x_%08x_r%d_b%d_a%d.bin",
+      floatBits(linear_resolution), floatBits(angular_resolution), range, block_bit, gridmap_angle);
+  return name;
+}
+
+uint32_t MotionCache::CacheKey::floatBits(const float v)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
 void MotionCache::reset(
     const float linear_resolution,
     const float angular_resolution,
     const int range,
-    const std::function<void(CyclicVecInt<3, 2>, size_t&, size_t&)> gm_addr)
+    const std::function<void(CyclicVecInt<3, 2>, size_t&, size_t&)> gm_addr,
+    const std::string& cache_dir)
 {
   const int angle = std::lround(M_PI * 2 / angular_resolution);
 
+  // Find block width of the gridmap to calculate the linear offsets of the cells.
+  // Block address of (0, y, 0) is incremented at y = block width.
+  int block_bit = 0;
+  int gridmap_angle = 0;
+  {
+    size_t baddr0, baddr, addr0, addr;
+    gm_addr(CyclicVecInt<3, 2>(0, 0, 0), baddr0, addr0);
+    for (; block_bit < 16; ++block_bit)
+    {
+      gm_addr(CyclicVecInt<3, 2>(0, 1 << block_bit, 0), baddr, addr);
+      if (baddr != baddr0)
+        break;
+    }
+    // Angles of a cell are contiguous.
+    gm_addr(CyclicVecInt<3, 2>(0, 1, 0), baddr, addr);
+    gridmap_angle = addr - addr0;
+  }
+
+  const CacheKey key{linear_resolution, angular_resolution, range, block_bit, gridmap_angle};
+  const std::string cache_file = cache_dir.empty() ? std::string() : cache_dir + "/" + key.fileName();
+  if (!cache_file.empty() && load(cache_file, key))
+    return;
+
   CyclicVecInt<3, 2> max_range(0, 0, 0);
   page_size_ = angle;
+  cache_.clear();
   cache_.resize(angle);
-  for (int syaw = 0; syaw < angle; syaw++)
+  // Pages of the start yaws are independent.
+#pragma omp parallel
+  {
+    CyclicVecInt<3, 2> max_range_local(0, 0, 0);
+#pragma omp for schedule(dynamic)
+    for (int syaw = 0; syaw < angle; syaw++)
+    {
+      buildPages(syaw, linear_resolution, angular_resolution, range, angle, block_bit, gm_addr, max_range_local);
+    }
+#pragma omp critical
+    {
+      for (int i = 0; i < 3; ++i)
+        max_range[i] = std::max(max_range[i], max_range_local[i]);
+    }
+  }
+  max_range_ = max_range;
+  key_ = key;
+
+  if (!cache_file.empty())
+    save(cache_file);
+}
+
+void MotionCache::buildPages(
+    const int syaw,
+    const float linear_resolution,
+    const float angular_resolution,
+    const int range,
+    const int angle,
+    const int block_bit,
+    const std::function<void(CyclicVecInt<3, 2>, size_t&, size_t&)>& gm_addr,
+    CyclicVecInt<3, 2>& max_range)
+{
+  const float yaw = syaw * angular_resolution;
+  CyclicVecInt<3, 2> d;
+  for (d[0] = -range; d[0] <= range; d[0]++)
   {
-    const float yaw = syaw * angular_resolution;
-    CyclicVecInt<3, 2> d;
-    for (d[0] = -range; d[0] <= range; d[0]++)
+    for (d[1] = -range; d[1] <= range; d[1]++)
     {
-      for (d[1] = -range; d[1] <= range; d[1]++)
+      if (d[0] == 0 && d[1] == 0)
+        continue;
+      if (d.sqlen() > range * range)
+        continue;
+      for (d[2] = 0; d[2] < angle; d[2]++)
       {
-        if (d[0] == 0 && d[1] == 0)
-          continue;
-        if (d.sqlen() > range * range)
-          continue;
-        for (d[2] = 0; d[2] < angle; d[2]++)
-        {
-          Page page;
-          const float yaw_e = d[2] * angular_resolution;
-          const float diff_val[3] =
-              {
-                d[0] * linear_resolution,
-                d[1] * linear_resolution,
-                d[2] * angular_resolution
-              };
-          std::unordered_map<CyclicVecInt<3, 2>, bool, CyclicVecInt<3, 2>> registered;
-          registered[d] = true;
+        Page page;
+        const float yaw_e = d[2] * angular_resolution;
+        const float diff_val[3] =
+            {
+              d[0] * linear_resolution,
+              d[1] * linear_resolution,
+              d[2] * angular_resolution
+            };
 
-          CyclicVecFloat<3, 2> motion(diff_val[0], diff_val[1], diff_val[2]);
-          motion.rotate(-syaw * angular_resolution);
-          const float cos_v = cosf(motion[2]);
-          const float sin_v = sinf(motion[2]);
+        CyclicVecFloat<3, 2> motion(diff_val[0], diff_val[1], diff_val[2]);
+        motion.rotate(-syaw * angular_resolution);
+        const float cos_v = cosf(motion[2]);
+        const float sin_v = sinf(motion[2]);
 
-          const float inter = 1.0 / d.len();
+        const float inter = 1.0 / d.len();
 
-          if (std::abs(sin_v) < 0.1)
+        if (std::abs(sin_v) < 0.1)
+        {
+          for (float i = 0; i < 1.0; i += inter)
           {
-            for (float i = 0; i < 1.0; i += inter)
-            {
-              const float x = diff_val[0] * i;
-              const float y = diff_val[1] * i;
+            const float x = diff_val[0] * i;
+            const float y = diff_val[1] * i;
 
-              CyclicVecInt<3, 2> pos(
-                  x / linear_resolution, y / linear_resolution, yaw / angular_resolution);
-              pos.cycleUnsigned(angle);
-              if (registered.find(pos) == registered.end())
-              {
-                page.motion_.push_back(pos);
-                for (int i = 0; i < 3; ++i)
-                  max_range[i] = std::max(max_range[i], std::abs(pos[i]));
-                registered[pos] = true;
-              }
+            CyclicVecInt<3, 2> pos(
+                x / linear_resolution, y / linear_resolution, yaw / angular_resolution);
+            pos.cycleUnsigned(angle);
+            if (isNewCell(page, d, pos))
+            {
+              page.motion_.push_back(pos);
+              for (int i = 0; i < 3; ++i)
+                max_range[i] = std::max(max_range[i], std::abs(pos[i]));
             }
-            page.distance_ = d.len();
-            cache_[syaw][d] = page;
-            continue;
           }
+          page.distance_ = d.len();
+          cache_[syaw][d] = page;
+          continue;
+        }
 
-          float distf = 0.0;
-          const float r1 = motion[1] + motion[0] * cos_v / sin_v;
-          const float r2 = std::copysign(
-              std::sqrt(std::pow(motion[0], 2) + std::pow(motion[0] * cos_v / sin_v, 2)),
-              motion[0] * sin_v);
+        float distf = 0.0;
+        const float r1 = motion[1] + motion[0] * cos_v / sin_v;
+        const float r2 = std::copysign(
+            std::sqrt(std::pow(motion[0], 2) + std::pow(motion[0] * cos_v / sin_v, 2)),
+            motion[0] * sin_v);
 
-          float dyaw = yaw_e - yaw;
-          if (dyaw < -M_PI)
-            dyaw += 2 * M_PI;
-          else if (dyaw > M_PI)
-            dyaw -= 2 * M_PI;
+        float dyaw = yaw_e - yaw;
+        if (dyaw < -M_PI)
+          dyaw += 2 * M_PI;
+        else if (dyaw > M_PI)
+          dyaw -= 2 * M_PI;
 
-          const float cx = d[0] * linear_resolution + r2 * cosf(yaw_e + M_PI / 2);
-          const float cy = d[1] * linear_resolution + r2 * sinf(yaw_e + M_PI / 2);
-          const float cx_s = r1 * cosf(yaw + M_PI / 2);
-          const float cy_s = r1 * sinf(yaw + M_PI / 2);
+        const float cx = d[0] * linear_resolution + r2 * cosf(yaw_e + M_PI / 2);
+        const float cy = d[1] * linear_resolution + r2 * sinf(yaw_e + M_PI / 2);
+        const float cx_s = r1 * cosf(yaw + M_PI / 2);
+        const float cy_s = r1 * sinf(yaw + M_PI / 2);
 
-          CyclicVecFloat<3, 2> posf_prev(0, 0, 0);
+        CyclicVecFloat<3, 2> posf_prev(0, 0, 0);
 
-          for (float i = 0; i < 1.0; i += inter)
+        for (float i = 0; i < 1.0; i += inter)
+        {
+          const float r = r1 * (1.0 - i) + r2 * i;
+          const float cx2 = cx_s * (1.0 - i) + cx * i;
+          const float cy2 = cy_s * (1.0 - i) + cy * i;
+          const float cyaw = yaw + i * dyaw;
+
+          const float posf_raw[3] =
+              {
+                (cx2 - r * cosf(cyaw + M_PI / 2)) / linear_resolution,
+                (cy2 - r * sinf(cyaw + M_PI / 2)) / linear_resolution,
+                cyaw / angular_resolution
+              };
+          const CyclicVecFloat<3, 2> posf(posf_raw[0], posf_raw[1], posf_raw[2]);
+          CyclicVecInt<3, 2> pos(posf_raw[0], posf_raw[1], posf_raw[2]);
+          pos.cycleUnsigned(angle);
+          if (isNewCell(page, d, pos))
           {
-            const float r = r1 * (1.0 - i) + r2 * i;
-            const float cx2 = cx_s * (1.0 - i) + cx * i;
-            const float cy2 = cy_s * (1.0 - i) + cy * i;
-            const float cyaw = yaw + i * dyaw;
-
-            const float posf_raw[3] =
-                {
-                  (cx2 - r * cosf(cyaw + M_PI / 2)) / linear_resolution,
-                  (cy2 - r * sinf(cyaw + M_PI / 2)) / linear_resolution,
-                  cyaw / angular_resolution
-                };
-            const CyclicVecFloat<3, 2> posf(posf_raw[0], posf_raw[1], posf_raw[2]);
-            CyclicVecInt<3, 2> pos(posf_raw[0], posf_raw[1], posf_raw[2]);
-            pos.cycleUnsigned(angle);
-            if (registered.find(pos) == registered.end())
-            {
-              page.motion_.push_back(pos);
-              registered[pos] = true;
-            }
-            distf += (posf - posf_prev).len();
-            posf_prev = posf;
+            page.motion_.push_back(pos);
           }
-          distf += (CyclicVecFloat<3, 2>(d) - posf_prev).len();
-          page.distance_ = distf;
-          cache_[syaw][d] = page;
+          distf += (posf - posf_prev).len();
+          posf_prev = posf;
         }
+        distf += (CyclicVecFloat<3, 2>(d) - posf_prev).len();
+        page.distance_ = distf;
+        cache_[syaw][d] = page;
+      }
+    }
+  }
+  // Sort to improve cache hit rate
+  for (auto& cache : cache_[syaw])
+  {
+    auto comp = [this, &gm_addr](const CyclicVecInt<3, 2> a, const CyclicVecInt<3, 2> b)
+    {
+      size_t a_baddr, a_addr;
+      size_t b_baddr, b_addr;
+      gm_addr(a, a_baddr, a_addr);
+      gm_addr(b, b_baddr, b_addr);
+      if (a_baddr == b_baddr)
+      {
+        return (a_addr < b_addr);
       }
+      return (a_baddr < b_baddr);
+    };
+    std::sort(cache.second.motion_.begin(), cache.second.motion_.end(), comp);
+
+    Page& page = cache.second;
+    const size_t num = page.motion_.size();
+    page.offset_.resize(num);
+    page.min_x_ = page.min_y_ = std::numeric_limits<int32_t>::max();
+    page.max_x_ = page.max_y_ = std::numeric_limits<int32_t>::lowest();
+    for (size_t i = 0; i < num; ++i)
+    {
+      const CyclicVecInt<3, 2>& p = page.motion_[i];
+      page.offset_[i] = (p[0] * (1 << block_bit) + p[1]) * angle + p[2];
+      page.min_x_ = std::min(page.min_x_, p[0]);
+      page.max_x_ = std::max(page.max_x_, p[0]);
+      page.min_y_ = std::min(page.min_y_, p[1]);
+      page.max_y_ = std::max(page.max_y_, p[1]);
     }
-    // Sort to improve cache hit rate
-    for (auto& cache : cache_[syaw])
+    page.offset_block_mask_ = (1 << block_bit) - 1;
+    page.offset_angle_ = angle;
+
+    std::vector<CyclicVecInt<3, 2>> cells = page.motion_;
+    std::sort(
+        cells.begin(), cells.end(),
+        [](const CyclicVecInt<3, 2>& a, const CyclicVecInt<3, 2>& b)
+        {
+          if (a[2] != b[2])
+            return a[2] < b[2];
+          if (a[1] != b[1])
+            return a[1] < b[1];
+          return a[0] < b[0];
+        });
+    page.mask_rows_.clear();
+    for (const CyclicVecInt<3, 2>& p : cells)
     {
-      auto comp = [this, &gm_addr](const CyclicVecInt<3, 2> a, const CyclicVecInt<3, 2> b)
+      if (page.mask_rows_.size() > 0)
       {
-        size_t a_baddr, a_addr;
-        size_t b_baddr, b_addr;
-        gm_addr(a, a_baddr, a_addr);
-        gm_addr(b, b_baddr, b_addr);
-        if (a_baddr == b_baddr)
+        Page::MaskRow& row = page.mask_rows_.back();
+        if (row.yaw_ == p[2] && row.y_ == p[1] && p[0] - row.x_ < LethalMask::PATTERN_BITS)
         {
-          return (a_addr < b_addr);
+          row.pattern_ |= static_cast<uint64_t>(1) << (p[0] - row.x_);
+          continue;
         }
-        return (a_baddr < b_baddr);
-      };
-      std::sort(cache.second.motion_.begin(), cache.second.motion_.end(), comp);
+      }
+      page.mask_rows_.push_back(Page::MaskRow{p[0], p[1], p[2], 1});
     }
   }
-  max_range_ = max_range;
+}
+
+bool MotionCache::save(const std::string& file) const
+{
+  // Write to the temporary file and rename it to avoid loading incomplete file
+  // written by the other process.
+  const std::string tmp_file = file + ".tmp" + std::to_string(::getpid());
+  {
+    std::ofstream ofs(tmp_file, std::ios::binary);
+    if (!ofs)
+      return false;
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.key = key_;
+    header.page_size = page_size_;
+    for (int i = 0; i < 3; ++i)
+      header.max_range[i] = max_range_[i];
+    writeValue(ofs, header);
+
+    for (const Cache& cache : cache_)
+    {
+      writeValue(ofs, static_cast<uint64_t>(cache.size()));
+      for (const auto& c : cache)
+      {
+        const Page& page = c.second;
+        const PageHeader ph =
+            {
+              {c.first[0], c.first[1], c.first[2]},
+              page.distance_,
+              page.min_x_, page.max_x_,
+              page.min_y_, page.max_y_,
+              page.offset_block_mask_,
+              page.offset_angle_,
+              static_cast<uint32_t>(page.motion_.size()),
+              static_cast<uint32_t>(page.mask_rows_.size()),
+            };
+        writeValue(ofs, ph);
+        for (const CyclicVecInt<3, 2>& p : page.motion_)
+        {
+          const int32_t v[3] = {p[0], p[1], p[2]};
+          writeValue(ofs, v);
+        }
+        writeArray(ofs, page.offset_);
+        for (const Page::MaskRow& row : page.mask_rows_)
+        {
+          const int32_t xyyaw[3] = {row.x_, row.y_, row.yaw_};
+          writeValue(ofs, xyyaw);
+          writeValue(ofs, row.pattern_);
+        }
+      }
+    }
+    if (!ofs)
+    {
+      std::remove(tmp_file.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_file.c_str(), file.c_str()) != 0)
+  {
+    std::remove(tmp_file.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool MotionCache::load(const std::string& file, const CacheKey& key)
+{
+  const int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  const size_t size = st.st_size;
+  void* const mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED)
+    return false;
+
+  const int angle = std::lround(M_PI * 2 / key.angular_resolution);
+  const int32_t block_mask = (1 << key.block_bit) - 1;
+  // Pages are used to access the gridmaps without the boundary check,
+  // so all values derived from the motion must be consistent.
+  const auto is_valid_page = [&key, angle, block_mask](const CyclicVecInt<3, 2>& goal, const Page& page)
+  {
+    if (goal.sqlen() > key.range * key.range || goal[2] < 0 || goal[2] >= angle ||
+        !std::isfinite(page.distance_) || page.distance_ < 0 ||
+        page.offset_block_mask_ != block_mask || page.offset_angle_ != angle ||
+        page.motion_.empty() || page.mask_rows_.size() > page.motion_.size())
+      return false;
+    int32_t min_x = std::numeric_limits<int32_t>::max();
+    int32_t max_x = std::numeric_limits<int32_t>::lowest();
+    int32_t min_y = std::numeric_limits<int32_t>::max();
+    int32_t max_y = std::numeric_limits<int32_t>::lowest();
+    for (size_t i = 0; i < page.motion_.size(); ++i)
+    {
+      const CyclicVecInt<3, 2>& p = page.motion_[i];
+      const int64_t offset = (static_cast<int64_t>(p[0]) * (block_mask + 1) + p[1]) * angle + p[2];
+      if (p[2] < 0 || p[2] >= angle || page.offset_[i] != offset)
+        return false;
+      min_x = std::min(min_x, p[0]);
+      max_x = std::max(max_x, p[0]);
+      min_y = std::min(min_y, p[1]);
+      max_y = std::max(max_y, p[1]);
+    }
+    if (page.min_x_ != min_x || page.max_x_ != max_x ||
+        page.min_y_ != min_y || page.max_y_ != max_y)
+      return false;
+    for (const Page::MaskRow& row : page.mask_rows_)
+    {
+      if (row.yaw_ < 0 || row.yaw_ >= angle ||
+          row.y_ < min_y || row.y_ > max_y || row.x_ < min_x ||
+          row.pattern_ == 0 || (row.pattern_ >> LethalMask::PATTERN_BITS) != 0 ||
+          static_cast<int64_t>(row.x_) + 63 - __builtin_clzll(row.pattern_) > max_x)
+        return false;
+    }
+    return true;
+  };
+
+  std::vector<Cache> cache;
+  CacheHeader header;
+  const bool ok = [&]()
+  {
+    MappedReader reader(static_cast<const char*>(mapped), size);
+    if (!reader.read(header) ||
+        std::memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        !(header.key == key) ||
+        header.page_size != angle)
+      return false;
+    for (int i = 0; i < 2; ++i)
+    {
+      if (header.max_range[i] < 0 || header.max_range[i] > key.range)
+        return false;
+    }
+    if (header.max_range[2] < 0 || header.max_range[2] >= angle)
+      return false;
+
+    cache.resize(header.page_size);
+    for (Cache& c : cache)
+    {
+      uint64_t num_pages;
+      if (!reader.read(num_pages) || num_pages > reader.remaining() / sizeof(PageHeader))
+        return false;
+      c.reserve(num_pages);
+      for (uint64_t i = 0; i < num_pages; ++i)
+      {
+        PageHeader ph;
+        if (!reader.read(ph))
+          return false;
+        const CyclicVecInt<3, 2> goal(ph.goal[0], ph.goal[1], ph.goal[2]);
+        if (c.find(goal) != c.end())
+          return false;
+        Page page;
+        page.distance_ = ph.distance;
+        page.min_x_ = ph.min_x;
+        page.max_x_ = ph.max_x;
+        page.min_y_ = ph.min_y;
+        page.max_y_ = ph.max_y;
+        page.offset_block_mask_ = ph.offset_block_mask;
+        page.offset_angle_ = ph.offset_angle;
+        if (ph.num_motion > reader.remaining() / (sizeof(int32_t) * 3))
+          return false;
+        page.motion_.resize(ph.num_motion);
+        for (CyclicVecInt<3, 2>& p : page.motion_)
+        {
+          int32_t v[3];
+          if (!reader.read(v))
+            return false;
+          p = CyclicVecInt<3, 2>(v[0], v[1], v[2]);
+        }
+        if (!reader.readArray(page.offset_, ph.num_motion) ||
+            ph.num_mask_rows > reader.remaining() / MASK_ROW_SERIALIZED_SIZE)
+          return false;
+        page.mask_rows_.resize(ph.num_mask_rows);
+        for (Page::MaskRow& row : page.mask_rows_)
+        {
+          int32_t xyyaw[3];
+          uint64_t pattern;
+          if (!reader.read(xyyaw) || !reader.read(pattern))
+            return false;
+          row = Page::MaskRow{xyyaw[0], xyyaw[1], xyyaw[2], pattern};
+        }
+        if (!is_valid_page(goal, page))
+          return false;
+        c.emplace(goal, std::move(page));
+      }
+    }
+    return reader.end();
+  }();
+  ::munmap(mapped, size);
+
+  if (!ok)
+    return false;
+  page_size_ = header.page_size;
+  max_range_ = CyclicVecInt<3, 2>(header.max_range[0], header.max_range[1], header.max_range[2]);
+  cache_.swap(cache);
+  key_ = key;
+  return true;
 }
 }  // namespace planner_3d
 }  // namespace planner_cspace
@@ -28,6 +28,7 @@
  */
 
 #include <list>
+#include <vector>
 
 #include <planner_cspace/cyclic_vec.h>
 #include <planner_cspace/planner_3d/rotation_cache.h>
@@ -37,7 +38,7 @@ namespace planner_cspace
 {
 namespace planner_3d
 {
-std::list<CyclicVecFloat<3, 2>> PathInterpolator::interpolate(
+std::vector<CyclicVecFloat<3, 2>> PathInterpolator::interpolate(
     const std::list<CyclicVecInt<3, 2>>& path_grid,
     const float interval,
     const int local_range) const
@@ -45,7 +46,7 @@ std::list<CyclicVecFloat<3, 2>> PathInterpolator::interpolate(
   CyclicVecInt<3, 2> p_prev(0, 0, 0);
   bool init = false;
 
-  std::list<CyclicVecFloat<3, 2>> path;
+  std::vector<CyclicVecFloat<3, 2>> path;
 
   for (auto p : path_grid)
   {
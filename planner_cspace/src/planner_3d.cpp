@@ -28,17 +28,19 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <limits>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <omp.h>
 
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
 
 #include <costmap_cspace_msgs/CSpace3D.h>
@@ -66,11 +68,22 @@
 #include <neonavigation_common/compatibility.h>
 
 #include <planner_cspace/bbf.h>
+#include <planner_cspace/compact_blockmem_gridmap.h>
 #include <planner_cspace/grid_astar.h>
 #include <planner_cspace/jump_detector.h>
+#include <planner_cspace/planner_3d/cluster_graph.h>
+#include <planner_cspace/planner_3d/cost_reduction.h>
 #include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+#include <planner_cspace/planner_3d/distance_map_worker.h>
 #include <planner_cspace/planner_3d/grid_astar_model.h>
+#include <planner_cspace/planner_3d/grid_astar_model_impl.h>
 #include <planner_cspace/planner_3d/grid_metric_converter.h>
+#include <planner_cspace/planner_3d/heuristic_cache.h>
+#include <planner_cspace/planner_3d/hysteresis_map.h>
+#include <planner_cspace/planner_3d/landmark_heuristic.h>
+#include <planner_cspace/planner_3d/lethal_mask.h>
+#include <planner_cspace/planner_3d/make_plan_worker.h>
 #include <planner_cspace/planner_3d/motion_cache.h>
 #include <planner_cspace/planner_3d/path_interpolator.h>
 #include <planner_cspace/planner_3d/rotation_cache.h>
@@ -83,6 +96,8 @@ class Planner3dNode
 {
 public:
   using Astar = GridAstar<3, 2>;
+  // Search buffers are allocated and cleared only in the blocks touched by the search.
+  using AstarSearch = GridAstar<3, 2, reservable_priority_queue, true>;
 
 protected:
   using Planner3DActionServer = actionlib::SimpleActionServer<move_base_msgs::MoveBaseAction>;
@@ -90,6 +105,9 @@ protected:
 
   ros::NodeHandle nh_;
   ros::NodeHandle pnh_;
+  // make_plan service is processed on its own threads
+  ros::NodeHandle pnh_make_plan_;
+  ros::CallbackQueue make_plan_queue_;
   ros::Subscriber sub_map_;
   ros::Subscriber sub_map_update_;
   ros::Subscriber sub_goal_;
@@ -111,17 +129,60 @@ protected:
   tf2_ros::Buffer tfbuf_;
   tf2_ros::TransformListener tfl_;
 
-  Astar as_;
+  // Guards the rough costmap and the map information read by make_plan workers
+  std::mutex map_mutex_;
+  size_t map_version_;
+  size_t map_update_version_;
+  struct MakePlanContext
+  {
+    std::mutex mutex_;
+    MakePlanWorker worker_;
+    size_t map_version_;
+    size_t map_update_version_;
+  };
+  std::vector<std::unique_ptr<MakePlanContext>> make_plan_contexts_;
+  std::unique_ptr<ros::AsyncSpinner> make_plan_spinner_;
+
+  AstarSearch as_;
+  AstarSearch::SearchStats search_stats_;
   Astar::Gridmap<char, 0x40> cm_;
   Astar::Gridmap<char, 0x80> cm_rough_;
   Astar::Gridmap<char, 0x40> cm_base_;
+  // Used instead of cm_base_ if compact_base_costmap_ is enabled.
+  AngleSparseGridmap<char, 0x40> cm_base_sparse_;
+  bool compact_base_costmap_;
+  // Each block of cm_base_ (or cm_base_sparse_) is copied from cm_ when the block is modified first time.
+  // The blocks not stored yet are kept unmodified in cm_.
+  std::vector<uint8_t> cm_base_stored_;
+  std::vector<size_t> cm_update_blocks_;
   Astar::Gridmap<char, 0x80> cm_rough_base_;
-  Astar::Gridmap<char, 0x80> cm_hyst_;
+  Astar::Gridmap<char, 0x40> cm_hyst_;
+  HysteresisMap hysteresis_map_;
   Astar::Gridmap<char, 0x80> cm_updates_;
+  LethalMask cm_mask_;
+  LethalMask cm_mask_base_;
+  LethalMask cm_rough_mask_;
+  LethalMask cm_rough_mask_base_;
   Astar::Gridmap<float> cost_estim_cache_;
+  // Remaining open list of the cost estimation to continue on the map update
+  reservable_priority_queue<Astar::PriorityVec> cost_estim_open_;
+  HeuristicCache heuristic_cache_;
+  // Goal of cost_estim_cache_ and whether it can be stored to heuristic_cache_
+  Astar::Vec cost_estim_goal_;
+  bool cost_estim_cacheable_;
+  LandmarkHeuristic landmark_heuristic_;
+  int num_landmarks_;
+  // Exact cost estimation built in background while the landmark heuristic is used
+  DistanceMapWorker cost_estim_worker_;
+  bool cost_estim_pending_;
+  bool cost_estim_pending_dirty_;
+  Astar::Vec cost_estim_pending_dirty_min_;
+  Astar::Vec cost_estim_pending_dirty_max_;
   CostmapBBF bbf_costmap_;
+  DistanceMap distance_map_;
+  ClusterGraph cluster_graph_;
 
-  GridAstarModel3D::Ptr model_;
+  GridAstarModel3DPlanner::Ptr model_;
   std::array<float, 1024> euclid_cost_lin_cache_;
 
   costmap_cspace_msgs::MapMetaData3D map_info_;
@@ -129,6 +190,7 @@ protected:
   float freq_;
   float freq_min_;
   float search_range_;
+  std::string motion_cache_dir_;
   bool antialias_start_;
   int range_;
   int local_range_;
@@ -151,6 +213,9 @@ protected:
   bool goal_updated_;
   bool remember_updates_;
   bool fast_map_update_;
+  bool hierarchical_planning_;
+  int hierarchical_cluster_size_;
+  bool corridor_valid_;
   std::vector<Astar::Vec> search_list_;
   std::vector<Astar::Vec> search_list_rough_;
   double hist_ignore_range_f_;
@@ -170,6 +235,7 @@ protected:
 
   int num_task_;
   int num_cost_estim_task_;
+  bool cost_estim_delta_stepping_;
 
   // Cost weights
   CostCoeff cc_;
@@ -187,11 +253,17 @@ protected:
   planner_cspace_msgs::PlannerStatus status_;
 
   bool find_best_;
+  bool anytime_search_;
+  float anytime_epsilon_;
+  float anytime_epsilon_step_;
+  bool incremental_search_;
+  Astar::Vec incremental_update_min_prev_;
+  Astar::Vec incremental_update_max_prev_;
+  std::list<Astar::Vec> path_grid_prev_;
   float sw_wait_;
   geometry_msgs::PoseStamped sw_pos_;
   bool is_path_switchback_;
 
-  float rough_cost_max_;
   bool rough_;
 
   bool force_goal_orientation_;
@@ -208,75 +280,124 @@ protected:
   int prev_map_update_x_max_;
   int prev_map_update_y_min_;
   int prev_map_update_y_max_;
+  // Region of cm_ changed since the last obstacle check of the previous path.
+  int path_check_x_min_;
+  int path_check_x_max_;
+  int path_check_y_min_;
+  int path_check_y_max_;
 
   bool cbForget(std_srvs::EmptyRequest& req,
                 std_srvs::EmptyResponse& res)
   {
     ROS_WARN("Forgetting remembered costmap.");
     if (has_map_)
+    {
       bbf_costmap_.clear();
+      heuristic_cache_.clear();
+    }
 
     return true;
   }
+  MakePlanWorker::Params makePlanWorkerParams() const
+  {
+    MakePlanWorker::Params p;
+    p.map_info = map_info_;
+    p.euclid_cost = ec_;
+    p.range = range_;
+    p.cc = cc_;
+    p.distance_map = distance_map_.params();
+    p.time_limit = 1.0f / freq_min_;
+    p.find_best = find_best_;
+    p.motion_cache_dir = motion_cache_dir_;
+    return p;
+  }
   bool cbMakePlan(nav_msgs::GetPlan::Request& req,
                   nav_msgs::GetPlan::Response& res)
   {
-    if (!has_map_)
+    // Idle worker is used. Requests wait for the first one if all workers are busy.
+    MakePlanContext* ctx = nullptr;
+    std::unique_lock<std::mutex> ctx_lock;
+    for (const auto& c : make_plan_contexts_)
     {
-      ROS_ERROR("make_plan service is called without map.");
-      return false;
+      std::unique_lock<std::mutex> lock(c->mutex_, std::try_to_lock);
+      if (lock.owns_lock())
+      {
+        ctx = c.get();
+        ctx_lock = std::move(lock);
+        break;
+      }
+    }
+    if (!ctx)
+    {
+      ctx = make_plan_contexts_.front().get();
+      ctx_lock = std::unique_lock<std::mutex>(ctx->mutex_);
     }
 
-    if (req.start.header.frame_id != map_header_.frame_id ||
-        req.goal.header.frame_id != map_header_.frame_id)
+    costmap_cspace_msgs::MapMetaData3D map_info;
+    std_msgs::Header map_header;
+    int range;
+    {
+      std::lock_guard<std::mutex> lock(map_mutex_);
+      if (!has_map_)
+      {
+        ROS_ERROR("make_plan service is called without map.");
+        return false;
+      }
+      map_info = map_info_;
+      map_header = map_header_;
+      range = range_;
+      if (ctx->map_version_ != map_version_)
+      {
+        ctx->worker_.reset(makePlanWorkerParams());
+        ctx->worker_.setMap(cm_rough_, cm_rough_mask_);
+        ctx->map_version_ = map_version_;
+        ctx->map_update_version_ = map_update_version_;
+      }
+      else if (ctx->map_update_version_ != map_update_version_)
+      {
+        ctx->worker_.setMap(cm_rough_, cm_rough_mask_);
+        ctx->map_update_version_ = map_update_version_;
+      }
+    }
+
+    if (req.start.header.frame_id != map_header.frame_id ||
+        req.goal.header.frame_id != map_header.frame_id)
     {
       ROS_ERROR("Start [%s] and Goal [%s] poses must be in the map frame [%s].",
                 req.start.header.frame_id.c_str(),
                 req.goal.header.frame_id.c_str(),
-                map_header_.frame_id.c_str());
+                map_header.frame_id.c_str());
       return false;
     }
 
     Astar::Vec s, e;
     grid_metric_converter::metric2Grid(
-        map_info_, s[0], s[1], s[2],
+        map_info, s[0], s[1], s[2],
         req.start.pose.position.x, req.start.pose.position.y, tf2::getYaw(req.start.pose.orientation));
     s[2] = 0;
     grid_metric_converter::metric2Grid(
-        map_info_, e[0], e[1], e[2],
+        map_info, e[0], e[1], e[2],
         req.goal.pose.position.x, req.goal.pose.position.y, tf2::getYaw(req.goal.pose.orientation));
     e[2] = 0;
 
-    if (!(cm_rough_.validate(s, range_) && cm_rough_.validate(e, range_)))
+    const MakePlanWorker::Rough& cm_rough = ctx->worker_.roughCostmap();
+    if (!(cm_rough.validate(s, range) && cm_rough.validate(e, range)))
     {
       ROS_ERROR("Given start or goal is not on the map.");
       return false;
     }
-    else if (cm_rough_[s] == 100 || cm_rough_[e] == 100)
+    else if (cm_rough[s] == 100 || cm_rough[e] == 100)
     {
       ROS_ERROR(
           "Given start or goal is in Rock. (start: %d, end: %d)",
-          cm_rough_[s], cm_rough_[e]);
+          cm_rough[s], cm_rough[e]);
       return false;
     }
 
-    const auto cb_progress = [](const std::list<Astar::Vec>& path_grid)
-    {
-      return true;
-    };
-
     const auto ts = boost::chrono::high_resolution_clock::now();
 
-    GridAstarModel2D::Ptr model_2d(new GridAstarModel2D(model_));
-
     std::list<Astar::Vec> path_grid;
-    std::vector<GridAstarModel3D::VecWithCost> starts;
-    starts.emplace_back(s);
-    if (!as_.search(
-            starts, e, path_grid,
-            model_2d,
-            cb_progress,
-            0, 1.0f / freq_min_, find_best_))
+    if (!ctx->worker_.search(s, e, path_grid))
     {
       ROS_WARN("Path plan failed (goal unreachable)");
       return false;
@@ -286,14 +407,14 @@ protected:
              boost::chrono::duration<float>(tnow - ts).count());
 
     nav_msgs::Path path;
-    path.header = map_header_;
+    path.header = map_header;
     path.header.stamp = ros::Time::now();
 
-    const std::list<Astar::Vecf> path_interpolated =
-        model_->path_interpolator_.interpolate(path_grid, 0.5, 0.0);
-    grid_metric_converter::grid2MetricPath(map_info_, path_interpolated, path);
+    const std::vector<Astar::Vecf> path_interpolated =
+        ctx->worker_.pathInterpolator().interpolate(path_grid, 0.5, 0.0);
+    grid_metric_converter::grid2MetricPath(map_info, path_interpolated, path);
 
-    res.plan.header = map_header_;
+    res.plan.header = map_header;
     res.plan.poses.resize(path.poses.size());
     for (size_t i = 0; i < path.poses.size(); ++i)
     {
@@ -371,159 +492,21 @@ protected:
   {
     const Astar::Vec s_rough(s[0], s[1], 0);
 
-    struct SearchDiffs
+    if (hierarchical_planning_ && corridor_valid_)
     {
-      Astar::Vec d;
-      std::vector<Astar::Vec> pos;
-      float grid_to_len;
-    };
-    std::vector<SearchDiffs> search_diffs;
-    {
-      Astar::Vec d;
-      d[2] = 0;
-      const int range_rough = 4;
-      for (d[0] = -range_rough; d[0] <= range_rough; d[0]++)
-      {
-        for (d[1] = -range_rough; d[1] <= range_rough; d[1]++)
-        {
-          if (d[0] == 0 && d[1] == 0)
-            continue;
-          if (d.sqlen() > range_rough * range_rough)
-            continue;
-
-          SearchDiffs diffs;
-
-          const float grid_to_len = d.gridToLenFactor();
-          const int dist = d.len();
-          const float dpx = static_cast<float>(d[0]) / dist;
-          const float dpy = static_cast<float>(d[1]) / dist;
-          Astar::Vecf pos(0, 0, 0);
-          for (int i = 0; i < dist; i++)
-          {
-            Astar::Vec ipos(pos);
-            if (diffs.pos.size() == 0 || diffs.pos.back() != ipos)
-            {
-              diffs.pos.push_back(std::move(ipos));
-            }
-            pos[0] += dpx;
-            pos[1] += dpy;
-          }
-          diffs.grid_to_len = grid_to_len;
-          diffs.d = d;
-          search_diffs.push_back(std::move(diffs));
-        }
-      }
+      distance_map_.fill(open, g, s, &cluster_graph_);
+      if (g[s_rough] != std::numeric_limits<float>::max())
+        return;
+      // The corridor is blocked by the map update. Fall back to the whole map.
+      ROS_DEBUG("Start is not reached inside the corridor");
+      corridor_valid_ = false;
+      cluster_graph_.clearCorridor();
+      g.clear(std::numeric_limits<float>::max());
+      open.clear();
+      g[e] = -ec_[0] * 0.5;
+      open.emplace(g[e], g[e], e);
     }
-
-    std::vector<Astar::PriorityVec> centers;
-    centers.reserve(num_cost_estim_task_);
-
-#pragma omp parallel
-    {
-      std::vector<Astar::GridmapUpdate> updates;
-      updates.reserve(num_cost_estim_task_ * search_diffs.size() / omp_get_num_threads());
-
-      const float range_overshoot = ec_[0] * (range_ + local_range_ + longcut_range_);
-
-      while (true)
-      {
-#pragma omp barrier
-#pragma omp single
-        {
-          centers.clear();
-          for (size_t i = 0; i < static_cast<size_t>(num_cost_estim_task_);)
-          {
-            if (open.size() < 1)
-              break;
-            Astar::PriorityVec center(open.top());
-            open.pop();
-            if (center.p_raw_ > g[center.v_])
-              continue;
-            if (center.p_raw_ - range_overshoot > g[s_rough])
-              continue;
-            centers.emplace_back(std::move(center));
-            ++i;
-          }
-        }  // omp single
-
-        if (centers.size() == 0)
-          break;
-        updates.clear();
-
-#pragma omp for schedule(static)
-        for (auto it = centers.cbegin(); it < centers.cend(); ++it)
-        {
-          const Astar::Vec p = it->v_;
-
-          for (const SearchDiffs& ds : search_diffs)
-          {
-            const Astar::Vec d = ds.d;
-            const Astar::Vec next = p + d;
-
-            if (static_cast<size_t>(next[0]) >= static_cast<size_t>(map_info_.width) ||
-                static_cast<size_t>(next[1]) >= static_cast<size_t>(map_info_.height))
-              continue;
-
-            float cost = model_->euclidCostRough(d);
-
-            const float gnext = g[next];
-
-            if (gnext < g[p] + cost)
-            {
-              // Skip as this search task has no chance to find better way.
-              continue;
-            }
-
-            {
-              float sum = 0, sum_hist = 0;
-              bool collision = false;
-              for (const auto& d : ds.pos)
-              {
-                const Astar::Vec pos = p + d;
-                const char c = cm_rough_[pos];
-                if (c > 99)
-                {
-                  collision = true;
-                  break;
-                }
-                sum += c;
-                sum_hist += bbf_costmap_.getCost(pos);
-              }
-              if (collision)
-                continue;
-              cost +=
-                  (map_info_.linear_resolution * ds.grid_to_len / 100.0) *
-                  (sum * cc_.weight_costmap_ + sum_hist * cc_.weight_remembered_);
-
-              if (cost < 0)
-              {
-                cost = 0;
-                ROS_WARN_THROTTLE(1.0, "Negative cost value is detected. Limited to zero.");
-              }
-            }
-
-            const float cost_next = it->p_raw_ + cost;
-            if (gnext > cost_next)
-            {
-              updates.emplace_back(p, next, cost_next, cost_next);
-            }
-          }
-        }
-#pragma omp barrier
-#pragma omp critical
-        {
-          for (const Astar::GridmapUpdate& u : updates)
-          {
-            if (g[u.getPos()] > u.getCost())
-            {
-              g[u.getPos()] = u.getCost();
-              open.push(std::move(u.getPriorityVec()));
-            }
-          }
-        }  // omp critical
-      }
-    }  // omp parallel
-    rough_cost_max_ = g[s_rough] + ec_[0] * (range_ + local_range_);
+    distance_map_.fill(open, g, s);
   }
   bool searchAvailablePos(Astar::Vec& s, const int xy_range, const int angle_range,
                           const int cost_acceptable = 50, const int min_xy_range = 0)
@@ -591,11 +574,6 @@ protected:
       return true;
     }
 
-    prev_map_update_x_min_ = std::numeric_limits<int>::max();
-    prev_map_update_x_max_ = std::numeric_limits<int>::lowest();
-    prev_map_update_y_min_ = std::numeric_limits<int>::max();
-    prev_map_update_y_max_ = std::numeric_limits<int>::lowest();
-
     Astar::Vec s, e;
     grid_metric_converter::metric2Grid(
         map_info_, s[0], s[1], s[2],
@@ -626,8 +604,15 @@ protected:
     }
 
     const auto ts = boost::chrono::high_resolution_clock::now();
-    reservable_priority_queue<Astar::PriorityVec> open;
-    open.reserve(map_info_.width * map_info_.height / 2);
+    if (cost_estim_cacheable_ && heuristic_cache_.enabled() &&
+        cost_estim_goal_ != Astar::Vec(e[0], e[1], 0))
+    {
+      // Keep the cost map to the previous goal for the later reuse.
+      heuristic_cache_.store(cost_estim_goal_, cost_estim_cache_, cost_estim_open_);
+    }
+    cost_estim_cacheable_ = false;
+    cost_estim_pending_ = false;
+    cost_estim_open_.clear();
 
     cost_estim_cache_.clear(std::numeric_limits<float>::max());
     if (cm_[e] == 100)
@@ -656,17 +641,61 @@ protected:
     }
 
     e[2] = 0;
-    cost_estim_cache_[e] = -ec_[0] * 0.5;  // Decrement to reduce calculation error
-    open.push(Astar::PriorityVec(cost_estim_cache_[e], cost_estim_cache_[e], e));
-    fillCostmap(open, cost_estim_cache_, s, e);
-    const auto tnow = boost::chrono::high_resolution_clock::now();
-    ROS_DEBUG("Cost estimation cache generated (%0.4f sec.)",
-              boost::chrono::duration<float>(tnow - ts).count());
+    if (hierarchical_planning_)
+    {
+      corridor_valid_ = cluster_graph_.updateCorridor(cm_rough_, Astar::Vec(s[0], s[1], 0), e);
+      if (!corridor_valid_)
+        cluster_graph_.clearCorridor();
+    }
+    const bool use_corridor = hierarchical_planning_ && corridor_valid_;
+    bool dirty;
+    Astar::Vec dirty_min, dirty_max;
+    if (!use_corridor && heuristic_cache_.enabled() &&
+        heuristic_cache_.load(e, cost_estim_cache_, cost_estim_open_, dirty, dirty_min, dirty_max) &&
+        (!dirty ||
+         (dirty_max[0] - dirty_min[0]) * (dirty_max[1] - dirty_min[1]) <
+             static_cast<int>(map_info_.width * map_info_.height / 2)))
+    {
+      cost_estim_cache_[e] = -ec_[0] * 0.5;  // Same as below
+      if (dirty)
+        distance_map_.update(cost_estim_open_, cost_estim_cache_, s, e, dirty_min, dirty_max);
+      else
+        distance_map_.fill(cost_estim_open_, cost_estim_cache_, s);
+      const auto tnow = boost::chrono::high_resolution_clock::now();
+      ROS_DEBUG("Cost estimation cache loaded (%0.4f sec.)",
+                boost::chrono::duration<float>(tnow - ts).count());
+    }
+    else if (!use_corridor && landmark_heuristic_.enabled())
+    {
+      // Lower bound given by the landmarks is used until the exact one is calculated in background.
+      landmark_heuristic_.fill(e, cost_estim_cache_);
+      cost_estim_open_.clear();
+      cost_estim_worker_.start(cm_rough_, bbf_costmap_, s, e, -ec_[0] * 0.5);
+      cost_estim_pending_ = true;
+      cost_estim_pending_dirty_ = false;
+      const auto tnow = boost::chrono::high_resolution_clock::now();
+      ROS_DEBUG("Landmark heuristic generated (%0.4f sec.)",
+                boost::chrono::duration<float>(tnow - ts).count());
+    }
+    else
+    {
+      cost_estim_open_.clear();
+      cost_estim_cache_.clear(std::numeric_limits<float>::max());
+      cost_estim_cache_[e] = -ec_[0] * 0.5;  // Decrement to reduce calculation error
+      cost_estim_open_.push(Astar::PriorityVec(cost_estim_cache_[e], cost_estim_cache_[e], e));
+      fillCostmap(cost_estim_open_, cost_estim_cache_, s, e);
+      const auto tnow = boost::chrono::high_resolution_clock::now();
+      ROS_DEBUG("Cost estimation cache generated (%0.4f sec.)",
+                boost::chrono::duration<float>(tnow - ts).count());
+    }
     cost_estim_cache_[e] = 0;
+    cost_estim_goal_ = e;
+    cost_estim_cacheable_ = !(hierarchical_planning_ && corridor_valid_) && !cost_estim_pending_;
 
     if (goal_changed)
     {
       cm_hyst_.clear(100);
+      hysteresis_map_.reset();
       has_hysteresis_map_ = false;
     }
 
@@ -676,6 +705,60 @@ protected:
 
     return true;
   }
+  // Records the region changed after calculating the cached or the pending cost maps.
+  void markCostEstimDirty(const Astar::Vec& min, const Astar::Vec& max)
+  {
+    heuristic_cache_.markDirty(min, max);
+    if (!cost_estim_pending_)
+      return;
+    if (!cost_estim_pending_dirty_)
+    {
+      cost_estim_pending_dirty_ = true;
+      cost_estim_pending_dirty_min_ = min;
+      cost_estim_pending_dirty_max_ = max;
+      return;
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+      cost_estim_pending_dirty_min_[i] = std::min(cost_estim_pending_dirty_min_[i], min[i]);
+      cost_estim_pending_dirty_max_[i] = std::max(cost_estim_pending_dirty_max_[i], max[i]);
+    }
+  }
+  void loadCostEstimWorker()
+  {
+    const auto ts = boost::chrono::high_resolution_clock::now();
+    cost_estim_pending_ = false;
+    cost_estim_worker_.get(cost_estim_cache_, cost_estim_open_);
+
+    Astar::Vec s;
+    grid_metric_converter::metric2Grid(
+        map_info_, s[0], s[1], s[2],
+        start_.pose.position.x, start_.pose.position.y, tf2::getYaw(start_.pose.orientation));
+    s[2] = 0;
+    const Astar::Vec& e = cost_estim_goal_;
+
+    // Regions updated after starting the calculation are repaired.
+    cost_estim_cache_[e] = -ec_[0] * 0.5;  // Same as updateGoal()
+    if (cost_estim_pending_dirty_)
+    {
+      distance_map_.update(
+          cost_estim_open_, cost_estim_cache_, s, e,
+          cost_estim_pending_dirty_min_, cost_estim_pending_dirty_max_);
+    }
+    else
+    {
+      distance_map_.fill(cost_estim_open_, cost_estim_cache_, s);
+    }
+    cost_estim_cache_[e] = 0;
+    cost_estim_cacheable_ = true;
+    if (incremental_search_)
+      as_.resetIncremental();
+
+    const auto tnow = boost::chrono::high_resolution_clock::now();
+    ROS_DEBUG("Cost estimation cache calculated in background is loaded (%0.4f sec.)",
+              boost::chrono::duration<float>(tnow - ts).count());
+    publishDebug();
+  }
   void publishDebug()
   {
     if (pub_distance_map_.getNumSubscribers() > 0)
@@ -762,8 +845,13 @@ protected:
     nav_msgs::Path path;
     path.header.frame_id = robot_frame_;
     path.header.stamp = ros::Time::now();
+    publishPath(path);
+  }
+  void publishPath(const nav_msgs::Path& path)
+  {
     if (use_path_with_velocity_)
     {
+      // NaN velocity means that don't care the velocity
       pub_path_velocity_.publish(
           trajectory_tracker_msgs::toPathWithVelocity(
               path, std::numeric_limits<double>::quiet_NaN()));
@@ -774,6 +862,34 @@ protected:
     }
   }
 
+  void storeBaseCostmap(const Astar::Vec& min, const Astar::Vec& max)
+  {
+    cm_.regionBlocks(min, max, cm_update_blocks_);
+    bool stored = false;
+    for (const size_t b : cm_update_blocks_)
+    {
+      if (cm_base_stored_[b])
+        continue;
+      if (compact_base_costmap_)
+      {
+        Astar::Vec block_min, block_max;
+        cm_.blockRegion(b, block_min, block_max);
+        cm_base_sparse_.assign(cm_, block_min, block_max);
+      }
+      else
+      {
+        cm_base_.copyBlock(cm_, b);
+      }
+      cm_base_stored_[b] = 1;
+      stored = true;
+    }
+    if (stored && compact_base_costmap_)
+    {
+      ROS_DEBUG("Base costmap: %lu bytes (%lu non-uniform cells)",
+                cm_base_sparse_.bytes(), cm_base_sparse_.numNonUniformCells());
+    }
+  }
+
   void cbMapUpdate(const costmap_cspace_msgs::CSpace3DUpdate::ConstPtr& msg)
   {
     if (!has_map_)
@@ -783,61 +899,140 @@ protected:
     const ros::Time now = ros::Time::now();
     last_costmap_ = now;
 
-    cm_ = cm_base_;
-    cm_rough_ = cm_rough_base_;
-    cm_updates_.clear(-1);
+    std::unique_lock<std::mutex> map_lock(map_mutex_);
+    // cm_ differs from the base costmap only in the blocks updated previously.
+    if (compact_base_costmap_)
+    {
+      for (size_t b = 0; b < cm_.block_num(); ++b)
+      {
+        if (!cm_.isBlockDirty(b))
+          continue;
+        Astar::Vec block_min, block_max;
+        cm_.blockRegion(b, block_min, block_max);
+        cm_base_sparse_.copyTo(cm_, block_min, block_max);
+      }
+      cm_.clearDirtyBlocks();
+    }
+    else
+    {
+      cm_.copyDirtyBlocks(cm_base_);
+    }
+    storeBaseCostmap(
+        Astar::Vec(static_cast<int>(msg->x), static_cast<int>(msg->y), 0),
+        Astar::Vec(static_cast<int>(msg->x + msg->width), static_cast<int>(msg->y + msg->height), 0));
+    // cm_rough_ and the lethal masks differ from the base only in the region updated previously.
+    if (prev_map_update_x_min_ < prev_map_update_x_max_)
+    {
+      const Astar::Vec prev_min(prev_map_update_x_min_, prev_map_update_y_min_, 0);
+      const Astar::Vec prev_max(prev_map_update_x_max_, prev_map_update_y_max_, static_cast<int>(map_info_.angle));
+      cm_rough_.copyRegion(cm_rough_base_, prev_min, prev_max);
+      cm_mask_.copyRegion(cm_mask_base_, prev_min, prev_max);
+      cm_rough_mask_.copyRegion(cm_rough_mask_base_, prev_min, Astar::Vec(prev_max[0], prev_max[1], 1));
+      // cm_updates_ is filled by -1 except the region updated previously.
+      cm_updates_.clearRegion(-1, prev_min, Astar::Vec(prev_max[0], prev_max[1], 1));
+    }
 
-    bool clear_hysteresis(false);
+    std::atomic<bool> clear_hysteresis(false);
 
     {
       const Astar::Vec gp(
           static_cast<int>(msg->x), static_cast<int>(msg->y), static_cast<int>(msg->yaw));
       const Astar::Vec gp_rough(gp[0], gp[1], 0);
-      for (Astar::Vec p(0, 0, 0); p[0] < static_cast<int>(msg->width); p[0]++)
-      {
-        for (p[1] = 0; p[1] < static_cast<int>(msg->height); p[1]++)
-        {
-          int cost_min = 100;
-          for (p[2] = 0; p[2] < static_cast<int>(msg->angle); p[2]++)
+      const int angle = msg->angle;
+      const bool overwrite_cost = overwrite_cost_;
+      cm_.updateRowMajor(
+          reinterpret_cast<const char*>(msg->data.data()), gp,
+          Astar::Vec(static_cast<int>(msg->width), static_cast<int>(msg->height), angle),
+          [this, angle, overwrite_cost, &clear_hysteresis](const Astar::Vec& p, const char* c, char* cm)
           {
-            const size_t addr = ((p[2] * msg->height) + p[1]) * msg->width + p[0];
-            const char c = msg->data[addr];
-            if (c < cost_min)
-              cost_min = c;
-            if (c == 100 && !clear_hysteresis && cm_hyst_[gp + p] == 0)
-              clear_hysteresis = true;
-          }
-          p[2] = 0;
-          cm_updates_[gp_rough + p] = cost_min;
-          if (cost_min > cm_rough_[gp_rough + p])
-            cm_rough_[gp_rough + p] = cost_min;
+            const char cost_min = minCost(c, angle, 100);
+            if (!clear_hysteresis.load(std::memory_order_relaxed))
+            {
+              for (int i = 0; i < angle; ++i)
+              {
+                if (c[i] == 100 && cm_hyst_[Astar::Vec(p[0], p[1], p[2] + i)] == 0)
+                {
+                  clear_hysteresis.store(true, std::memory_order_relaxed);
+                  break;
+                }
+              }
+            }
+            const Astar::Vec p_rough(p[0], p[1], 0);
+            cm_updates_[p_rough] = cost_min;
+            if (cost_min > cm_rough_[p_rough])
+              cm_rough_[p_rough] = cost_min;
 
-          for (p[2] = 0; p[2] < static_cast<int>(msg->angle); p[2]++)
-          {
-            const size_t addr = ((p[2] * msg->height) + p[1]) * msg->width + p[0];
-            const char c = msg->data[addr];
-            if (overwrite_cost_)
+            if (overwrite_cost)
             {
-              if (c >= 0)
-                cm_[gp + p] = c;
+              for (int i = 0; i < angle; ++i)
+              {
+                if (c[i] >= 0)
+                  cm[i] = c[i];
+              }
             }
             else
             {
-              if (cm_[gp + p] < c)
-                cm_[gp + p] = c;
+              for (int i = 0; i < angle; ++i)
+              {
+                if (cm[i] < c[i])
+                  cm[i] = c[i];
+              }
             }
-          }
-        }
-      }
+          });
+      const Astar::Vec update_size(
+          static_cast<int>(msg->width), static_cast<int>(msg->height), static_cast<int>(msg->angle));
+      cm_mask_.update(cm_, gp, gp + update_size);
+      cm_rough_mask_.update(cm_rough_, gp_rough, gp_rough + Astar::Vec(update_size[0], update_size[1], 1));
+      if (hierarchical_planning_)
+        cluster_graph_.update(cm_rough_, gp_rough, gp_rough + Astar::Vec(update_size[0], update_size[1], 1));
+    }
+    ++map_update_version_;
+    map_lock.unlock();
+
+    if (incremental_search_)
+    {
+      // cm_ is restored from cm_base_ in the previously updated region.
+      const Astar::Vec margin(range_, range_, 0);
+      const Astar::Vec update_min =
+          Astar::Vec(static_cast<int>(msg->x), static_cast<int>(msg->y), 0) - margin;
+      const Astar::Vec update_max =
+          Astar::Vec(static_cast<int>(msg->x + msg->width), static_cast<int>(msg->y + msg->height),
+                     static_cast<int>(map_info_.angle)) +
+          margin;
+      as_.updateIncremental(incremental_update_min_prev_, incremental_update_max_prev_);
+      as_.updateIncremental(update_min, update_max);
+      incremental_update_min_prev_ = update_min;
+      incremental_update_max_prev_ = update_max;
     }
 
     if (clear_hysteresis && has_hysteresis_map_)
     {
       ROS_INFO("The previous path collides to the obstacle. Clearing hysteresis map.");
       cm_hyst_.clear(100);
+      hysteresis_map_.reset();
       has_hysteresis_map_ = false;
+      as_.resetIncremental();
     }
 
+    // cm_rough_ is restored from cm_rough_base_ in the previously updated region.
+    Astar::Vec update_min(
+        std::min(prev_map_update_x_min_, static_cast<int>(msg->x)),
+        std::min(prev_map_update_y_min_, static_cast<int>(msg->y)), 0);
+    Astar::Vec update_max(
+        std::max(prev_map_update_x_max_, static_cast<int>(msg->x + msg->width)),
+        std::max(prev_map_update_y_max_, static_cast<int>(msg->y + msg->height)), 1);
+    prev_map_update_x_min_ = static_cast<int>(msg->x);
+    prev_map_update_x_max_ = static_cast<int>(msg->x + msg->width);
+    prev_map_update_y_min_ = static_cast<int>(msg->y);
+    prev_map_update_y_max_ = static_cast<int>(msg->y + msg->height);
+    markCostEstimDirty(update_min, update_max);
+    path_check_x_min_ = std::min(path_check_x_min_, update_min[0]);
+    path_check_x_max_ = std::max(path_check_x_max_, update_max[0]);
+    path_check_y_min_ = std::min(path_check_y_min_, update_min[1]);
+    path_check_y_max_ = std::max(path_check_y_max_, update_max[1]);
+    // Cost map is not stored to the cache until it is updated for this map.
+    cost_estim_cacheable_ = false;
+
     if (!has_start_)
       return;
 
@@ -856,10 +1051,27 @@ protected:
           hist_ignore_range_, hist_ignore_range_max_);
       publishRememberedMap();
       bbf_costmap_.updateCostmap();
+
+      // Remembered costs around the robot are also updated.
+      const Astar::Vec remember_min(s[0] - hist_ignore_range_max_, s[1] - hist_ignore_range_max_, 0);
+      const Astar::Vec remember_max(s[0] + hist_ignore_range_max_ + 1, s[1] + hist_ignore_range_max_ + 1, 1);
+      markCostEstimDirty(remember_min, remember_max);
+      for (int i = 0; i < 2; ++i)
+      {
+        update_min[i] = std::min(update_min[i], remember_min[i]);
+        update_max[i] = std::max(update_max[i], remember_max[i]);
+      }
     }
     if (!has_goal_)
       return;
 
+    if (cost_estim_pending_)
+    {
+      if (cost_estim_worker_.done())
+        loadCostEstimWorker();
+      return;
+    }
+
     if (!fast_map_update_)
     {
       updateGoal(false);
@@ -873,7 +1085,8 @@ protected:
         tf2::getYaw(goal_.pose.orientation));
     e.cycleUnsigned(map_info_.angle);
 
-    if (cm_[e] == 100)
+    if (cm_[e] == 100 ||
+        (hierarchical_planning_ && (!corridor_valid_ || !cluster_graph_.inCorridor(s))))
     {
       updateGoal(false);
       return;
@@ -883,100 +1096,18 @@ protected:
 
     const auto ts = boost::chrono::high_resolution_clock::now();
 
-    const int map_update_x_min = static_cast<int>(msg->x);
-    const int map_update_x_max = static_cast<int>(msg->x + msg->width);
-    const int map_update_y_min = static_cast<int>(msg->y);
-    const int map_update_y_max = static_cast<int>(msg->y + msg->height);
-    const int search_range_x_min = std::max(0, std::min(prev_map_update_x_min_, map_update_x_min) - 1);
-    const int search_range_x_max = std::min(static_cast<int>(map_info_.width),
-                                            std::max(prev_map_update_x_max_, map_update_x_max) + 1);
-    const int search_range_y_min = std::max(0, std::min(prev_map_update_y_min_, map_update_y_min) - 1);
-    const int search_range_y_max = std::min(static_cast<int>(map_info_.height),
-                                            std::max(prev_map_update_y_max_, map_update_y_max) + 1);
-    Astar::Vec p, p_cost_min;
-    p[2] = 0;
-    float cost_min = std::numeric_limits<float>::max();
-    for (p[1] = search_range_y_min; p[1] < search_range_y_max; p[1]++)
-    {
-      for (p[0] = search_range_x_min; p[0] < search_range_x_max; p[0]++)
-      {
-        if (cost_min > cost_estim_cache_[p])
-        {
-          p_cost_min = p;
-          cost_min = cost_estim_cache_[p];
-        }
-      }
-    }
-    prev_map_update_x_min_ = map_update_x_min;
-    prev_map_update_x_max_ = map_update_x_max;
-    prev_map_update_y_min_ = map_update_y_min;
-    prev_map_update_y_max_ = map_update_y_max;
-
-    reservable_priority_queue<Astar::PriorityVec> open;
-    reservable_priority_queue<Astar::PriorityVec> erase;
-    open.reserve(map_info_.width * map_info_.height / 2);
-    erase.reserve(map_info_.width * map_info_.height / 2);
-
-    if (cost_min != std::numeric_limits<float>::max())
-      erase.emplace(cost_min, cost_min, p_cost_min);
-    while (true)
-    {
-      if (erase.size() < 1)
-        break;
-      const Astar::PriorityVec center(erase.top());
-      const Astar::Vec p = center.v_;
-      erase.pop();
-
-      if (cost_estim_cache_[p] == std::numeric_limits<float>::max())
-        continue;
-      cost_estim_cache_[p] = std::numeric_limits<float>::max();
-
-      Astar::Vec d;
-      d[2] = 0;
-      for (d[0] = -1; d[0] <= 1; d[0]++)
-      {
-        for (d[1] = -1; d[1] <= 1; d[1]++)
-        {
-          if (!((d[0] == 0) ^ (d[1] == 0)))
-            continue;
-          Astar::Vec next = p + d;
-          next[2] = 0;
-          if ((unsigned int)next[0] >= (unsigned int)map_info_.width ||
-              (unsigned int)next[1] >= (unsigned int)map_info_.height)
-            continue;
-          const float gn = cost_estim_cache_[next];
-          if (gn == std::numeric_limits<float>::max())
-            continue;
-          if (gn < cost_min)
-          {
-            open.emplace(gn, gn, next);
-            continue;
-          }
-          erase.emplace(gn, gn, next);
-        }
-      }
-    }
-    if (open.size() == 0)
-    {
-      open.emplace(-ec_[0] * 0.5, -ec_[0] * 0.5, e);
-    }
+    const Astar::Vec s_rough(s[0], s[1], 0);
+    cost_estim_cache_[e] = -ec_[0] * 0.5;  // Same as updateGoal()
+    distance_map_.update(
+        cost_estim_open_, cost_estim_cache_, s, e, update_min, update_max,
+        (hierarchical_planning_ && corridor_valid_) ? &cluster_graph_ : nullptr);
+    cost_estim_cache_[e] = 0;
+    if (cost_estim_cache_[s_rough] == std::numeric_limits<float>::max())
     {
-      Astar::Vec p;
-      p[2] = 0;
-      for (p[0] = 0; p[0] < static_cast<int>(map_info_.width); p[0]++)
-      {
-        for (p[1] = 0; p[1] < static_cast<int>(map_info_.height); p[1]++)
-        {
-          const auto gp = cost_estim_cache_[p];
-          if (gp > rough_cost_max_)
-          {
-            open.emplace(gp, gp, p);
-          }
-        }
-      }
+      updateGoal(false);
+      return;
     }
-
-    fillCostmap(open, cost_estim_cache_, s, e);
+    cost_estim_cacheable_ = !(hierarchical_planning_ && corridor_valid_);
     const auto tnow = boost::chrono::high_resolution_clock::now();
     ROS_DEBUG("Cost estimation cache updated (%0.4f sec.)",
               boost::chrono::duration<float>(tnow - ts).count());
@@ -989,6 +1120,8 @@ protected:
              msg->info.width, msg->info.height);
     ROS_INFO(" angular_resolution %0.2f x %d px", msg->info.angular_resolution,
              msg->info.angle);
+
+    std::unique_lock<std::mutex> map_lock(map_mutex_);
     ROS_INFO(" origin %0.3f m, %0.3f m, %0.3f rad",
              msg->info.origin.position.x,
              msg->info.origin.position.y,
@@ -997,6 +1130,18 @@ protected:
     // Stop robot motion until next planning step
     publishEmptyPath();
 
+    const Astar::Vec map_size(
+        static_cast<int>(msg->info.width),
+        static_cast<int>(msg->info.height),
+        static_cast<int>(msg->info.angle));
+    if (!Astar::isSizeSupported(map_size))
+    {
+      ROS_ERROR("Map has too many grids (%dx%dx%d) to be searched; map is ignored.",
+                msg->info.width, msg->info.height, msg->info.angle);
+      has_map_ = false;
+      return;
+    }
+
     ec_ = Astar::Vecf(
         1.0f / cc_.max_vel_,
         1.0f / cc_.max_vel_,
@@ -1021,12 +1166,13 @@ protected:
       cc_.angle_resolution_aspect_ = 2.0 / tanf(map_info_.angular_resolution);
 
       model_.reset(
-          new GridAstarModel3D(
+          new GridAstarModel3DPlanner(
               map_info_,
               ec_,
               local_range_,
               cost_estim_cache_, cm_, cm_hyst_, cm_rough_,
-              cc_, range_));
+              cc_, range_, motion_cache_dir_));
+      model_->setLethalMask(&cm_mask_);
 
       ROS_DEBUG("Search model updated");
     }
@@ -1034,6 +1180,21 @@ protected:
     {
       map_info_ = msg->info;
     }
+    {
+      DistanceMap::Params p;
+      p.euclid_cost = ec_;
+      p.range = range_;
+      p.local_range = local_range_;
+      p.longcut_range = longcut_range_;
+      p.weight_costmap = cc_.weight_costmap_;
+      p.weight_remembered = cc_.weight_remembered_;
+      p.num_cost_estim_task = num_cost_estim_task_;
+      // Bucket width of twice the straight move cost performed best on the benchmark maps.
+      p.delta_stepping_width = cost_estim_delta_stepping_ ? ec_[0] * 2 : 0;
+      distance_map_.init(map_info_, p);
+      cost_estim_worker_.init(map_info_, p);
+      cost_estim_pending_ = false;
+    }
     map_header_ = msg->header;
     jump_.setMapFrame(map_header_.frame_id);
 
@@ -1048,41 +1209,82 @@ protected:
     cm_hyst_.reset(Astar::Vec(size[0], size[1], size[2]));
 
     cost_estim_cache_.reset(Astar::Vec(size[0], size[1], 1));
+    cost_estim_open_.clear();
+    cost_estim_open_.reserve(map_info_.width * map_info_.height / 2);
     cm_rough_.reset(Astar::Vec(size[0], size[1], 1));
     cm_updates_.reset(Astar::Vec(size[0], size[1], 1));
+    cm_updates_.clear(-1);
     bbf_costmap_.reset(Astar::Vec(size[0], size[1], 1));
 
-    Astar::Vec p;
-    for (p[0] = 0; p[0] < static_cast<int>(map_info_.width); p[0]++)
-    {
-      for (p[1] = 0; p[1] < static_cast<int>(map_info_.height); p[1]++)
-      {
-        int cost_min = 100;
-        for (p[2] = 0; p[2] < static_cast<int>(map_info_.angle); p[2]++)
+    const char unknown_cost = unknown_cost_;
+    const int angle = size[2];
+    cm_.importRowMajor(
+        msg->data.data(),
+        [unknown_cost](const int8_t c)
         {
-          const size_t addr = ((p[2] * size[1]) + p[1]) * size[0] + p[0];
-          char c = msg->data[addr];
-          if (c < 0)
-            c = unknown_cost_;
-          cm_[p] = c;
-          if (c < cost_min)
-            cost_min = c;
-        }
-        p[2] = 0;
-        cm_rough_[p] = cost_min;
-      }
+          return c < 0 ? unknown_cost : static_cast<char>(c);
+        },
+        [this, angle](const Astar::Vec& p, const char* c)
+        {
+          cm_rough_[Astar::Vec(p[0], p[1], 0)] = minCost(c, angle, 100);
+        });
+    cm_mask_.reset(cm_.size());
+    cm_mask_.update(cm_, Astar::Vec(0, 0, 0), cm_.size());
+    cm_rough_mask_.reset(cm_rough_.size());
+    cm_rough_mask_.update(cm_rough_, Astar::Vec(0, 0, 0), cm_rough_.size());
+    if (num_landmarks_ > 0)
+    {
+      const auto ts = boost::chrono::high_resolution_clock::now();
+      landmark_heuristic_.build(cm_rough_, map_info_, distance_map_.params(), num_landmarks_);
+      const auto tnow = boost::chrono::high_resolution_clock::now();
+      ROS_DEBUG("%lu landmarks selected (%0.4f sec., %lu bytes)",
+                landmark_heuristic_.landmarks().size(),
+                boost::chrono::duration<float>(tnow - ts).count(),
+                landmark_heuristic_.bytes());
+    }
+    if (hierarchical_planning_)
+    {
+      ClusterGraph::Params p;
+      p.euclid_cost = ec_;
+      p.weight_costmap = cc_.weight_costmap_;
+      p.linear_resolution = map_info_.linear_resolution;
+      cluster_graph_.reset(cm_rough_.size(), hierarchical_cluster_size_, p);
+      cluster_graph_.update(cm_rough_, Astar::Vec(0, 0, 0), cm_rough_.size());
+      corridor_valid_ = false;
     }
     ROS_DEBUG("Map copied");
 
     cm_hyst_.clear(100);
+    hysteresis_map_.reset();
     has_hysteresis_map_ = false;
+    incremental_update_min_prev_ = Astar::Vec(0, 0, 0);
+    incremental_update_max_prev_ = Astar::Vec(0, 0, 0);
+    prev_map_update_x_min_ = std::numeric_limits<int>::max();
+    prev_map_update_x_max_ = std::numeric_limits<int>::lowest();
+    prev_map_update_y_min_ = std::numeric_limits<int>::max();
+    prev_map_update_y_max_ = std::numeric_limits<int>::lowest();
+    resetPathCheckRegion();
+    heuristic_cache_.clear();
+    cost_estim_cacheable_ = false;
+    path_grid_prev_.clear();
 
     has_map_ = true;
 
+    // cm_ keeps the base costmap of the blocks until they are updated first time.
+    cm_.clearDirtyBlocks();
+    if (compact_base_costmap_)
+      cm_base_sparse_.reset(cm_.size());
+    else
+      cm_base_.reset(cm_.size());
+    cm_base_stored_.assign(cm_.block_num(), 0);
     cm_rough_base_ = cm_rough_;
-    cm_base_ = cm_;
+    cm_mask_base_ = cm_mask_;
+    cm_rough_mask_base_ = cm_rough_mask_;
     bbf_costmap_.clear();
 
+    ++map_version_;
+    map_lock.unlock();
+
     updateGoal();
   }
   void cbAction()
@@ -1142,7 +1344,9 @@ public:
   Planner3dNode()
     : nh_()
     , pnh_("~")
+    , pnh_make_plan_("~")
     , tfl_(tfbuf_)
+    , distance_map_(cm_rough_, bbf_costmap_)
     , jump_(tfbuf_)
   {
     neonavigation_common::compat::checkCompatMode();
@@ -1161,7 +1365,8 @@ public:
     srs_forget_ = neonavigation_common::compat::advertiseService(
         nh_, "forget_planning_cost",
         pnh_, "forget", &Planner3dNode::cbForget, this);
-    srs_make_plan_ = pnh_.advertiseService("make_plan", &Planner3dNode::cbMakePlan, this);
+    pnh_make_plan_.setCallbackQueue(&make_plan_queue_);
+    srs_make_plan_ = pnh_make_plan_.advertiseService("make_plan", &Planner3dNode::cbMakePlan, this);
 
     // Debug outputs
     pub_distance_map_ = pnh_.advertise<sensor_msgs::PointCloud>("distance_map", 1, true);
@@ -1195,6 +1400,7 @@ public:
     pnh_.param("freq", freq_, 4.0f);
     pnh_.param("freq_min", freq_min_, 2.0f);
     pnh_.param("search_range", search_range_, 0.4f);
+    pnh_.param("motion_cache_dir", motion_cache_dir_, std::string(""));
     pnh_.param("antialias_start", antialias_start_, false);
 
     double costmap_watchdog;
@@ -1240,6 +1446,15 @@ public:
 
     pnh_.param("sw_wait", sw_wait_, 2.0f);
     pnh_.param("find_best", find_best_, true);
+    pnh_.param("anytime_search", anytime_search_, false);
+    pnh_.param("anytime_epsilon", anytime_epsilon_, 3.0f);
+    pnh_.param("anytime_epsilon_step", anytime_epsilon_step_, 0.5f);
+    pnh_.param("incremental_search", incremental_search_, false);
+    if (anytime_search_ && incremental_search_)
+    {
+      ROS_WARN("planner_3d: anytime_search and incremental_search are exclusive. incremental_search is disabled.");
+      incremental_search_ = false;
+    }
 
     pnh_.param("robot_frame", robot_frame_, std::string("base_link"));
 
@@ -1260,6 +1475,10 @@ public:
     {
       ROS_WARN("planner_3d: Experimental fast_map_update is enabled. ");
     }
+    pnh_.param("compact_base_costmap", compact_base_costmap_, false);
+    pnh_.param("hierarchical_planning", hierarchical_planning_, false);
+    pnh_.param("hierarchical_cluster_size", hierarchical_cluster_size_, 32);
+    corridor_valid_ = false;
     if (pnh_.hasParam("debug_mode"))
     {
       ROS_ERROR(
@@ -1283,6 +1502,13 @@ public:
     pnh_.param("queue_size_limit", queue_size_limit, 0);
     as_.setQueueSizeLimit(queue_size_limit);
 
+    double search_time_budget;
+    int search_expansion_budget;
+    pnh_.param("search_time_budget", search_time_budget, 0.0);
+    pnh_.param("search_expansion_budget", search_expansion_budget, 0);
+    as_.setSearchBudget(search_time_budget, std::max(search_expansion_budget, 0));
+    search_stats_ = as_.getSearchStats();
+
     int num_threads;
     pnh_.param("num_threads", num_threads, 1);
     omp_set_num_threads(num_threads);
@@ -1290,7 +1516,30 @@ public:
     int num_task;
     pnh_.param("num_search_task", num_task, num_threads * 16);
     as_.setSearchTaskNum(num_task);
+    bool distributed_search;
+    pnh_.param("distributed_search", distributed_search, false);
+    as_.enableDistributedSearch(distributed_search);
     pnh_.param("num_cost_estim_task", num_cost_estim_task_, num_threads * 16);
+    pnh_.param("cost_estim_delta_stepping", cost_estim_delta_stepping_, false);
+    double heuristic_cache_size;
+    pnh_.param("heuristic_cache_size", heuristic_cache_size, 0.0);
+    heuristic_cache_.setMemoryLimit(static_cast<size_t>(heuristic_cache_size * 1024 * 1024));
+    cost_estim_cacheable_ = false;
+    pnh_.param("num_landmarks", num_landmarks_, 0);
+    cost_estim_pending_ = false;
+
+    int make_plan_threads;
+    pnh_.param("make_plan_threads", make_plan_threads, 1);
+    make_plan_threads = std::max(1, make_plan_threads);
+    map_version_ = 0;
+    map_update_version_ = 0;
+    for (int i = 0; i < make_plan_threads; ++i)
+    {
+      make_plan_contexts_.emplace_back(new MakePlanContext());
+      // Worker is initialized on the first request.
+      make_plan_contexts_.back()->map_version_ = map_version_;
+      make_plan_contexts_.back()->map_update_version_ = map_update_version_;
+    }
 
     pnh_.param("retain_last_error_status", retain_last_error_status_, true);
     status_.status = planner_cspace_msgs::PlannerStatus::DONE;
@@ -1309,6 +1558,9 @@ public:
 
     act_->start();
     act_tolerant_->start();
+
+    make_plan_spinner_.reset(new ros::AsyncSpinner(make_plan_contexts_.size(), &make_plan_queue_));
+    make_plan_spinner_->start();
   }
 
   GridAstarModel3D::Vec pathPose2Grid(const geometry_msgs::PoseStamped& pose) const
@@ -1320,13 +1572,46 @@ public:
     return grid_vec;
   }
 
-  void waitUntil(const ros::Time& next_replan_time, const nav_msgs::Path& previous_path)
+  void resetPathCheckRegion()
+  {
+    path_check_x_min_ = std::numeric_limits<int>::max();
+    path_check_x_max_ = std::numeric_limits<int>::lowest();
+    path_check_y_min_ = std::numeric_limits<int>::max();
+    path_check_y_max_ = std::numeric_limits<int>::lowest();
+  }
+
+  // Checks the previous path only in the region of cm_ changed since the last check.
+  bool isPathBlocked(const std::vector<Astar::Vec>& path)
+  {
+    if (path_check_x_min_ >= path_check_x_max_ || path_check_y_min_ >= path_check_y_max_)
+      return false;
+    const Astar::Vec check_min(path_check_x_min_, path_check_y_min_, 0);
+    const Astar::Vec check_max(path_check_x_max_, path_check_y_max_, 0);
+    resetPathCheckRegion();
+
+    if (path.size() < 2)
+      return false;
+    for (const Astar::Vec& p : path)
+    {
+      if (check_min[0] <= p[0] && p[0] < check_max[0] &&
+          check_min[1] <= p[1] && p[1] < check_max[1] &&
+          cm_[p] == 100)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void waitUntil(const ros::Time& next_replan_time, const std::vector<Astar::Vec>& previous_path)
   {
+    // Robot pose is given by tf and doesn't wake up the callback queue.
+    const double pose_poll_period = 0.01;
     while (ros::ok())
     {
-      const ros::Time prev_map_update_stamp = last_costmap_;
-      ros::spinOnce();
-      const bool costmap_udpated = last_costmap_ != prev_map_update_stamp;
+      // Callbacks of the map, map update and goal are processed as soon as they arrive.
+      const double wait = std::min((next_replan_time - ros::Time::now()).toSec(), pose_poll_period);
+      ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(std::max(wait, 0.0)));
 
       if (has_map_)
       {
@@ -1339,16 +1624,10 @@ public:
           return;
         }
 
-        if (costmap_udpated && previous_path.poses.size() > 1)
+        if (isPathBlocked(previous_path))
         {
-          for (const auto& path_pose : previous_path.poses)
-          {
-            if (cm_[pathPose2Grid(path_pose)] == 100)
-            {
-              // Obstacle on the path.
-              return;
-            }
-          }
+          // Obstacle on the path.
+          return;
         }
 
         if (is_path_switchback_)
@@ -1371,7 +1650,6 @@ public:
       {
         return;
       }
-      ros::Duration(0.01).sleep();
     }
   }
 
@@ -1380,12 +1658,15 @@ public:
     ROS_DEBUG("Initialized");
 
     ros::Time next_replan_time = ros::Time::now();
-    nav_msgs::Path previous_path;
+    std::vector<Astar::Vec> previous_path;
 
     while (ros::ok())
     {
       waitUntil(next_replan_time, previous_path);
 
+      if (cost_estim_pending_ && cost_estim_worker_.done())
+        loadCostEstimWorker();
+
       const ros::Time now = ros::Time::now();
 
       if (has_map_ && !goal_updated_ && has_goal_)
@@ -1402,7 +1683,7 @@ public:
                             last_costmap_.toSec());
           status_.error = planner_cspace_msgs::PlannerStatus::DATA_MISSING;
           publishEmptyPath();
-          previous_path.poses.clear();
+          previous_path.clear();
         }
         else
         {
@@ -1471,7 +1752,7 @@ public:
             has_goal_ = false;
 
             publishEmptyPath();
-            previous_path.poses.clear();
+            previous_path.clear();
             next_replan_time += ros::Duration(1.0 / freq_);
             ROS_ERROR("Exceeded max_retry_num:%d", max_retry_num_);
 
@@ -1492,17 +1773,10 @@ public:
           path.header = map_header_;
           path.header.stamp = now;
           makePlan(start_.pose, goal_.pose, path, true);
-          if (use_path_with_velocity_)
-          {
-            // NaN velocity means that don't care the velocity
-            pub_path_velocity_.publish(
-                trajectory_tracker_msgs::toPathWithVelocity(path, std::numeric_limits<double>::quiet_NaN()));
-          }
-          else
-          {
-            pub_path_.publish(path);
-          }
-          previous_path = path;
+          publishPath(path);
+          previous_path.clear();
+          for (const auto& path_pose : path.poses)
+            previous_path.push_back(pathPose2Grid(path_pose));
 
           if (sw_wait_ > 0.0)
           {
@@ -1518,7 +1792,7 @@ public:
         if (!retain_last_error_status_)
           status_.error = planner_cspace_msgs::PlannerStatus::GOING_WELL;
         publishEmptyPath();
-        previous_path.poses.clear();
+        previous_path.clear();
       }
       pub_status_.publish(status_);
       diag_updater_.force_update();
@@ -1703,14 +1977,59 @@ protected:
     //   s[0], s[1], s[2], e[0], e[1], e[2]);
 
     model_->enableHysteresis(hyst && has_hysteresis_map_);
+    // The best partial path is always requested to be used if the search exceeds the budget.
+    // It is discarded below if the goal is unreachable and find_best is disabled.
     std::list<Astar::Vec> path_grid;
-    if (!as_.search(starts, e, path_grid,
-                    model_,
-                    std::bind(&Planner3dNode::cbProgress,
-                              this, std::placeholders::_1),
-                    range_limit,
-                    1.0f / freq_min_,
-                    find_best_))
+    bool path_found;
+    if (anytime_search_)
+    {
+      path_found = as_.searchAnytime(
+          starts, e, path_grid,
+          model_,
+          std::bind(&Planner3dNode::cbImprovedPath,
+                    this, std::placeholders::_1, path.header),
+          range_limit,
+          anytime_epsilon_, anytime_epsilon_step_,
+          1.0f / freq_min_,
+          true);
+    }
+    else if (incremental_search_)
+    {
+      path_found = as_.searchIncremental(
+          starts, e, path_grid,
+          model_,
+          range_limit,
+          true);
+    }
+    else
+    {
+      path_found = as_.search(
+          starts, e, path_grid,
+          model_,
+          std::bind(&Planner3dNode::cbProgress,
+                    this, std::placeholders::_1),
+          range_limit,
+          1.0f / freq_min_,
+          true);
+    }
+    search_stats_ = as_.getSearchStats();
+    if (search_stats_.budget_exceeded_)
+    {
+      if (path_found)
+      {
+        ROS_WARN("Path search exceeded the budget (%0.3f sec., %lu expansions), using the best path found so far",
+                 search_stats_.duration_, search_stats_.expansions_);
+      }
+      else
+      {
+        // The goal may be reachable. Follow the partial path and retry on the next replan.
+        ROS_WARN("Path search exceeded the budget (%0.3f sec., %lu expansions), using the partial path",
+                 search_stats_.duration_, search_stats_.expansions_);
+        if (path_grid.empty())
+          return false;
+      }
+    }
+    else if (!path_found)
     {
       ROS_WARN("Path plan failed (goal unreachable)");
       status_.error = planner_cspace_msgs::PlannerStatus::PATH_NOT_FOUND;
@@ -1736,64 +2055,21 @@ protected:
     }
     pub_path_poses_.publish(poses);
 
-    const std::list<Astar::Vecf> path_interpolated =
+    const std::vector<Astar::Vecf> path_interpolated =
         model_->path_interpolator_.interpolate(path_grid, 0.5, local_range_);
     grid_metric_converter::grid2MetricPath(map_info_, path_interpolated, path);
 
     if (hyst)
     {
-      std::unordered_map<Astar::Vec, bool, Astar::Vec> path_points;
       const float max_dist = cc_.hysteresis_max_dist_ / map_info_.linear_resolution;
       const float expand_dist = cc_.hysteresis_expand_ / map_info_.linear_resolution;
-      const int path_range = range_ + max_dist + expand_dist + 5;
-      for (const Astar::Vecf& p : path_interpolated)
-      {
-        Astar::Vec d;
-        for (d[0] = -path_range; d[0] <= path_range; d[0]++)
-        {
-          for (d[1] = -path_range; d[1] <= path_range; d[1]++)
-          {
-            Astar::Vec point = p + d;
-            point.cycleUnsigned(map_info_.angle);
-            if ((unsigned int)point[0] >= (unsigned int)map_info_.width ||
-                (unsigned int)point[1] >= (unsigned int)map_info_.height)
-              continue;
-            path_points[point] = true;
-          }
-        }
-      }
-
-      cm_hyst_.clear(100);
       const auto ts = boost::chrono::high_resolution_clock::now();
-      for (auto& ps : path_points)
-      {
-        const Astar::Vec& p = ps.first;
-        float d_min = std::numeric_limits<float>::max();
-        auto it_prev = path_interpolated.cbegin();
-        for (auto it = path_interpolated.cbegin(); it != path_interpolated.cend(); it++)
-        {
-          if (it != it_prev)
-          {
-            int yaw = std::lround((*it)[2]) % map_info_.angle;
-            int yaw_prev = std::lround((*it_prev)[2]) % map_info_.angle;
-            if (yaw < 0)
-              yaw += map_info_.angle;
-            if (yaw_prev < 0)
-              yaw_prev += map_info_.angle;
-            if (yaw == p[2] || yaw_prev == p[2])
-            {
-              const float d =
-                  CyclicVecFloat<3, 2>(p).distLinestrip2d(*it_prev, *it);
-              if (d < d_min)
-                d_min = d;
-            }
-          }
-          it_prev = it;
-        }
-        d_min = std::max(expand_dist, std::min(expand_dist + max_dist, d_min));
-        cm_hyst_[p] = std::lround((d_min - expand_dist) * 100.0 / max_dist);
-      }
+      hysteresis_map_.update(cm_hyst_, path_interpolated, expand_dist, max_dist);
       has_hysteresis_map_ = true;
+      // Search tree is valid only if the hysteresis map is not changed.
+      if (path_grid != path_grid_prev_)
+        as_.resetIncremental();
+      path_grid_prev_ = path_grid;
       const auto tnow = boost::chrono::high_resolution_clock::now();
       ROS_DEBUG("Hysteresis map generated (%0.4f sec.)",
                 boost::chrono::duration<float>(tnow - ts).count());
@@ -1809,6 +2085,18 @@ protected:
     ROS_WARN("Search timed out");
     return true;
   }
+  bool cbImprovedPath(const std::list<Astar::Vec>& path_grid, const std_msgs::Header& header)
+  {
+    // Publish intermediate solution of the anytime search to make the robot start moving.
+    nav_msgs::Path path;
+    path.header = header;
+    const std::vector<Astar::Vecf> path_interpolated =
+        model_->path_interpolator_.interpolate(path_grid, 0.5, local_range_);
+    grid_metric_converter::grid2MetricPath(map_info_, path_interpolated, path);
+    publishPath(path);
+    ROS_DEBUG("Path improved");
+    return true;
+  }
   int getSwitchIndex(const nav_msgs::Path& path) const
   {
     geometry_msgs::Pose p_prev;
@@ -1865,8 +2153,16 @@ protected:
         stat.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown error.");
         break;
     }
+    if (search_stats_.budget_exceeded_)
+      stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "Path search exceeded the budget.");
     stat.addf("status", "%u", status_.status);
     stat.addf("error", "%u", status_.error);
+    stat.addf("search_time", "%0.4f", search_stats_.duration_);
+    stat.addf("search_expansions", "%lu", search_stats_.expansions_);
+    stat.addf("search_expansions_per_sec", "%0.1f",
+              search_stats_.duration_ > 0 ? search_stats_.expansions_ / search_stats_.duration_ : 0.0f);
+    stat.addf("search_open_size", "%lu", search_stats_.open_size_);
+    stat.addf("search_budget_exceeded", "%s", search_stats_.budget_exceeded_ ? "true" : "false");
   }
 };
 }  // namespace planner_3d
@@ -60,6 +60,8 @@ void RotationCache::reset(
   const int angle = std::lround(M_PI * 2 / angular_resolution);
 
   pages_.resize(angle);
+  // Pages of the start angles are independent.
+#pragma omp parallel for schedule(dynamic)
   for (int i = 0; i < angle; i++)
   {
     Page& r = pages_[i];
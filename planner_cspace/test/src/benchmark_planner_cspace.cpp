@@ -0,0 +1,881 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <omp.h>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+#include <planner_cspace/bbf.h>
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/priority_queues.h>
+#include <planner_cspace/reservable_priority_queue.h>
+#include <planner_cspace/planner_3d/cluster_graph.h>
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+#include <planner_cspace/planner_3d/landmark_heuristic.h>
+#include <planner_cspace/planner_3d/grid_astar_model.h>
+#include <planner_cspace/planner_3d/grid_astar_model_impl.h>
+#include <planner_cspace/planner_3d/hysteresis_map.h>
+#include <planner_cspace/planner_3d/lethal_mask.h>
+#include <planner_cspace/planner_3d/motion_cache.h>
+#include <planner_cspace/planner_3d/rotation_cache.h>
+
+#include <benchmark/benchmark.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+namespace
+{
+using Astar = GridAstar<3, 2>;
+using Vec = Astar::Vec;
+
+constexpr int ANGLE = 16;
+constexpr int INFLATION_LETHAL = 4;
+constexpr int INFLATION_MAX = 10;
+
+// Search environment equivalent to planner_3d with default parameters.
+class Environment
+{
+public:
+  costmap_cspace_msgs::MapMetaData3D map_info_;
+  CostCoeff cc_;
+  Astar::Vecf ec_;
+  int range_;
+  int local_range_;
+  Astar::Gridmap<char, 0x40> cm_;
+  Astar::Gridmap<char, 0x80> cm_rough_;
+  Astar::Gridmap<char, 0x40> cm_hyst_;
+  Astar::Gridmap<float> cost_estim_cache_;
+  LethalMask cm_mask_;
+  LethalMask cm_rough_mask_;
+  CostmapBBF bbf_costmap_;
+  GridAstarModel3DPlanner::Ptr model_;
+  Vec start_;
+  Vec goal_;
+  std::list<Vec> path_;
+
+  // occupied is given in row-major order from the bottom-left corner.
+  Environment(
+      const int width, const int height, const float linear_resolution,
+      const std::vector<bool>& occupied, const std::vector<char>& base_cost,
+      const Vec& start, const Vec& goal)
+    : start_(start)
+    , goal_(goal)
+  {
+    map_info_.width = width;
+    map_info_.height = height;
+    map_info_.angle = ANGLE;
+    map_info_.linear_resolution = linear_resolution;
+    map_info_.angular_resolution = M_PI * 2 / ANGLE;
+
+    cc_.weight_decel_ = 50.0;
+    cc_.weight_backward_ = 0.9;
+    cc_.weight_ang_vel_ = 1.0;
+    cc_.weight_costmap_ = 50.0;
+    cc_.weight_costmap_turn_ = 0.0;
+    cc_.weight_remembered_ = 1000.0;
+    cc_.weight_hysteresis_ = 5.0;
+    cc_.in_place_turn_ = 30.0;
+    cc_.hysteresis_max_dist_ = 0.1;
+    cc_.hysteresis_expand_ = 0.1;
+    cc_.min_curve_radius_ = 0.1;
+    cc_.max_vel_ = 0.3;
+    cc_.max_ang_vel_ = 0.6;
+    cc_.angle_resolution_aspect_ = 2.0 / tanf(map_info_.angular_resolution);
+    ec_ = Astar::Vecf(1.0f / cc_.max_vel_, 1.0f / cc_.max_vel_, cc_.weight_ang_vel_ / cc_.max_ang_vel_);
+    range_ = static_cast<int>(0.4 / linear_resolution);
+    local_range_ = std::lround(2.5 / linear_resolution);
+
+    cm_.reset(Vec(width, height, ANGLE));
+    cm_hyst_.reset(Vec(width, height, ANGLE));
+    cm_rough_.reset(Vec(width, height, 1));
+    cost_estim_cache_.reset(Vec(width, height, 1));
+    bbf_costmap_.reset(Vec(width, height, 1));
+    bbf_costmap_.clear();
+    cm_hyst_.clear(100);
+
+    // Inflate obstacles as costmap_cspace does for a circular robot.
+    for (Vec p(0, 0, 0); p[1] < height; ++p[1])
+    {
+      for (p[0] = 0; p[0] < width; ++p[0])
+      {
+        cm_rough_[p] = base_cost[p[1] * width + p[0]];
+      }
+    }
+    for (Vec p(0, 0, 0); p[1] < height; ++p[1])
+    {
+      for (p[0] = 0; p[0] < width; ++p[0])
+      {
+        if (!occupied[p[1] * width + p[0]])
+          continue;
+        Vec d(0, 0, 0);
+        for (d[1] = -INFLATION_MAX; d[1] <= INFLATION_MAX; ++d[1])
+        {
+          for (d[0] = -INFLATION_MAX; d[0] <= INFLATION_MAX; ++d[0])
+          {
+            const Vec pos = p + d;
+            if (static_cast<size_t>(pos[0]) >= static_cast<size_t>(width) ||
+                static_cast<size_t>(pos[1]) >= static_cast<size_t>(height))
+              continue;
+            const float dist = d.len();
+            if (dist > INFLATION_MAX)
+              continue;
+            const char c =
+                dist <= INFLATION_LETHAL ?
+                    100 :
+                    99 * (INFLATION_MAX - dist) / (INFLATION_MAX - INFLATION_LETHAL);
+            if (cm_rough_[pos] < c)
+              cm_rough_[pos] = c;
+          }
+        }
+      }
+    }
+    for (Vec p(0, 0, 0); p[1] < height; ++p[1])
+    {
+      for (p[0] = 0; p[0] < width; ++p[0])
+      {
+        const char c = cm_rough_[p];
+        for (p[2] = 0; p[2] < ANGLE; ++p[2])
+          cm_[p] = c;
+        p[2] = 0;
+      }
+    }
+
+    model_.reset(
+        new GridAstarModel3DPlanner(
+            map_info_, ec_, local_range_,
+            cost_estim_cache_, cm_, cm_hyst_, cm_rough_,
+            cc_, range_));
+
+    cm_mask_.reset(size());
+    cm_mask_.update(cm_, Vec(0, 0, 0), size());
+    cm_rough_mask_.reset(Vec(size()[0], size()[1], 1));
+    cm_rough_mask_.update(cm_rough_, Vec(0, 0, 0), cm_rough_mask_.size());
+    model_->setLethalMask(&cm_mask_);
+  }
+
+  Vec size() const
+  {
+    return Vec(static_cast<int>(map_info_.width), static_cast<int>(map_info_.height), ANGLE);
+  }
+
+  DistanceMap::Params distanceMapParams(const int num_threads, const float delta_stepping_width = 0) const
+  {
+    DistanceMap::Params p;
+    p.euclid_cost = ec_;
+    p.range = range_;
+    p.local_range = local_range_;
+    p.longcut_range = 0;
+    p.weight_costmap = cc_.weight_costmap_;
+    p.weight_remembered = cc_.weight_remembered_;
+    p.num_cost_estim_task = num_threads * 16;
+    p.delta_stepping_width = delta_stepping_width;
+    return p;
+  }
+
+  ClusterGraph::Params clusterGraphParams() const
+  {
+    ClusterGraph::Params p;
+    p.euclid_cost = ec_;
+    p.weight_costmap = cc_.weight_costmap_;
+    p.linear_resolution = map_info_.linear_resolution;
+    return p;
+  }
+
+  // Same as Planner3dNode::updateGoal()
+  void fillCostEstimCache(const DistanceMap& dm, const ClusterGraph* corridor = nullptr)
+  {
+    const Vec e(goal_[0], goal_[1], 0);
+    reservable_priority_queue<Astar::PriorityVec> open;
+    open.reserve(map_info_.width * map_info_.height / 2);
+    cost_estim_cache_.clear(std::numeric_limits<float>::max());
+    cost_estim_cache_[e] = -ec_[0] * 0.5;
+    open.push(Astar::PriorityVec(cost_estim_cache_[e], cost_estim_cache_[e], e));
+    dm.fill(open, cost_estim_cache_, start_, corridor);
+    cost_estim_cache_[e] = 0;
+  }
+
+  void prepare()
+  {
+    DistanceMap dm(cm_rough_, bbf_costmap_);
+    dm.init(map_info_, distanceMapParams(1));
+    fillCostEstimCache(dm);
+
+    Astar as(size());
+    std::vector<Astar::VecWithCost> starts;
+    starts.emplace_back(start_);
+    as.search(
+        starts, goal_, path_, model_,
+        [](const std::list<Vec>&)
+        {
+          return true;
+        },
+        0, 1000.0);
+  }
+};
+
+std::unique_ptr<Environment> createSyntheticEnvironment(const int size)
+{
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> cost_dist(0, 24);
+  std::vector<bool> occupied(size * size);
+  std::vector<char> base_cost(size * size);
+  for (int y = 0; y < size; ++y)
+  {
+    for (int x = 0; x < size; ++x)
+    {
+      // Walls with gaps
+      occupied[y * size + x] = (x % 0x20 == 0x10 && y % 0x40 > 0x18);
+      base_cost[y * size + x] = cost_dist(engine);
+    }
+  }
+  return std::unique_ptr<Environment>(
+      new Environment(
+          size, size, 0.1, occupied, base_cost,
+          Vec(4, 4, 0), Vec(size - 5, size - 5, ANGLE / 4)));
+}
+
+// Loads binary PGM converted from neonavigation_launch/map/demo_map.png.
+std::unique_ptr<Environment> createRecordedEnvironment(const std::string& file)
+{
+  std::ifstream ifs(file, std::ios::binary);
+  std::string magic;
+  int width, height, max_value;
+  ifs >> magic >> width >> height >> max_value;
+  ifs.get();
+  if (!ifs || magic != "P5")
+    return nullptr;
+  std::vector<unsigned char> pixels(width * height);
+  ifs.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+  if (!ifs)
+    return nullptr;
+
+  std::vector<bool> occupied(width * height);
+  std::vector<char> base_cost(width * height, 0);
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      // Same as map_server with free_thresh: 0.1, treating unknown as occupied
+      const float p = (max_value - pixels[(height - 1 - y) * width + x]) / static_cast<float>(max_value);
+      occupied[y * width + x] = p > 0.1;
+    }
+  }
+  return std::unique_ptr<Environment>(
+      new Environment(
+          width, height, 0.05, occupied, base_cost,
+          Vec(20, 332, 0), Vec(379, 161, ANGLE / 2)));
+}
+
+Environment* getEnvironment(const std::string& name)
+{
+  static std::map<std::string, std::unique_ptr<Environment>> envs;
+  auto it = envs.find(name);
+  if (it != envs.end())
+    return it->second.get();
+
+  std::unique_ptr<Environment> env;
+  if (name == "demo_map")
+    env = createRecordedEnvironment(std::string(PLANNER_CSPACE_BENCHMARK_DATA_DIR) + "/demo_map.pgm");
+  else
+    env = createSyntheticEnvironment(std::stoi(name.substr(name.find('_') + 1)));
+  if (env)
+    env->prepare();
+  return (envs[name] = std::move(env)).get();
+}
+
+template <template <class> class OPEN_LIST = reservable_priority_queue, bool LAZY = false, class MODEL>
+void benchmarkSearch(
+    benchmark::State& state, const Environment& env,
+    const std::shared_ptr<MODEL>& model, const Vec& start, const Vec& goal)
+{
+  using AstarWithOpenList = GridAstar<3, 2, OPEN_LIST, LAZY>;
+  const int num_threads = state.range(0);
+  omp_set_num_threads(num_threads);
+
+  AstarWithOpenList as(env.size());
+  as.setSearchTaskNum(num_threads * 16);
+  std::vector<typename AstarWithOpenList::VecWithCost> starts;
+  starts.emplace_back(start);
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+  std::list<Vec> path;
+  for (auto _ : state)
+  {
+    path.clear();
+    if (!as.search(starts, goal, path, model, cb_progress, 0, 1000.0))
+    {
+      state.SkipWithError("Path not found");
+      break;
+    }
+  }
+  state.counters["path_length"] = path.size();
+}
+
+void benchmarkSearch3D(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  benchmarkSearch(state, *env, env->model_, env->start_, env->goal_);
+}
+
+void benchmarkSearch3DLazy(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  benchmarkSearch<reservable_priority_queue, true>(state, *env, env->model_, env->start_, env->goal_);
+}
+
+void benchmarkSearch2D(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  // Same as MakePlanWorker::search() without the cost estimation cache
+  const GridAstarModel2DPlanner::Ptr model_2d(
+      new GridAstarModel2DPlanner(
+          env->map_info_, env->ec_,
+          env->cost_estim_cache_, env->cm_rough_,
+          env->cc_, env->range_));
+  model_2d->setLethalMask(&env->cm_rough_mask_);
+  benchmarkSearch(
+      state, *env, model_2d,
+      Vec(env->start_[0], env->start_[1], 0), Vec(env->goal_[0], env->goal_[1], 0));
+}
+
+template <class T>
+using DaryHeap4 = dary_heap<T, 4>;
+template <class T>
+using BucketQueue = bucket_queue<T, 16>;
+template <class T>
+using TwoLevelBucketQueue = two_level_bucket_queue<T, 1>;
+
+template <template <class> class OPEN_LIST>
+void benchmarkSearch3DOpenList(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  benchmarkSearch<OPEN_LIST>(state, *env, env->model_, env->start_, env->goal_);
+}
+
+// Operations on the open list during the search
+struct OpenListTrace
+{
+  enum Operation : char
+  {
+    PUSH,
+    POP,
+    POP_BACK,
+  };
+  std::vector<Operation> ops_;
+  std::vector<Astar::PriorityVec> pushed_;
+};
+OpenListTrace* recording_trace = nullptr;
+
+template <class T>
+class RecordingQueue : public reservable_priority_queue<T>
+{
+  using Base = reservable_priority_queue<T>;
+
+public:
+  void push(const T& v)
+  {
+    record(v);
+    Base::push(v);
+  }
+  void push(T&& v)
+  {
+    record(v);
+    Base::push(std::move(v));
+  }
+  template <class... ARGS>
+  void emplace(ARGS&&... args)
+  {
+    push(T(std::forward<ARGS>(args)...));
+  }
+  void pop()
+  {
+    recording_trace->ops_.push_back(OpenListTrace::POP);
+    Base::pop();
+  }
+  void pop_back()
+  {
+    recording_trace->ops_.push_back(OpenListTrace::POP_BACK);
+    Base::pop_back();
+  }
+
+private:
+  void record(const T& v)
+  {
+    recording_trace->ops_.push_back(OpenListTrace::PUSH);
+    recording_trace->pushed_.emplace_back(v.p_, v.p_raw_, v.v_);
+  }
+};
+
+const OpenListTrace& getOpenListTrace(const std::string& map, const size_t queue_size_limit)
+{
+  static std::map<std::pair<std::string, size_t>, OpenListTrace> traces;
+  const auto key = std::make_pair(map, queue_size_limit);
+  auto it = traces.find(key);
+  if (it != traces.end())
+    return it->second;
+
+  OpenListTrace& trace = traces[key];
+  Environment* env = getEnvironment(map);
+  if (!env)
+    return trace;
+
+  omp_set_num_threads(1);
+  GridAstar<3, 2, RecordingQueue> as(env->size());
+  as.setQueueSizeLimit(queue_size_limit);
+  std::vector<GridAstar<3, 2, RecordingQueue>::VecWithCost> starts;
+  starts.emplace_back(env->start_);
+  std::list<Vec> path;
+  recording_trace = &trace;
+  as.search(
+      starts, env->goal_, path, env->model_,
+      [](const std::list<Vec>&)
+      {
+        return true;
+      },
+      0, 1000.0);
+  recording_trace = nullptr;
+  return trace;
+}
+
+// Replays the open list operations recorded during planner_3d search
+// to measure the open list performance without the cost calculation.
+template <template <class> class OPEN_LIST>
+void benchmarkOpenListReplay(benchmark::State& state, const std::string& map)
+{
+  const OpenListTrace& trace = getOpenListTrace(map, state.range(0));
+  if (trace.ops_.empty())
+  {
+    state.SkipWithError("Failed to record the search");
+    return;
+  }
+  OPEN_LIST<Astar::PriorityVec> open;
+  for (auto _ : state)
+  {
+    open.clear();
+    auto pushed = trace.pushed_.cbegin();
+    for (const OpenListTrace::Operation op : trace.ops_)
+    {
+      switch (op)
+      {
+        case OpenListTrace::PUSH:
+          open.push(Astar::PriorityVec(*(pushed++)));
+          break;
+        case OpenListTrace::POP:
+          if (open.size() > 0)
+            open.pop();
+          break;
+        case OpenListTrace::POP_BACK:
+          if (open.size() > 0)
+            open.pop_back();
+          break;
+      }
+    }
+    benchmark::DoNotOptimize(open.size());
+  }
+  state.counters["ops"] = benchmark::Counter(
+      trace.ops_.size(), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void benchmarkDistanceMapFill(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  const int num_threads = state.range(0);
+  omp_set_num_threads(num_threads);
+
+  DistanceMap dm(env->cm_rough_, env->bbf_costmap_);
+  dm.init(env->map_info_, env->distanceMapParams(num_threads));
+  for (auto _ : state)
+  {
+    env->fillCostEstimCache(dm);
+  }
+}
+
+void benchmarkDistanceMapUpdate(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  const int num_threads = state.range(0);
+  omp_set_num_threads(num_threads);
+
+  DistanceMap dm(env->cm_rough_, env->bbf_costmap_);
+  dm.init(env->map_info_, env->distanceMapParams(num_threads));
+
+  const Vec e(env->goal_[0], env->goal_[1], 0);
+  reservable_priority_queue<Astar::PriorityVec> open;
+  open.reserve(env->map_info_.width * env->map_info_.height / 2);
+  env->cost_estim_cache_.clear(std::numeric_limits<float>::max());
+  env->cost_estim_cache_[e] = -env->ec_[0] * 0.5;
+  open.push(Astar::PriorityVec(env->cost_estim_cache_[e], env->cost_estim_cache_[e], e));
+  dm.fill(open, env->cost_estim_cache_, env->start_);
+
+  // Put and remove a small obstacle on the path as planner_3d does on costmap updates.
+  auto it = env->path_.begin();
+  std::advance(it, env->path_.size() / 2);
+  const Vec update_min((*it)[0] - 1, (*it)[1] - 1, 0);
+  const Vec update_max((*it)[0] + 2, (*it)[1] + 2, 1);
+  std::vector<char> orig;
+  for (Vec p = update_min; p[1] < update_max[1]; ++p[1])
+  {
+    for (p[0] = update_min[0]; p[0] < update_max[0]; ++p[0])
+      orig.push_back(env->cm_rough_[p]);
+  }
+  bool occupied = false;
+  for (auto _ : state)
+  {
+    occupied = !occupied;
+    auto c = orig.cbegin();
+    for (Vec p = update_min; p[1] < update_max[1]; ++p[1])
+    {
+      for (p[0] = update_min[0]; p[0] < update_max[0]; ++p[0], ++c)
+        env->cm_rough_[p] = occupied ? 100 : *c;
+    }
+    dm.update(open, env->cost_estim_cache_, env->start_, e, update_min, update_max);
+  }
+  auto c = orig.cbegin();
+  for (Vec p = update_min; p[1] < update_max[1]; ++p[1])
+  {
+    for (p[0] = update_min[0]; p[0] < update_max[0]; ++p[0], ++c)
+      env->cm_rough_[p] = *c;
+  }
+  env->cost_estim_cache_[e] = 0;
+}
+
+void benchmarkDistanceMapFillDeltaStepping(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  const int num_threads = state.range(0);
+  omp_set_num_threads(num_threads);
+
+  DistanceMap dm(env->cm_rough_, env->bbf_costmap_);
+  dm.init(env->map_info_, env->distanceMapParams(num_threads, env->ec_[0] * 2));
+  for (auto _ : state)
+  {
+    env->fillCostEstimCache(dm);
+  }
+}
+
+void benchmarkLandmarkHeuristicFill(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  const int num_threads = state.range(0);
+  omp_set_num_threads(num_threads);
+
+  LandmarkHeuristic lh;
+  lh.build(env->cm_rough_, env->map_info_, env->distanceMapParams(num_threads), 4);
+  const Vec e(env->goal_[0], env->goal_[1], 0);
+  for (auto _ : state)
+  {
+    lh.fill(e, env->cost_estim_cache_);
+  }
+}
+
+void benchmarkClusterGraphUpdate(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  const int num_threads = state.range(0);
+  omp_set_num_threads(num_threads);
+
+  ClusterGraph cg;
+  for (auto _ : state)
+  {
+    cg.reset(env->cm_rough_.size(), 32, env->clusterGraphParams());
+    cg.update(env->cm_rough_, Vec(0, 0, 0), env->cm_rough_.size());
+  }
+  state.counters["nodes"] = cg.numNodes();
+}
+
+void benchmarkDistanceMapFillCorridor(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  const int num_threads = state.range(0);
+  omp_set_num_threads(num_threads);
+
+  DistanceMap dm(env->cm_rough_, env->bbf_costmap_);
+  dm.init(env->map_info_, env->distanceMapParams(num_threads));
+  ClusterGraph cg;
+  cg.reset(env->cm_rough_.size(), 32, env->clusterGraphParams());
+  cg.update(env->cm_rough_, Vec(0, 0, 0), env->cm_rough_.size());
+  for (auto _ : state)
+  {
+    if (!cg.updateCorridor(env->cm_rough_, env->start_, env->goal_))
+    {
+      state.SkipWithError("Abstract path not found");
+      return;
+    }
+    env->fillCostEstimCache(dm, &cg);
+  }
+}
+
+void benchmarkPathInterpolatorInterpolate(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(env->model_->path_interpolator_.interpolate(env->path_, 0.5, env->local_range_));
+  }
+  state.counters["path_length"] = env->path_.size();
+}
+
+void benchmarkHysteresisMapUpdate(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  const std::vector<Astar::Vecf> path =
+      env->model_->path_interpolator_.interpolate(env->path_, 0.5, env->local_range_);
+  const float max_dist = env->cc_.hysteresis_max_dist_ / env->map_info_.linear_resolution;
+  const float expand_dist = env->cc_.hysteresis_expand_ / env->map_info_.linear_resolution;
+  Astar::Gridmap<char, 0x40> cm_hyst(env->cm_hyst_.size());
+  cm_hyst.clear(100);
+  HysteresisMap hysteresis_map;
+  for (auto _ : state)
+  {
+    hysteresis_map.update(cm_hyst, path, expand_dist, max_dist);
+  }
+  state.counters["path_length"] = path.size();
+}
+
+void benchmarkCostmapBBFRemember(benchmark::State& state, const std::string& map)
+{
+  Environment* env = getEnvironment(map);
+  if (!env)
+  {
+    state.SkipWithError("Failed to load map");
+    return;
+  }
+  const float linear_resolution = env->map_info_.linear_resolution;
+  const int range_min = std::lround(0.6 / linear_resolution);
+  const int range_max = std::lround(1.25 / linear_resolution);
+  const float hit_odds = bbf::probabilityToOdds(0.6);
+  const float miss_odds = bbf::probabilityToOdds(0.3);
+
+  CostmapBBF bbf_costmap;
+  bbf_costmap.reset(Vec(env->size()[0], env->size()[1], 1));
+  bbf_costmap.clear();
+  std::list<Vec>::const_iterator it = env->path_.cbegin();
+  for (auto _ : state)
+  {
+    // Remember along the path as the robot moves
+    if (it == env->path_.cend())
+      it = env->path_.cbegin();
+    bbf_costmap.remember(&env->cm_rough_, *it, hit_odds, miss_odds, range_min, range_max);
+    ++it;
+  }
+}
+
+void benchmarkMotionCacheReset(benchmark::State& state)
+{
+  const int range = state.range(0);
+  const int angle = state.range(1);
+  BlockMemGridmap<char, 3, 2, 0x40> gm(Vec(0x100, 0x100, angle));
+  MotionCache cache;
+  for (auto _ : state)
+  {
+    cache.reset(0.1, M_PI * 2 / angle, range, gm.getAddressor());
+  }
+}
+
+void benchmarkRotationCacheReset(benchmark::State& state)
+{
+  const int range = state.range(0);
+  const int angle = state.range(1);
+  RotationCache cache;
+  for (auto _ : state)
+  {
+    cache.reset(0.1, M_PI * 2 / angle, range);
+  }
+}
+
+template <template <class> class OPEN_LIST>
+void registerOpenListBenchmarks(const std::string& name)
+{
+  for (const std::string map : {"synthetic_64", "synthetic_128", "synthetic_256", "demo_map"})
+  {
+    benchmark::RegisterBenchmark(
+        ("GridAstarSearch3DOpenList/" + name + "/" + map).c_str(),
+        [map](benchmark::State& state)
+        {
+          benchmarkSearch3DOpenList<OPEN_LIST>(state, map);
+        })
+        ->ArgName("threads")
+        ->Arg(1)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(
+        ("OpenListReplay/" + name + "/" + map).c_str(),
+        [map](benchmark::State& state)
+        {
+          benchmarkOpenListReplay<OPEN_LIST>(state, map);
+        })
+        ->ArgName("queue_size_limit")
+        ->Arg(0)
+        ->Arg(1000)
+        ->Unit(benchmark::kMillisecond);
+  }
+}
+
+void registerMapBenchmark(
+    const std::string& name,
+    void (*fn)(benchmark::State&, const std::string&),
+    const bool threads)
+{
+  for (const std::string map : {"synthetic_64", "synthetic_128", "synthetic_256", "demo_map"})
+  {
+    auto* b = benchmark::RegisterBenchmark(
+        (name + "/" + map).c_str(),
+        [fn, map](benchmark::State& state)
+        {
+          fn(state, map);
+        });
+    b->Unit(benchmark::kMillisecond);
+    if (threads)
+    {
+      b->ArgName("threads");
+      for (int n = 1; n <= omp_get_max_threads(); n *= 2)
+        b->Arg(n);
+    }
+    else
+    {
+      b->Arg(1);
+    }
+  }
+}
+}  // namespace
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  using namespace planner_cspace::planner_3d;  // NOLINT(build/namespaces)
+
+  registerMapBenchmark("GridAstarSearch3D", benchmarkSearch3D, true);
+  registerMapBenchmark("GridAstarSearch3DLazy", benchmarkSearch3DLazy, true);
+  registerMapBenchmark("GridAstarSearch2D", benchmarkSearch2D, true);
+  registerMapBenchmark("DistanceMapFill", benchmarkDistanceMapFill, true);
+  registerMapBenchmark("DistanceMapUpdate", benchmarkDistanceMapUpdate, true);
+  registerMapBenchmark("DistanceMapFillDeltaStepping", benchmarkDistanceMapFillDeltaStepping, true);
+  registerMapBenchmark("DistanceMapFillCorridor", benchmarkDistanceMapFillCorridor, true);
+  registerMapBenchmark("LandmarkHeuristicFill", benchmarkLandmarkHeuristicFill, true);
+  registerMapBenchmark("ClusterGraphUpdate", benchmarkClusterGraphUpdate, true);
+  registerMapBenchmark("PathInterpolatorInterpolate", benchmarkPathInterpolatorInterpolate, false);
+  registerMapBenchmark("HysteresisMapUpdate", benchmarkHysteresisMapUpdate, false);
+  registerMapBenchmark("CostmapBBFRemember", benchmarkCostmapBBFRemember, false);
+  registerOpenListBenchmarks<planner_cspace::reservable_priority_queue>("reservable_priority_queue");
+  registerOpenListBenchmarks<DaryHeap4>("dary_heap4");
+  registerOpenListBenchmarks<planner_cspace::min_max_heap>("min_max_heap");
+  registerOpenListBenchmarks<BucketQueue>("bucket_queue16");
+  registerOpenListBenchmarks<TwoLevelBucketQueue>("two_level_bucket_queue1");
+  benchmark::RegisterBenchmark("MotionCacheReset", benchmarkMotionCacheReset)
+      ->ArgNames({"range", "angle"})
+      ->ArgsProduct({{4, 8}, {16, 32}})
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("RotationCacheReset", benchmarkRotationCacheReset)
+      ->ArgNames({"range", "angle"})
+      ->ArgsProduct({{4, 8}, {16, 32}})
+      ->Unit(benchmark::kMillisecond);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -27,12 +27,15 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
 #include <cstddef>
 #include <limits>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/compact_blockmem_gridmap.h>
 
 namespace planner_cspace
 {
@@ -120,6 +123,235 @@ TEST(BlockmemGridmap, WriteRead)
   }
 }
 
+TEST(BlockmemGridmap, Copy)
+{
+  BlockMemGridmap<float, 3, 2, 0x20> gm;
+  BlockMemGridmap<float, 3, 2, 0x20> gm2;
+
+  const CyclicVecInt<3, 2> s(40, 40, 2);
+  gm.reset(s);
+  gm2.reset(CyclicVecInt<3, 2>(4, 4, 1));
+
+  CyclicVecInt<3, 2> i;
+  for (i[0] = 0; i[0] < s[0]; ++i[0])
+  {
+    for (i[1] = 0; i[1] < s[1]; ++i[1])
+    {
+      for (i[2] = 0; i[2] < s[2]; ++i[2])
+      {
+        gm[i] = i[2] * 10000 + i[1] * 100 + i[0];
+      }
+    }
+  }
+
+  gm2 = gm;
+  ASSERT_EQ(s, gm2.size());
+  for (i[0] = 0; i[0] < s[0]; ++i[0])
+  {
+    for (i[1] = 0; i[1] < s[1]; ++i[1])
+    {
+      for (i[2] = 0; i[2] < s[2]; ++i[2])
+      {
+        ASSERT_EQ(i[2] * 10000 + i[1] * 100 + i[0], gm2[i]);
+      }
+    }
+  }
+}
+
+TEST(BlockmemGridmap, ImportRowMajor)
+{
+  using Vec = CyclicVecInt<3, 2>;
+  BlockMemGridmap<int, 3, 2, 0x10> gm;
+  BlockMemGridmap<int, 3, 2, 0x20> gm_min;
+
+  // Not aligned to the block width
+  const Vec s(37, 21, 3);
+  gm.reset(s);
+  gm_min.reset(Vec(s[0], s[1], 1));
+  gm_min.clear(-1);
+
+  std::vector<int> src(s[0] * s[1] * s[2]);
+  for (size_t i = 0; i < src.size(); ++i)
+  {
+    src[i] = i;
+  }
+  gm.importRowMajor(
+      src.data(),
+      [](const int v)
+      {
+        return v * 2;
+      },
+      [&gm_min, &s](const Vec& p, const int* v)
+      {
+        gm_min[Vec(p[0], p[1], 0)] = *std::min_element(v, v + s[2]);
+      });
+
+  Vec i;
+  for (i[0] = 0; i[0] < s[0]; ++i[0])
+  {
+    for (i[1] = 0; i[1] < s[1]; ++i[1])
+    {
+      for (i[2] = 0; i[2] < s[2]; ++i[2])
+      {
+        ASSERT_EQ(2 * (((i[2] * s[1]) + i[1]) * s[0] + i[0]), gm[i]) << i[0] << ", " << i[1] << ", " << i[2];
+      }
+      ASSERT_EQ(2 * (i[1] * s[0] + i[0]), gm_min[Vec(i[0], i[1], 0)]);
+    }
+  }
+}
+
+TEST(BlockmemGridmap, UpdateRowMajor)
+{
+  using Vec = CyclicVecInt<3, 2>;
+  BlockMemGridmap<int, 3, 2, 0x10> gm(Vec(0x40, 0x30, 4));
+  BlockMemGridmap<int, 3, 2, 0x10> base(gm.size());
+  gm.clear(0);
+  base.clear(0);
+  EXPECT_EQ(12u, gm.block_num());
+
+  // Region partially outside of the map
+  const Vec origin(0x3A, 0x0E, 1);
+  const Vec region(0x08, 0x04, 2);
+  std::vector<int> src(region[0] * region[1] * region[2]);
+  for (size_t i = 0; i < src.size(); ++i)
+  {
+    src[i] = i + 1;
+  }
+  gm.updateRowMajor(
+      src.data(), origin, region,
+      [&region](const Vec&, const int* values, int* cells)
+      {
+        for (int a = 0; a < region[2]; ++a)
+        {
+          cells[a] = values[a];
+        }
+      });
+
+  Vec i;
+  for (i[0] = 0; i[0] < gm.size()[0]; ++i[0])
+  {
+    for (i[1] = 0; i[1] < gm.size()[1]; ++i[1])
+    {
+      for (i[2] = 0; i[2] < gm.size()[2]; ++i[2])
+      {
+        const Vec d = i - origin;
+        if (0 <= d[0] && d[0] < region[0] && 0 <= d[1] && d[1] < region[1] && 0 <= d[2] && d[2] < region[2])
+        {
+          ASSERT_EQ(((d[2] * region[1]) + d[1]) * region[0] + d[0] + 1, gm[i]);
+        }
+        else
+        {
+          ASSERT_EQ(0, gm[i]);
+        }
+      }
+    }
+  }
+
+  // Blocks of (3, 0) and (3, 1) are updated
+  for (size_t b = 0; b < gm.block_num(); ++b)
+  {
+    Vec block_min, block_max;
+    gm.blockRegion(b, block_min, block_max);
+    const bool updated = block_min[0] == 0x30 && (block_min[1] == 0x00 || block_min[1] == 0x10);
+    EXPECT_EQ(updated, gm.isBlockDirty(b)) << b;
+    EXPECT_EQ(block_min[0] + 0x10, block_max[0]);
+    EXPECT_EQ(block_min[1] + 0x10, block_max[1]);
+    EXPECT_EQ(0, block_min[2]);
+    EXPECT_EQ(4, block_max[2]);
+  }
+
+  std::vector<size_t> baddrs;
+  gm.regionBlocks(origin, origin + region, baddrs);
+  ASSERT_EQ(2u, baddrs.size());
+  for (const size_t b : baddrs)
+  {
+    EXPECT_TRUE(gm.isBlockDirty(b)) << b;
+  }
+  // Block (3, 0) is copied without changing the dirty flags
+  base.copyBlock(gm, baddrs[0]);
+  EXPECT_TRUE(gm.isBlockDirty(baddrs[0]));
+  EXPECT_EQ(gm[Vec(0x3A, 0x0F, 1)], base[Vec(0x3A, 0x0F, 1)]);
+  EXPECT_EQ(0, base[Vec(0x3A, 0x10, 1)]);
+  base.clear(0);
+
+  // Region partially outside of the map
+  gm.regionBlocks(Vec(-5, 0x1F, 0), Vec(0x11, 0x100, 4), baddrs);
+  EXPECT_EQ(4u, baddrs.size());
+
+  gm.copyDirtyBlocks(base);
+  for (size_t b = 0; b < gm.block_num(); ++b)
+  {
+    EXPECT_FALSE(gm.isBlockDirty(b));
+  }
+  for (i[0] = 0; i[0] < gm.size()[0]; ++i[0])
+  {
+    for (i[1] = 0; i[1] < gm.size()[1]; ++i[1])
+    {
+      for (i[2] = 0; i[2] < gm.size()[2]; ++i[2])
+      {
+        ASSERT_EQ(0, gm[i]);
+      }
+    }
+  }
+}
+
+TEST(BlockmemGridmap, CopyRegion)
+{
+  using Vec = CyclicVecInt<3, 2>;
+  BlockMemGridmap<int, 3, 2, 0x10> gm(Vec(0x40, 0x30, 4));
+  BlockMemGridmap<int, 3, 2, 0x10> base(gm.size());
+  gm.clear(-1);
+  Vec i;
+  for (i[0] = 0; i[0] < gm.size()[0]; ++i[0])
+  {
+    for (i[1] = 0; i[1] < gm.size()[1]; ++i[1])
+    {
+      for (i[2] = 0; i[2] < gm.size()[2]; ++i[2])
+      {
+        base[i] = (i[0] * 0x100 + i[1]) * 0x10 + i[2];
+      }
+    }
+  }
+  const int* const data = gm.data();
+
+  // Region over the block boundaries and partially outside of the map
+  const Vec min(0x0C, -0x02, 0);
+  const Vec max(0x22, 0x13, 1);
+  gm.copyRegion(base, min, max);
+  EXPECT_EQ(data, gm.data());
+
+  for (i[0] = 0; i[0] < gm.size()[0]; ++i[0])
+  {
+    for (i[1] = 0; i[1] < gm.size()[1]; ++i[1])
+    {
+      for (i[2] = 0; i[2] < gm.size()[2]; ++i[2])
+      {
+        if (min[0] <= i[0] && i[0] < max[0] && min[1] <= i[1] && i[1] < max[1])
+        {
+          ASSERT_EQ(base[i], gm[i]);
+        }
+        else
+        {
+          ASSERT_EQ(-1, gm[i]);
+        }
+      }
+    }
+  }
+
+  gm.clearRegion(-1, min, max);
+  EXPECT_EQ(data, gm.data());
+  for (i[0] = 0; i[0] < gm.size()[0]; ++i[0])
+  {
+    for (i[1] = 0; i[1] < gm.size()[1]; ++i[1])
+    {
+      for (i[2] = 0; i[2] < gm.size()[2]; ++i[2])
+      {
+        ASSERT_EQ(-1, gm[i]);
+      }
+    }
+  }
+}
+
 TEST(BlockmemGridmap, OuterBoundary)
 {
   BlockMemGridmap<float, 3, 2, 0x20, true> gm;
@@ -151,6 +383,203 @@ TEST(BlockmemGridmap, OuterBoundary)
     }
   }
 }
+
+TEST(BlockmemGridmap, LazyBlockMemGridmap)
+{
+  using Vec = CyclicVecInt<3, 2>;
+  const Vec size(0x50, 0x30, 4);
+  LazyBlockMemGridmap<float, 3, 2, 0x10> gm(size);
+  BlockMemGridmap<float, 3, 2, 0x10> dense(size);
+  EXPECT_EQ(dense.ser_size(), gm.ser_size());
+  EXPECT_EQ(0u, gm.initialized_blocks());
+
+  gm.clear(1.0);
+  const LazyBlockMemGridmap<float, 3, 2, 0x10>& gm_const = gm;
+  EXPECT_EQ(1.0, gm_const[Vec(3, 4, 1)]);
+  EXPECT_EQ(0u, gm.initialized_blocks());
+
+  gm[Vec(3, 4, 1)] = 5.0;
+  gm[Vec(0x4F, 0x2F, 3)] = 6.0;
+  EXPECT_EQ(2u, gm.initialized_blocks());
+  EXPECT_EQ(5.0, gm[Vec(3, 4, 1)]);
+  EXPECT_EQ(6.0, gm[Vec(0x4F, 0x2F, 3)]);
+  EXPECT_EQ(1.0, gm[Vec(3, 4, 2)]);
+  EXPECT_EQ(1.0, gm[Vec(0x0F, 0x0F, 0)]);
+
+  // Addresses are same as BlockMemGridmap
+  size_t baddr, addr, baddr_dense, addr_dense;
+  gm.getAddressor()(Vec(0x23, 0x17, 2), baddr, addr);
+  dense.getAddressor()(Vec(0x23, 0x17, 2), baddr_dense, addr_dense);
+  EXPECT_EQ(baddr_dense, baddr);
+  EXPECT_EQ(addr_dense, addr);
+
+  gm.clear(2.0);
+  EXPECT_EQ(0u, gm.initialized_blocks());
+  EXPECT_EQ(2.0, gm_const[Vec(3, 4, 1)]);
+  EXPECT_EQ(2.0, gm[Vec(3, 4, 1)]);
+  EXPECT_EQ(1u, gm.initialized_blocks());
+  EXPECT_EQ(2.0, gm[Vec(0x4F, 0x2F, 3)]);
+
+  // Concurrent first access to the same block
+  gm.clear(3.0);
+#pragma omp parallel for
+  for (int x = 0; x < size[0]; ++x)
+  {
+    for (int y = 0; y < size[1]; ++y)
+      gm[Vec(x, y, 0)] += x;
+  }
+  Vec p(0, 0, 0);
+  for (p[0] = 0; p[0] < size[0]; ++p[0])
+  {
+    for (p[1] = 0; p[1] < size[1]; ++p[1])
+    {
+      ASSERT_EQ(3.0 + p[0], gm[p]);
+      ASSERT_EQ(3.0, gm[p + Vec(0, 0, 1)]);
+    }
+  }
+}
+
+TEST(BlockmemGridmap, QuantizedCostCodec)
+{
+  const QuantizedCostCodec<4> codec4;
+  const QuantizedCostCodec<8> codec8;
+  EXPECT_EQ(-1, codec4.decode(codec4.encode(-1)));
+  EXPECT_EQ(0, codec4.decode(codec4.encode(0)));
+  EXPECT_EQ(100, codec4.decode(codec4.encode(100)));
+  for (int c = -1; c <= 100; ++c)
+  {
+    const int c4 = codec4.decode(codec4.encode(c));
+    EXPECT_LT(codec4.encode(c), 16u);
+    EXPECT_GE(c4, c);
+    EXPECT_LT(c4, c + 8);
+    EXPECT_EQ(c, codec8.decode(codec8.encode(c)));
+  }
+}
+
+TEST(BlockmemGridmap, FixedPointCostCodec)
+{
+  FixedPointCostCodec<uint16_t> codec;
+  codec.setResolution(0.5);
+  EXPECT_EQ(1.5, codec.decode(codec.encode(1.2)));
+  EXPECT_EQ(2.0, codec.decode(codec.encode(2.0)));
+  EXPECT_EQ(-1, codec.decode(codec.encode(-1)));
+  EXPECT_EQ(std::numeric_limits<float>::max(), codec.decode(codec.encode(std::numeric_limits<float>::max())));
+  EXPECT_EQ(std::numeric_limits<float>::max(), codec.decode(codec.encode(0.5 * 65535)));
+  EXPECT_EQ(0.5 * 65533, codec.decode(codec.encode(0.5 * 65533)));
+}
+
+TEST(BlockmemGridmap, PackedBlockMemGridmap)
+{
+  using Vec = CyclicVecInt<3, 2>;
+  const Vec size(37, 21, 16);
+  const auto value = [](const Vec& p)
+  {
+    return static_cast<char>((p[0] * 7 + p[1] * 3 + p[2]) % 102 - 1);
+  };
+
+  BlockMemGridmap<char, 3, 2, 0x20> dense(size);
+  PackedBlockMemGridmap<QuantizedCostCodec<4>, 3, 2, 0x20> packed(size);
+  EXPECT_EQ(dense.ser_size(), packed.ser_size());
+  EXPECT_EQ(dense.ser_size() / 2, packed.bytes());
+
+  packed.clear(100);
+  Vec p;
+  for (p[0] = 0; p[0] < size[0]; ++p[0])
+    for (p[1] = 0; p[1] < size[1]; ++p[1])
+      for (p[2] = 0; p[2] < size[2]; ++p[2])
+        ASSERT_EQ(100, packed[p]);
+
+  for (p[0] = 0; p[0] < size[0]; ++p[0])
+    for (p[1] = 0; p[1] < size[1]; ++p[1])
+      for (p[2] = 0; p[2] < size[2]; ++p[2])
+        packed[p] = value(p);
+
+  const QuantizedCostCodec<4> codec;
+  for (p[0] = 0; p[0] < size[0]; ++p[0])
+    for (p[1] = 0; p[1] < size[1]; ++p[1])
+      for (p[2] = 0; p[2] < size[2]; ++p[2])
+        ASSERT_EQ(codec.decode(codec.encode(value(p))), packed[p]);
+
+  // Proxy object is used as the value
+  PackedBlockMemGridmap<FixedPointCostCodec<uint16_t>, 3, 2> g(size);
+  g.codec().setResolution(0.25);
+  g.clear(std::numeric_limits<float>::max());
+  const Vec s(3, 4, 5);
+  EXPECT_TRUE(g[s] > 100.0f);
+  g[s] = 10.1f;
+  g[s + Vec(0, 0, 1)] = g[s];
+  EXPECT_EQ(10.25f, g[s + Vec(0, 0, 1)]);
+  EXPECT_TRUE(g[s] < 11.0f);
+}
+
+TEST(BlockmemGridmap, AngleSparseGridmap)
+{
+  using Vec = CyclicVecInt<3, 2>;
+  const Vec size(45, 30, 16);
+
+  BlockMemGridmap<char, 3, 2, 0x40> dense(size);
+  dense.clear(0);
+  Vec p;
+  for (p[2] = 0; p[2] < size[2]; ++p[2])
+  {
+    dense[Vec(10, 10, p[2])] = 100;
+    dense[Vec(20, 15, p[2])] = p[2] * 5;
+    dense[Vec(44, 29, p[2])] = p[2] < 8 ? 100 : 50;
+  }
+
+  AngleSparseGridmap<char, 0x40> sparse;
+  sparse.assign(dense);
+  EXPECT_EQ(2u, sparse.numNonUniformCells());
+  EXPECT_LT(sparse.bytes(), dense.ser_size());
+  for (p[0] = 0; p[0] < size[0]; ++p[0])
+    for (p[1] = 0; p[1] < size[1]; ++p[1])
+      for (p[2] = 0; p[2] < size[2]; ++p[2])
+        ASSERT_EQ(dense[p], sparse[p]);
+
+  sparse[Vec(1, 2, 3)] = 30;
+  sparse[Vec(20, 15, 0)] = sparse[Vec(20, 15, 1)];
+  EXPECT_EQ(3u, sparse.numNonUniformCells());
+  EXPECT_EQ(30, sparse[Vec(1, 2, 3)]);
+  EXPECT_EQ(0, sparse[Vec(1, 2, 4)]);
+  EXPECT_EQ(5, sparse[Vec(20, 15, 0)]);
+
+  BlockMemGridmap<char, 3, 2, 0x40> restored(size);
+  restored.clear(-1);
+  sparse.copyTo(restored, Vec(0, 0, 0), Vec(15, 15, 0));
+  EXPECT_EQ(30, restored[Vec(1, 2, 3)]);
+  EXPECT_EQ(100, restored[Vec(10, 10, 7)]);
+  EXPECT_EQ(-1, restored[Vec(20, 15, 1)]);
+  sparse.copyTo(restored);
+  EXPECT_EQ(5, restored[Vec(20, 15, 1)]);
+
+  for (p[2] = 0; p[2] < size[2]; ++p[2])
+    sparse[Vec(44, 29, p[2])] = 0;
+  sparse[Vec(1, 2, 3)] = 0;
+  sparse.compact();
+  EXPECT_EQ(1u, sparse.numNonUniformCells());
+  EXPECT_EQ(0, sparse[Vec(44, 29, 3)]);
+  EXPECT_EQ(25, sparse[Vec(20, 15, 5)]);
+
+  AngleSparseGridmap<char, 0x40> lazy;
+  lazy.reset(size);
+  lazy.assign(dense, Vec(0, 0, 0), Vec(15, 15, 0));
+  lazy.assign(dense, Vec(15, 15, 0), Vec(64, 64, 0));
+  EXPECT_EQ(100, lazy[Vec(10, 10, 3)]);
+  EXPECT_EQ(0, lazy[Vec(20, 10, 3)]);
+  EXPECT_EQ(2u, lazy.numNonUniformCells());
+  for (p[2] = 0; p[2] < size[2]; ++p[2])
+  {
+    dense[Vec(20, 15, p[2])] = 7;
+    dense[Vec(44, 29, p[2])] = p[2];
+  }
+  lazy.assign(dense, Vec(15, 15, 0), Vec(64, 64, 0));
+  for (p[0] = 0; p[0] < size[0]; ++p[0])
+    for (p[1] = 0; p[1] < size[1]; ++p[1])
+      for (p[2] = 0; p[2] < size[2]; ++p[2])
+        ASSERT_EQ(dense[p], lazy[p]);
+  lazy.compact();
+  EXPECT_EQ(1u, lazy.numNonUniformCells());
+}
 }  // namespace planner_cspace
 
 int main(int argc, char** argv)
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/planner_3d/cluster_graph.h>
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+namespace
+{
+using Vec = ClusterGraph::Vec;
+using Vecf = ClusterGraph::Vecf;
+using Rough = ClusterGraph::Rough;
+
+constexpr int SIZE = 128;
+
+ClusterGraph::Params defaultParams()
+{
+  ClusterGraph::Params p;
+  p.euclid_cost = Vecf(1.0f, 1.0f, 1.0f);
+  p.weight_costmap = 10.0;
+  p.linear_resolution = 0.1;
+  return p;
+}
+
+// 8-connected Dijkstra on the whole map with the same step cost.
+float exactCost(const Rough& cm, const ClusterGraph::Params& params, const Vec& s, const Vec& e)
+{
+  std::vector<float> g(SIZE * SIZE, std::numeric_limits<float>::max());
+  using Entry = std::pair<float, int>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+  g[s[1] * SIZE + s[0]] = 0;
+  open.emplace(0, s[1] * SIZE + s[0]);
+  while (!open.empty())
+  {
+    const Entry center = open.top();
+    open.pop();
+    if (center.first > g[center.second])
+      continue;
+    const Vec p(center.second % SIZE, center.second / SIZE, 0);
+    for (Vec d(-1, -1, 0); d[0] <= 1; ++d[0])
+    {
+      for (d[1] = -1; d[1] <= 1; ++d[1])
+      {
+        const Vec next = p + d;
+        if ((d[0] == 0 && d[1] == 0) ||
+            static_cast<unsigned int>(next[0]) >= SIZE || static_cast<unsigned int>(next[1]) >= SIZE)
+          continue;
+        if (cm[p] > 99 || cm[next] > 99)
+          continue;
+        const float len = (d[0] != 0 && d[1] != 0) ? std::sqrt(2.0f) : 1.0f;
+        const float cost =
+            center.first + len * params.euclid_cost[0] +
+            params.linear_resolution * len / 100.0 * cm[p] * params.weight_costmap;
+        const int index = next[1] * SIZE + next[0];
+        if (g[index] > cost)
+        {
+          g[index] = cost;
+          open.emplace(cost, index);
+        }
+      }
+    }
+  }
+  return g[e[1] * SIZE + e[0]];
+}
+
+void setWall(Rough& cm, const int x, const int gap_y, const char c_gap)
+{
+  for (int y = 0; y < SIZE; ++y)
+    cm[Vec(x, y, 0)] = 100;
+  for (int y = gap_y; y < gap_y + 4; ++y)
+    cm[Vec(x, y, 0)] = c_gap;
+}
+}  // namespace
+
+TEST(ClusterGraph, PathCost)
+{
+  Rough cm;
+  cm.reset(Vec(SIZE, SIZE, 1));
+  cm.clear(0);
+  // Some costs around the center
+  for (int x = 40; x < 90; ++x)
+    for (int y = 40; y < 90; ++y)
+      cm[Vec(x, y, 0)] = 50;
+
+  const ClusterGraph::Params params = defaultParams();
+  ClusterGraph cg;
+  cg.reset(cm.size(), 16, params);
+  cg.update(cm, Vec(0, 0, 0), cm.size());
+  EXPECT_EQ(16, cg.clusterSize());
+  EXPECT_GT(cg.numNodes(), 0u);
+
+  const std::vector<std::pair<Vec, Vec>> queries =
+      {
+        {Vec(3, 5, 0), Vec(120, 110, 0)},
+        {Vec(120, 5, 0), Vec(10, 100, 0)},
+        {Vec(64, 64, 0), Vec(70, 66, 0)},
+        {Vec(20, 64, 0), Vec(110, 64, 0)},
+      };
+  for (const auto& q : queries)
+  {
+    ASSERT_TRUE(cg.updateCorridor(cm, q.first, q.second));
+    const float exact = exactCost(cm, params, q.first, q.second);
+    EXPECT_GE(cg.pathCost(), exact * 0.999);
+    EXPECT_LE(cg.pathCost(), exact * 1.3);
+    EXPECT_TRUE(cg.inCorridor(q.first));
+    EXPECT_TRUE(cg.inCorridor(q.second));
+    EXPECT_EQ(q.first, cg.path().front());
+    EXPECT_EQ(q.second, cg.path().back());
+  }
+}
+
+TEST(ClusterGraph, Update)
+{
+  Rough cm;
+  cm.reset(Vec(SIZE, SIZE, 1));
+  cm.clear(0);
+  setWall(cm, 70, 100, 0);
+
+  const ClusterGraph::Params params = defaultParams();
+  ClusterGraph cg;
+  cg.reset(cm.size(), 16, params);
+  cg.update(cm, Vec(0, 0, 0), cm.size());
+
+  const Vec s(10, 10, 0);
+  const Vec e(120, 10, 0);
+  ASSERT_TRUE(cg.updateCorridor(cm, s, e));
+  EXPECT_NEAR(exactCost(cm, params, s, e), cg.pathCost(), exactCost(cm, params, s, e) * 0.3);
+  // The corridor goes through the gap of the wall.
+  EXPECT_TRUE(cg.inCorridor(Vec(70, 101, 0)));
+  EXPECT_FALSE(cg.inCorridor(Vec(70, 10, 0)));
+
+  // Close the gap
+  setWall(cm, 70, 100, 100);
+  cg.update(cm, Vec(70, 100, 0), Vec(71, 104, 1));
+  EXPECT_FALSE(cg.updateCorridor(cm, s, e));
+
+  // Open another gap
+  setWall(cm, 70, 20, 0);
+  cg.update(cm, Vec(70, 20, 0), Vec(71, 24, 1));
+  ASSERT_TRUE(cg.updateCorridor(cm, s, e));
+  EXPECT_TRUE(cg.inCorridor(Vec(70, 21, 0)));
+  EXPECT_FALSE(cg.inCorridor(Vec(70, 101, 0)));
+
+  // Compare with the graph built from scratch
+  ClusterGraph cg2;
+  cg2.reset(cm.size(), 16, params);
+  cg2.update(cm, Vec(0, 0, 0), cm.size());
+  ASSERT_TRUE(cg2.updateCorridor(cm, s, e));
+  EXPECT_EQ(cg2.numNodes(), cg.numNodes());
+  EXPECT_FLOAT_EQ(cg2.pathCost(), cg.pathCost());
+}
+
+TEST(ClusterGraph, DistanceMapCorridor)
+{
+  using Astar = DistanceMap::Astar;
+  Rough cm;
+  cm.reset(Vec(SIZE, SIZE, 1));
+  cm.clear(0);
+  setWall(cm, 70, 100, 0);
+  CostmapBBF bbf;
+  bbf.reset(cm.size());
+  bbf.clear();
+
+  costmap_cspace_msgs::MapMetaData3D map_info;
+  map_info.width = SIZE;
+  map_info.height = SIZE;
+  map_info.angle = 16;
+  map_info.linear_resolution = 0.1;
+  map_info.angular_resolution = M_PI * 2 / 16;
+
+  DistanceMap::Params p;
+  p.euclid_cost = Vecf(1.0f, 1.0f, 1.0f);
+  p.range = 4;
+  p.local_range = 25;
+  p.longcut_range = 0;
+  p.weight_costmap = 10.0;
+  p.weight_remembered = 0.0;
+  p.num_cost_estim_task = 16;
+  p.delta_stepping_width = 0;
+  DistanceMap dm(cm, bbf);
+  dm.init(map_info, p);
+
+  ClusterGraph::Params cp;
+  cp.euclid_cost = p.euclid_cost;
+  cp.weight_costmap = p.weight_costmap;
+  cp.linear_resolution = map_info.linear_resolution;
+  ClusterGraph cg;
+  cg.reset(cm.size(), 16, cp);
+  cg.update(cm, Vec(0, 0, 0), cm.size());
+
+  const Vec s(10, 10, 0);
+  const Vec e(120, 10, 0);
+  ASSERT_TRUE(cg.updateCorridor(cm, s, e));
+
+  const auto fill = [&dm, &e, &s](DistanceMap::Gridmap& g, const ClusterGraph* corridor)
+  {
+    reservable_priority_queue<Astar::PriorityVec> open;
+    g.reset(Vec(SIZE, SIZE, 1));
+    g.clear(std::numeric_limits<float>::max());
+    g[e] = 0;
+    open.emplace(0, 0, e);
+    dm.fill(open, g, s, corridor);
+  };
+  DistanceMap::Gridmap g_full, g_corridor;
+  fill(g_full, nullptr);
+  fill(g_corridor, &cg);
+
+  ASSERT_NE(std::numeric_limits<float>::max(), g_corridor[s]);
+  EXPECT_NEAR(g_full[s], g_corridor[s], g_full[s] * 0.05);
+  // Cells far from the corridor are not calculated.
+  EXPECT_NE(std::numeric_limits<float>::max(), g_full[Vec(5, 120, 0)]);
+  EXPECT_EQ(std::numeric_limits<float>::max(), g_corridor[Vec(5, 120, 0)]);
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <omp.h>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+#include <planner_cspace/planner_3d/distance_map_worker.h>
+#include <planner_cspace/planner_3d/landmark_heuristic.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+namespace
+{
+using Astar = DistanceMap::Astar;
+using Vec = DistanceMap::Vec;
+}  // namespace
+
+class DistanceMapTest : public ::testing::Test
+{
+protected:
+  const int w_ = 96;
+  const int h_ = 64;
+  const Vec s_ = Vec(90, 60, 0);
+  const Vec e_ = Vec(5, 5, 0);
+  DistanceMap::Rough cm_;
+  CostmapBBF bbf_;
+  costmap_cspace_msgs::MapMetaData3D map_info_;
+  DistanceMap::Params p_;
+  std::mt19937 rnd_;
+
+  DistanceMapTest()
+    : rnd_(1)
+  {
+    cm_.reset(Vec(w_, h_, 1));
+    for (Vec p(0, 0, 0); p[1] < h_; ++p[1])
+    {
+      for (p[0] = 0; p[0] < w_; ++p[0])
+        cm_[p] = randomCost();
+    }
+    cm_[s_] = 0;
+    cm_[e_] = 0;
+    bbf_.reset(cm_.size());
+    bbf_.clear();
+
+    map_info_.width = w_;
+    map_info_.height = h_;
+    map_info_.angle = 16;
+    map_info_.linear_resolution = 0.1;
+    map_info_.angular_resolution = M_PI * 2 / 16;
+
+    p_.euclid_cost = Astar::Vecf(1.0f, 1.0f, 1.0f);
+    p_.range = 4;
+    p_.local_range = 25;
+    p_.longcut_range = 0;
+    p_.weight_costmap = 10.0;
+    p_.weight_remembered = 0.0;
+    p_.num_cost_estim_task = 16;
+    p_.delta_stepping_width = 0;
+  }
+
+  char randomCost()
+  {
+    const int c = std::uniform_int_distribution<int>(0, 120)(rnd_);
+    return c > 100 ? (c > 110 ? 100 : 0) : c / 2;
+  }
+
+  void fill(
+      const DistanceMap& dm, reservable_priority_queue<Astar::PriorityVec>& open, DistanceMap::Gridmap& g)
+  {
+    g.reset(cm_.size());
+    g.clear(std::numeric_limits<float>::max());
+    g[e_] = -0.5;
+    open.clear();
+    open.emplace(g[e_], g[e_], e_);
+    dm.fill(open, g, s_);
+  }
+
+  // Compares the grids determined before the start.
+  void expectSameCosts(const DistanceMap::Gridmap& expected, const DistanceMap::Gridmap& g)
+  {
+    ASSERT_NE(std::numeric_limits<float>::max(), expected[s_]);
+    for (Vec q(0, 0, 0); q[1] < h_; ++q[1])
+    {
+      for (q[0] = 0; q[0] < w_; ++q[0])
+      {
+        if (expected[q] > expected[s_])
+          continue;
+        ASSERT_NEAR(expected[q], g[q], 1e-3) << "pos: " << q[0] << "," << q[1];
+      }
+    }
+  }
+};
+
+TEST_F(DistanceMapTest, DeltaStepping)
+{
+  DistanceMap::Gridmap expected;
+  reservable_priority_queue<Astar::PriorityVec> open;
+  {
+    DistanceMap dm(cm_, bbf_);
+    dm.init(map_info_, p_);
+    fill(dm, open, expected);
+  }
+
+  for (const int num_threads : {1, 3})
+  {
+    omp_set_num_threads(num_threads);
+    for (const float width : {0.5f, 2.0f, 10.0f})
+    {
+      SCOPED_TRACE("threads: " + std::to_string(num_threads) + ", width: " + std::to_string(width));
+      p_.delta_stepping_width = width;
+      DistanceMap dm(cm_, bbf_);
+      dm.init(map_info_, p_);
+      DistanceMap::Gridmap g;
+      fill(dm, open, g);
+      expectSameCosts(expected, g);
+    }
+  }
+  omp_set_num_threads(1);
+}
+
+TEST_F(DistanceMapTest, Update)
+{
+  for (const float width : {0.0f, 2.0f})
+  {
+    p_.delta_stepping_width = width;
+    DistanceMap dm(cm_, bbf_);
+    dm.init(map_info_, p_);
+
+    reservable_priority_queue<Astar::PriorityVec> open, open_expected;
+    DistanceMap::Gridmap g, expected;
+    fill(dm, open, g);
+
+    for (int i = 0; i < 20; ++i)
+    {
+      SCOPED_TRACE("width: " + std::to_string(width) + ", update: " + std::to_string(i));
+      // Change the costs in the random rectangle
+      const Vec min(
+          std::uniform_int_distribution<int>(0, w_ - 8)(rnd_),
+          std::uniform_int_distribution<int>(0, h_ - 8)(rnd_), 0);
+      const Vec max = min + Vec(
+          std::uniform_int_distribution<int>(1, 8)(rnd_),
+          std::uniform_int_distribution<int>(1, 8)(rnd_), 1);
+      for (Vec p = min; p[1] < max[1]; ++p[1])
+      {
+        for (p[0] = min[0]; p[0] < max[0]; ++p[0])
+        {
+          if (p == s_ || p == e_)
+            continue;
+          cm_[p] = randomCost();
+        }
+      }
+
+      dm.update(open, g, s_, e_, min, max);
+      fill(dm, open_expected, expected);
+      expectSameCosts(expected, g);
+      if (HasFatalFailure())
+        return;
+    }
+  }
+}
+
+TEST_F(DistanceMapTest, LandmarkHeuristic)
+{
+  const Vec goals[] = {e_, s_, Vec(48, 32, 0)};
+  for (const Vec& e : goals)
+    cm_[e] = 0;
+
+  LandmarkHeuristic lh;
+  lh.build(cm_, map_info_, p_, 4);
+  ASSERT_EQ(4u, lh.landmarks().size());
+  EXPECT_EQ(w_ * h_ * 4 * sizeof(uint16_t), lh.bytes());
+
+  // Costmap updates only increase the costs.
+  for (int i = 0; i < 200; ++i)
+  {
+    const Vec p(
+        std::uniform_int_distribution<int>(0, w_ - 1)(rnd_),
+        std::uniform_int_distribution<int>(0, h_ - 1)(rnd_), 0);
+    if (p == goals[0] || p == goals[1] || p == goals[2])
+      continue;
+    cm_[p] = std::min(100, cm_[p] + 50);
+  }
+
+  DistanceMap dm(cm_, bbf_);
+  dm.init(map_info_, p_);
+  for (const Vec& e : goals)
+  {
+    DistanceMap::Gridmap g;
+    reservable_priority_queue<Astar::PriorityVec> open;
+    g.reset(cm_.size());
+    g.clear(std::numeric_limits<float>::max());
+    g[e] = 0;
+    open.emplace(g[e], g[e], e);
+    // Start out of the map fills the whole map.
+    dm.fill(open, g, Vec(-1, -1, 0));
+    EXPECT_EQ(0u, open.size());
+
+    DistanceMap::Gridmap h;
+    h.reset(cm_.size());
+    lh.fill(e, h);
+    int num_informative = 0;
+    int num_reachable = 0;
+    for (Vec q(0, 0, 0); q[1] < h_; ++q[1])
+    {
+      for (q[0] = 0; q[0] < w_; ++q[0])
+      {
+        ASSERT_EQ(lh.estimate(q, e), h[q]);
+        if (g[q] == std::numeric_limits<float>::max())
+          continue;
+        ASSERT_LE(h[q], g[q] + 1e-3) << "pos: " << q[0] << "," << q[1];
+        ++num_reachable;
+        if (h[q] > g[q] * 0.5)
+          ++num_informative;
+      }
+    }
+    EXPECT_GT(num_informative, num_reachable / 2);
+  }
+}
+
+TEST_F(DistanceMapTest, Worker)
+{
+  DistanceMap::Gridmap expected;
+  reservable_priority_queue<Astar::PriorityVec> open_expected;
+  {
+    DistanceMap dm(cm_, bbf_);
+    dm.init(map_info_, p_);
+    fill(dm, open_expected, expected);
+  }
+
+  DistanceMapWorker worker;
+  worker.init(map_info_, p_);
+  worker.start(cm_, bbf_, s_, e_, -0.5);
+  // Costmap is copied on start.
+  cm_.clear(100);
+
+  DistanceMap::Gridmap g;
+  reservable_priority_queue<Astar::PriorityVec> open;
+  worker.get(g, open);
+  EXPECT_TRUE(worker.done());
+  expectSameCosts(expected, g);
+  EXPECT_EQ(open_expected.size(), open.size());
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
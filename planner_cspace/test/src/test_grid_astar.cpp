@@ -27,8 +27,11 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cstdlib>
+#include <limits>
 #include <list>
-#include <unordered_map>
+#include <memory>
+#include <random>
 #include <vector>
 
 #include <boost/thread.hpp>
@@ -75,7 +78,7 @@ TEST(GridAstar, ParallelSearch)
     {
       return 1.0;
     }
-    float costEstim(const Vec& s, const Vec& e) const final
+    float costEstim(const Vec&, const Vec&) const final
     {
       return 0.0;
     }
@@ -108,6 +111,183 @@ TEST(GridAstar, ParallelSearch)
   }
 }
 
+TEST(GridAstar, DistributedSearch)
+{
+  using Vec = CyclicVecInt<1, 1>;
+  GridAstar<1, 1> as(Vec(16));
+  as.setSearchTaskNum(8);
+  as.enableDistributedSearch(true);
+
+  class Model : public GridAstarModelBase<1, 1>
+  {
+  private:
+    std::vector<std::vector<Vec>> search_;
+
+  public:
+    Model()
+      : search_(16)
+    {
+      // 0: connected to 1-14
+      // 1-14: connected to 1-15
+      for (int i = 1; i <= 14; ++i)
+      {
+        search_[0].push_back(Vec(i));
+        for (int j = 1; j <= 15; ++j)
+        {
+          if (i == j)
+            continue;
+          search_[i].push_back(Vec(j - i));
+        }
+      }
+    }
+    float cost(const Vec&, const Vec&, const std::vector<VecWithCost>&, const Vec&) const final
+    {
+      return 1.0;
+    }
+    float costEstim(const Vec&, const Vec&) const final
+    {
+      return 0.0;
+    }
+    const std::vector<Vec>& searchGrids(const Vec& p, const std::vector<VecWithCost>&, const Vec&) const final
+    {
+      return search_[p[0]];
+    }
+  };
+  Model::Ptr model(new Model());
+
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+
+  for (int num_threads = 1; num_threads <= 4; ++num_threads)
+  {
+    omp_set_num_threads(num_threads);
+    for (int i = 0; i < 100; ++i)
+    {
+      std::list<Vec> path;
+      std::vector<Model::VecWithCost> starts;
+      starts.emplace_back(Vec(0));
+      ASSERT_TRUE(
+          as.search(
+              starts, Vec(15), path,
+              model, cb_progress,
+              0, 1.0))
+          << "num_threads: " << num_threads;
+
+      ASSERT_EQ(path.size(), 3u);
+      ASSERT_EQ(path.front(), Vec(0));
+      ASSERT_EQ(path.back(), Vec(15));
+    }
+  }
+}
+
+TEST(GridAstar, DistributedSearchOptimal)
+{
+  using Vec = CyclicVecInt<2, 2>;
+  constexpr int size = 48;
+
+  class Model : public GridAstarModelBase<2, 2>
+  {
+  private:
+    std::vector<Vec> search_;
+
+  public:
+    std::vector<char> map_;
+
+    explicit Model(const unsigned int seed)
+      : map_(size * size, 0)
+    {
+      std::mt19937 engine(seed);
+      std::uniform_int_distribution<int> cost_dist(0, 50);
+      std::uniform_int_distribution<int> pos_dist(0, size - 1);
+      for (char& c : map_)
+        c = cost_dist(engine);
+      // Walls with random gaps
+      for (int x = 8; x < size - 8; x += 8)
+      {
+        const int gap = pos_dist(engine);
+        for (int y = 0; y < size; ++y)
+        {
+          if (std::abs(y - gap) > 1)
+            map_[x + y * size] = 100;
+        }
+      }
+
+      Vec d;
+      for (d[0] = -2; d[0] <= 2; ++d[0])
+      {
+        for (d[1] = -2; d[1] <= 2; ++d[1])
+        {
+          if (d[0] != 0 || d[1] != 0)
+            search_.push_back(d);
+        }
+      }
+    }
+    float cost(const Vec& cur, const Vec& next, const std::vector<VecWithCost>&, const Vec&) const final
+    {
+      const char c = map_[next[0] + next[1] * size];
+      if (c > 99)
+        return -1;
+      return (next - cur).len() * (1.0 + c / 10.0);
+    }
+    float costEstim(const Vec& s, const Vec& e) const final
+    {
+      return (e - s).len();
+    }
+    const std::vector<Vec>& searchGrids(const Vec&, const std::vector<VecWithCost>&, const Vec&) const final
+    {
+      return search_;
+    }
+  };
+
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+
+  std::vector<GridAstar<2, 2>::VecWithCost> starts;
+  starts.emplace_back(Vec(2, size / 2));
+  const Vec goal(size - 3, size / 3);
+
+  for (unsigned int seed = 0; seed < 8; ++seed)
+  {
+    std::shared_ptr<Model> model(new Model(seed));
+    const auto path_cost = [&model](const std::list<Vec>& path)
+    {
+      float cost = 0;
+      for (auto it = std::next(path.cbegin()); it != path.cend(); ++it)
+        cost += model->cost(*std::prev(it), *it, {}, Vec());
+      return cost;
+    };
+
+    GridAstar<2, 2> as_ref(Vec(size, size));
+    as_ref.setSearchTaskNum(1);
+    omp_set_num_threads(1);
+    std::list<Vec> path_ref;
+    ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+    const float cost_ref = path_cost(path_ref);
+
+    GridAstar<2, 2> as(Vec(size, size));
+    as.setSearchTaskNum(8);
+    as.enableDistributedSearch(true);
+    for (int num_threads = 2; num_threads <= 4; ++num_threads)
+    {
+      omp_set_num_threads(num_threads);
+      for (int i = 0; i < 10; ++i)
+      {
+        std::list<Vec> path;
+        ASSERT_TRUE(as.search(starts, goal, path, model, cb_progress, 0, 100.0))
+            << "seed: " << seed << ", num_threads: " << num_threads;
+        EXPECT_EQ(starts[0].v_, path.front());
+        EXPECT_EQ(goal, path.back());
+        ASSERT_NEAR(cost_ref, path_cost(path), 1e-3)
+            << "seed: " << seed << ", num_threads: " << num_threads;
+      }
+    }
+  }
+}
+
 TEST(GridAstar, SearchWithMultipleStarts)
 {
   using Vec = CyclicVecInt<1, 1>;
@@ -143,7 +323,7 @@ TEST(GridAstar, SearchWithMultipleStarts)
     {
       return 1.0;
     }
-    float costEstim(const Vec& s, const Vec& e) const final
+    float costEstim(const Vec&, const Vec&) const final
     {
       return 0.0;
     }
@@ -182,6 +362,482 @@ TEST(GridAstar, SearchWithMultipleStarts)
   }
 }
 
+TEST(GridAstar, AnytimeSearch)
+{
+  using Vec = CyclicVecInt<2, 2>;
+  constexpr int size = 32;
+
+  class Model : public GridAstarModelBase<2, 2>
+  {
+  private:
+    std::vector<Vec> search_;
+
+  public:
+    Model()
+    {
+      Vec d;
+      for (d[0] = -1; d[0] <= 1; ++d[0])
+      {
+        for (d[1] = -1; d[1] <= 1; ++d[1])
+        {
+          if (d[0] != 0 || d[1] != 0)
+            search_.push_back(d);
+        }
+      }
+    }
+    float cost(const Vec& cur, const Vec& next, const std::vector<VecWithCost>&, const Vec&) const final
+    {
+      // Wall with a gap and a costly area to make the inflated heuristic misleading
+      if (next[0] == size / 2 && next[1] < size - 4)
+        return -1;
+      const float c = (next[1] < size / 2) ? 4.0 : 1.0;
+      return (next - cur).len() * c;
+    }
+    float costEstim(const Vec& s, const Vec& e) const final
+    {
+      return (e - s).len();
+    }
+    const std::vector<Vec>& searchGrids(const Vec&, const std::vector<VecWithCost>&, const Vec&) const final
+    {
+      return search_;
+    }
+  };
+  Model::Ptr model(new Model());
+
+  const auto path_cost = [&model](const std::list<Vec>& path)
+  {
+    float cost = 0;
+    for (auto it = std::next(path.cbegin()); it != path.cend(); ++it)
+      cost += model->cost(*std::prev(it), *it, {}, Vec());
+    return cost;
+  };
+
+  std::vector<GridAstar<2, 2>::VecWithCost> starts;
+  starts.emplace_back(Vec(2, 2));
+  const Vec goal(size - 3, 2);
+
+  GridAstar<2, 2> as(Vec(size, size));
+  as.setSearchTaskNum(1);
+  omp_set_num_threads(1);
+
+  std::list<Vec> path_optimal;
+  ASSERT_TRUE(
+      as.search(
+          starts, goal, path_optimal, model,
+          [](const std::list<Vec>&)
+          {
+            return true;
+          },
+          0, 100.0));
+
+  std::vector<float> costs;
+  const auto cb_improved = [&costs, &path_cost](const std::list<Vec>& path)
+  {
+    costs.push_back(path_cost(path));
+    return true;
+  };
+  std::list<Vec> path;
+  ASSERT_TRUE(as.searchAnytime(starts, goal, path, model, cb_improved, 0, 3.0, 0.5, 100.0));
+  ASSERT_GE(costs.size(), 1u);
+  for (size_t i = 1; i < costs.size(); ++i)
+  {
+    EXPECT_LT(costs[i], costs[i - 1]);
+  }
+  EXPECT_EQ(path.front(), starts[0].v_);
+  EXPECT_EQ(path.back(), goal);
+  // Final solution with epsilon=1.0 must be optimal
+  EXPECT_NEAR(path_cost(path_optimal), path_cost(path), 1e-3);
+  EXPECT_NEAR(costs.back(), path_cost(path), 1e-3);
+  EXPECT_FALSE(as.getSearchStats().budget_exceeded_);
+
+  // Interrupted by the time limit before the first solution
+  path.clear();
+  costs.clear();
+  ASSERT_FALSE(as.searchAnytime(starts, goal, path, model, cb_improved, 0, 3.0, 0.5, 0.0, true));
+  ASSERT_EQ(costs.size(), 0u);
+  // Goal is not proven to be unreachable
+  EXPECT_TRUE(as.getSearchStats().budget_exceeded_);
+  ASSERT_GE(path.size(), 1u);
+  EXPECT_EQ(path.front(), starts[0].v_);
+}
+
+namespace
+{
+template <class T>
+using DaryHeap4 = dary_heap<T, 4>;
+template <class T>
+using BucketQueue = bucket_queue<T, 16>;
+template <class T>
+using TwoLevelBucketQueue = two_level_bucket_queue<T, 1>;
+
+class OpenListTestModel : public GridAstarModelBase<2, 2>
+{
+public:
+  using Vec = CyclicVecInt<2, 2>;
+  static constexpr int SIZE = 32;
+
+  std::vector<char> map_;
+  std::vector<Vec> search_;
+
+  OpenListTestModel()
+    : map_(SIZE * SIZE, 0)
+  {
+    // Wall with a gap and a costly area
+    for (int y = 0; y < SIZE - 4; ++y)
+      map_[SIZE / 2 + y * SIZE] = 100;
+    for (int y = 0; y < SIZE; ++y)
+      for (int x = 4; x < 10; ++x)
+        map_[x + y * SIZE] = (x * 7 + y * 3) % 50;
+
+    Vec d;
+    for (d[0] = -1; d[0] <= 1; ++d[0])
+    {
+      for (d[1] = -1; d[1] <= 1; ++d[1])
+      {
+        if (d[0] != 0 || d[1] != 0)
+          search_.push_back(d);
+      }
+    }
+  }
+  float cost(const Vec& cur, const Vec& next, const std::vector<VecWithCost>&, const Vec&) const final
+  {
+    const char c = map_[next[0] + next[1] * SIZE];
+    if (c > 99)
+      return -1;
+    return (next - cur).len() * (1.0 + c / 10.0);
+  }
+  float costEstim(const Vec& s, const Vec& e) const final
+  {
+    return (e - s).len();
+  }
+  const std::vector<Vec>& searchGrids(const Vec&, const std::vector<VecWithCost>&, const Vec&) const final
+  {
+    return search_;
+  }
+  float pathCost(const std::list<Vec>& path) const
+  {
+    float cost = 0;
+    for (auto it = std::next(path.cbegin()); it != path.cend(); ++it)
+      cost += this->cost(*std::prev(it), *it, {}, Vec());
+    return cost;
+  }
+};
+
+template <template <class> class OPEN_LIST>
+float searchWithOpenList(const std::shared_ptr<OpenListTestModel>& model, const size_t queue_size_limit)
+{
+  using Vec = OpenListTestModel::Vec;
+  using Astar = GridAstar<2, 2, OPEN_LIST>;
+  const int size = OpenListTestModel::SIZE;
+
+  std::vector<typename Astar::VecWithCost> starts;
+  starts.emplace_back(Vec(2, 2));
+  const Vec goal(size - 3, 2);
+
+  Astar as(Vec(size, size));
+  as.setQueueSizeLimit(queue_size_limit);
+  omp_set_num_threads(1);
+
+  std::list<Vec> path;
+  const bool found = as.search(
+      starts, goal, path, model,
+      [](const std::list<Vec>&)
+      {
+        return true;
+      },
+      0, 100.0);
+  EXPECT_TRUE(found);
+  if (!found)
+    return -1;
+  EXPECT_EQ(path.front(), starts[0].v_);
+  EXPECT_EQ(path.back(), goal);
+  return model->pathCost(path);
+}
+}  // namespace
+
+TEST(GridAstar, OpenLists)
+{
+  const std::shared_ptr<OpenListTestModel> model(new OpenListTestModel());
+  const float cost_ref = searchWithOpenList<reservable_priority_queue>(model, 0);
+
+  EXPECT_NEAR(cost_ref, searchWithOpenList<DaryHeap4>(model, 0), 1e-3);
+  EXPECT_NEAR(cost_ref, searchWithOpenList<min_max_heap>(model, 0), 1e-3);
+  EXPECT_NEAR(cost_ref, searchWithOpenList<TwoLevelBucketQueue>(model, 0), 1e-3);
+  // Dial's queue pops the nodes in the order of the quantized priority
+  EXPECT_NEAR(cost_ref, searchWithOpenList<BucketQueue>(model, 0), 1.0 / 16);
+
+  // Bounded queues evicting the worst nodes give better path than
+  // the default queue dropping arbitrary nodes
+  const float cost_bounded_ref = searchWithOpenList<reservable_priority_queue>(model, 32);
+  EXPECT_LT(searchWithOpenList<min_max_heap>(model, 32), cost_bounded_ref);
+  EXPECT_LT(searchWithOpenList<TwoLevelBucketQueue>(model, 32), cost_bounded_ref);
+  EXPECT_NEAR(cost_ref, searchWithOpenList<min_max_heap>(model, 48), 1e-3);
+  EXPECT_NEAR(cost_ref, searchWithOpenList<TwoLevelBucketQueue>(model, 48), 1e-3);
+}
+
+TEST(GridAstar, LazySearchGridmap)
+{
+  using Vec = OpenListTestModel::Vec;
+  const int size = OpenListTestModel::SIZE;
+  const std::shared_ptr<OpenListTestModel> model(new OpenListTestModel());
+  const auto cb = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+
+  std::vector<GridAstar<2, 2>::VecWithCost> starts;
+  starts.emplace_back(Vec(2, 2));
+  const Vec goal(size - 3, 2);
+
+  omp_set_num_threads(2);
+  GridAstar<2, 2> as_dense(Vec(size, size));
+  GridAstar<2, 2, reservable_priority_queue, true> as_lazy(Vec(size, size));
+  std::list<Vec> path_dense, path_lazy;
+
+  ASSERT_TRUE(as_dense.search(starts, goal, path_dense, model, cb, 0, 100.0));
+  // Searched twice to check that the cost map is cleared
+  for (int i = 0; i < 2; ++i)
+  {
+    path_lazy.clear();
+    ASSERT_TRUE(as_lazy.search(starts, goal, path_lazy, model, cb, 0, 100.0));
+    EXPECT_NEAR(model->pathCost(path_dense), model->pathCost(path_lazy), 1e-3);
+  }
+
+  as_dense.enableDistributedSearch(true);
+  as_lazy.enableDistributedSearch(true);
+  ASSERT_TRUE(as_dense.search(starts, goal, path_dense, model, cb, 0, 100.0));
+  ASSERT_TRUE(as_lazy.search(starts, goal, path_lazy, model, cb, 0, 100.0));
+  EXPECT_NEAR(model->pathCost(path_dense), model->pathCost(path_lazy), 1e-3);
+
+  ASSERT_TRUE(as_dense.searchAnytime(starts, goal, path_dense, model, cb, 0, 2.0, 0.5, 100.0));
+  ASSERT_TRUE(as_lazy.searchAnytime(starts, goal, path_lazy, model, cb, 0, 2.0, 0.5, 100.0));
+  EXPECT_NEAR(model->pathCost(path_dense), model->pathCost(path_lazy), 1e-3);
+
+  ASSERT_TRUE(as_dense.searchIncremental(starts, goal, path_dense, model, 0));
+  ASSERT_TRUE(as_lazy.searchIncremental(starts, goal, path_lazy, model, 0));
+  EXPECT_NEAR(model->pathCost(path_dense), model->pathCost(path_lazy), 1e-3);
+}
+
+TEST(GridAstar, SearchBudget)
+{
+  using Vec = OpenListTestModel::Vec;
+  const int size = OpenListTestModel::SIZE;
+  const std::shared_ptr<OpenListTestModel> model(new OpenListTestModel());
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+
+  std::vector<GridAstar<2, 2>::VecWithCost> starts;
+  starts.emplace_back(Vec(2, 2));
+  const Vec goal(size - 3, 2);
+
+  GridAstar<2, 2> as(Vec(size, size));
+  omp_set_num_threads(1);
+
+  std::list<Vec> path_ref;
+  ASSERT_TRUE(as.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+  const size_t expansions_ref = as.getSearchStats().expansions_;
+  EXPECT_GT(expansions_ref, 32u);
+  EXPECT_FALSE(as.getSearchStats().budget_exceeded_);
+
+  as.setSearchBudget(0, 32);
+  std::list<Vec> path;
+  ASSERT_FALSE(as.search(starts, goal, path, model, cb_progress, 0, 100.0, true));
+  EXPECT_TRUE(as.getSearchStats().budget_exceeded_);
+  EXPECT_GE(as.getSearchStats().expansions_, 32u);
+  EXPECT_LT(as.getSearchStats().expansions_, expansions_ref);
+  ASSERT_GE(path.size(), 1u);
+  EXPECT_EQ(starts[0].v_, path.front());
+
+  as.enableDistributedSearch(true);
+  path.clear();
+  EXPECT_FALSE(as.search(starts, goal, path, model, cb_progress, 0, 100.0));
+  EXPECT_TRUE(as.getSearchStats().budget_exceeded_);
+  as.enableDistributedSearch(false);
+
+  EXPECT_FALSE(as.searchAnytime(starts, goal, path, model, cb_progress, 0, 1.0, 0.5, 100.0));
+  EXPECT_TRUE(as.getSearchStats().budget_exceeded_);
+
+  // Interrupted incremental search is resumed by the next call
+  EXPECT_FALSE(as.searchIncremental(starts, goal, path, model, 0));
+  EXPECT_TRUE(as.getSearchStats().budget_exceeded_);
+  as.setSearchBudget(0, 0);
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  EXPECT_FALSE(as.getSearchStats().budget_exceeded_);
+  EXPECT_NEAR(model->pathCost(path_ref), model->pathCost(path), 1e-3);
+}
+
+TEST(GridAstar, IncrementalSearch)
+{
+  using Vec = CyclicVecInt<2, 2>;
+  constexpr int size = 32;
+
+  class Model : public GridAstarModelBase<2, 2>
+  {
+  private:
+    std::vector<Vec> search_;
+
+  public:
+    std::vector<char> map_;
+    mutable size_t num_cost_;
+
+    Model()
+      : map_(size * size, 0)
+      , num_cost_(0)
+    {
+      // Wall with a gap
+      for (int y = 0; y < size - 4; ++y)
+        map_[size / 2 + y * size] = 100;
+
+      Vec d;
+      for (d[0] = -1; d[0] <= 1; ++d[0])
+      {
+        for (d[1] = -1; d[1] <= 1; ++d[1])
+        {
+          if (d[0] != 0 || d[1] != 0)
+            search_.push_back(d);
+        }
+      }
+    }
+    float cost(const Vec& cur, const Vec& next, const std::vector<VecWithCost>&, const Vec&) const final
+    {
+      ++num_cost_;
+      const char c = map_[next[0] + next[1] * size];
+      if (c > 99)
+        return -1;
+      return (next - cur).len() * (1.0 + c / 10.0);
+    }
+    float costEstim(const Vec& s, const Vec& e) const final
+    {
+      return (e - s).len();
+    }
+    const std::vector<Vec>& searchGrids(const Vec&, const std::vector<VecWithCost>&, const Vec&) const final
+    {
+      return search_;
+    }
+  };
+  std::shared_ptr<Model> model(new Model());
+
+  const auto path_cost = [&model](const std::list<Vec>& path)
+  {
+    float cost = 0;
+    for (auto it = std::next(path.cbegin()); it != path.cend(); ++it)
+      cost += model->cost(*std::prev(it), *it, {}, Vec());
+    return cost;
+  };
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+
+  std::vector<GridAstar<2, 2>::VecWithCost> starts;
+  starts.emplace_back(Vec(2, 16));
+  const Vec goal(size - 3, 16);
+
+  GridAstar<2, 2> as(Vec(size, size));
+  GridAstar<2, 2> as_ref(Vec(size, size));
+  omp_set_num_threads(1);
+
+  std::list<Vec> path;
+  std::list<Vec> path_ref;
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+  EXPECT_EQ(path.front(), starts[0].v_);
+  EXPECT_EQ(path.back(), goal);
+  EXPECT_NEAR(path_cost(path_ref), path_cost(path), 1e-3);
+
+  // Put an obstacle and a costly area near the goal
+  for (int y = 12; y < 22; ++y)
+  {
+    model->map_[(size - 6) + y * size] = 100;
+    model->map_[(size - 7) + y * size] = 50;
+  }
+  as.updateIncremental(Vec(size - 8, 11), Vec(size - 4, 23));
+
+  model->num_cost_ = 0;
+  path.clear();
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  const size_t num_cost_incremental = model->num_cost_;
+  model->num_cost_ = 0;
+  path_ref.clear();
+  ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+  // Only the search tree around the changed area must be repaired
+  EXPECT_LT(num_cost_incremental, model->num_cost_ / 2);
+  EXPECT_EQ(path.front(), starts[0].v_);
+  EXPECT_EQ(path.back(), goal);
+  EXPECT_NEAR(path_cost(path_ref), path_cost(path), 1e-3);
+
+  // Remove a part of the obstacle
+  for (int y = 14; y < 18; ++y)
+    model->map_[(size - 6) + y * size] = 0;
+  as.updateIncremental(Vec(size - 7, 13), Vec(size - 5, 19));
+
+  path.clear();
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  path_ref.clear();
+  ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+  EXPECT_NEAR(path_cost(path_ref), path_cost(path), 1e-3);
+
+  // Search tree is reused if only the cost of the start is changed
+  starts[0].c_ = 0.5;
+  model->num_cost_ = 0;
+  path.clear();
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  EXPECT_EQ(0u, model->num_cost_);
+  EXPECT_NEAR(path_cost(path_ref), path_cost(path), 1e-3);
+
+  // Costs of the multiple starts are repaired
+  const auto total_cost = [&path_cost, &starts](const std::list<Vec>& path)
+  {
+    for (const auto& s : starts)
+    {
+      if (s.v_ == path.front())
+        return s.c_ + path_cost(path);
+    }
+    return std::numeric_limits<float>::max();
+  };
+  starts.emplace_back(Vec(2, 4), 0.0);
+  path.clear();
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  starts[0].c_ = 20.0;
+  path.clear();
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  path_ref.clear();
+  ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+  EXPECT_EQ(starts[1].v_, path.front());
+  EXPECT_NEAR(total_cost(path_ref), total_cost(path), 1e-3);
+  starts[0].c_ = 0.0;
+  starts[1].c_ = 20.0;
+  path.clear();
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  path_ref.clear();
+  ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+  EXPECT_EQ(starts[0].v_, path.front());
+  EXPECT_NEAR(total_cost(path_ref), total_cost(path), 1e-3);
+  starts.pop_back();
+  starts[0].c_ = 0.0;
+
+  // Enclose the goal
+  for (int y = 0; y < size; ++y)
+    model->map_[(size - 6) + y * size] = 100;
+  as.updateIncremental(Vec(size - 7, 0), Vec(size - 5, size));
+
+  path.clear();
+  ASSERT_FALSE(as.searchIncremental(starts, goal, path, model, 0));
+
+  // Search tree is reset if the start is changed
+  for (int y = 0; y < size; ++y)
+    model->map_[(size - 6) + y * size] = 0;
+  starts[0].v_ = Vec(3, 10);
+  path.clear();
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  path_ref.clear();
+  ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+  EXPECT_EQ(path.front(), starts[0].v_);
+  EXPECT_NEAR(path_cost(path_ref), path_cost(path), 1e-3);
+}
+
 class GridAstarTestWrapper : public GridAstar<1, 1>
 {
 public:
@@ -189,9 +845,9 @@ public:
     : GridAstar(size)
   {
   }
-  std::unordered_map<Vec, Vec, Vec>& parentMap()
+  void setParent(const Vec& child, const Vec& parent)
   {
-    return parents_;
+    parents_[child] = posToIndex(parent);
   }
   bool findPath(const std::vector<VecWithCost>& ss, const Vec& e, std::list<Vec>& path) const
   {
@@ -204,9 +860,9 @@ TEST(GridAstar, FindPathLooped)
   using Vec = GridAstarTestWrapper::Vec;
   GridAstarTestWrapper as(Vec(4));
 
-  as.parentMap()[Vec(3)] = Vec(2);
-  as.parentMap()[Vec(2)] = Vec(1);
-  as.parentMap()[Vec(1)] = Vec(2);
+  as.setParent(Vec(3), Vec(2));
+  as.setParent(Vec(2), Vec(1));
+  as.setParent(Vec(1), Vec(2));
 
   std::list<Vec> path;
   const auto timeout_func = []()
@@ -234,7 +890,7 @@ TEST(GridAstar, FindPathUnconnected)
   using Vec = GridAstarTestWrapper::Vec;
   GridAstarTestWrapper as(Vec(3));
 
-  as.parentMap()[Vec(2)] = Vec(1);
+  as.setParent(Vec(2), Vec(1));
 
   std::list<Vec> path;
   std::vector<GridAstarTestWrapper::VecWithCost> starts;
@@ -247,8 +903,8 @@ TEST(GridAstar, FindPath)
   using Vec = GridAstarTestWrapper::Vec;
   GridAstarTestWrapper as(Vec(3));
 
-  as.parentMap()[Vec(2)] = Vec(1);
-  as.parentMap()[Vec(1)] = Vec(0);
+  as.setParent(Vec(2), Vec(1));
+  as.setParent(Vec(1), Vec(0));
 
   // findPath must return same result for multiple calls
   for (int i = 0; i < 2; ++i)
@@ -264,6 +920,15 @@ TEST(GridAstar, FindPath)
     ASSERT_EQ(*it, Vec(2));
   }
 }
+
+TEST(GridAstar, SizeSupported)
+{
+  using Astar = GridAstar<3, 2>;
+  EXPECT_TRUE(Astar::isSizeSupported(Astar::Vec(4000, 3000, 64)));
+  EXPECT_TRUE(Astar::isSizeSupported(Astar::Vec(0x10000, 0xFFFF, 1)));
+  EXPECT_FALSE(Astar::isSizeSupported(Astar::Vec(0x10000, 0x10000, 1)));
+  EXPECT_FALSE(Astar::isSizeSupported(Astar::Vec(0x8000, 0x8000, 16)));
+}
 }  // namespace planner_cspace
 
 int main(int argc, char** argv)
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstddef>
+#include <iomanip>
+#include <list>
+#include <random>
+#include <vector>
+
+#include <boost/chrono.hpp>
+
+#include <omp.h>
+
+#include <gtest/gtest.h>
+
+#include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/grid_astar.h>
+
+namespace planner_cspace
+{
+namespace
+{
+using Vec = CyclicVecInt<2, 2>;
+
+class GridModel : public GridAstarModelBase<2, 2>
+{
+private:
+  const BlockMemGridmap<char, 2, 2, 0x40>& cm_;
+  std::vector<Vec> search_;
+
+public:
+  explicit GridModel(const BlockMemGridmap<char, 2, 2, 0x40>& cm)
+    : cm_(cm)
+  {
+    Vec d;
+    for (d[0] = -1; d[0] <= 1; ++d[0])
+    {
+      for (d[1] = -1; d[1] <= 1; ++d[1])
+      {
+        if (d[0] == 0 && d[1] == 0)
+          continue;
+        search_.push_back(d);
+      }
+    }
+  }
+  float cost(const Vec& cur, const Vec& next, const std::vector<VecWithCost>&, const Vec&) const final
+  {
+    const char c = cm_[next];
+    if (c > 99)
+      return -1;
+    return (next - cur).len() * (1.0 + c / 10.0);
+  }
+  float costEstim(const Vec&, const Vec&) const final
+  {
+    // Dijkstra search to make the load heavy and independent from the map shape
+    return 0.0;
+  }
+  const std::vector<Vec>& searchGrids(const Vec&, const std::vector<VecWithCost>&, const Vec&) const final
+  {
+    return search_;
+  }
+};
+}  // namespace
+
+TEST(GridAstar, ParallelScalingPerformance)
+{
+  constexpr int size = 0x200;
+  constexpr int repeat = 4;
+  const int max_threads = std::max(16, omp_get_num_procs());
+
+  BlockMemGridmap<char, 2, 2, 0x40> cm;
+  cm.reset(Vec(size, size));
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> cost_dist(0, 99);
+  Vec p;
+  for (p[0] = 0; p[0] < size; ++p[0])
+  {
+    for (p[1] = 0; p[1] < size; ++p[1])
+    {
+      // Walls with gaps
+      if (p[0] % 0x40 == 0x20 && p[1] % 0x80 > 0x08)
+        cm[p] = 100;
+      else
+        cm[p] = cost_dist(engine) / 10;
+    }
+  }
+  GridModel::Ptr model(new GridModel(cm));
+
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+  std::vector<GridAstar<2, 2>::VecWithCost> starts;
+  starts.emplace_back(Vec(1, 1));
+  const Vec goal(size - 2, size - 2);
+
+  std::cout << std::setw(8) << "threads"
+            << std::setw(16) << "critical [s]"
+            << std::setw(16) << "distributed [s]" << std::endl;
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+  {
+    omp_set_num_threads(num_threads);
+
+    float durations[2];
+    for (int distributed = 0; distributed < 2; ++distributed)
+    {
+      GridAstar<2, 2> as(Vec(size, size));
+      as.setSearchTaskNum(num_threads * 16);
+      as.enableDistributedSearch(distributed);
+
+      const auto ts = boost::chrono::high_resolution_clock::now();
+      for (int r = 0; r < repeat; ++r)
+      {
+        std::list<Vec> path;
+        ASSERT_TRUE(as.search(starts, goal, path, model, cb_progress, 0, 100.0));
+        ASSERT_EQ(path.front(), starts[0].v_);
+        ASSERT_EQ(path.back(), goal);
+      }
+      const auto te = boost::chrono::high_resolution_clock::now();
+      durations[distributed] = boost::chrono::duration<float>(te - ts).count() / repeat;
+    }
+    std::cout << std::setw(8) << num_threads
+              << std::setw(16) << durations[0]
+              << std::setw(16) << durations[1] << std::endl;
+  }
+}
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
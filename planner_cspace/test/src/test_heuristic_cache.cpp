@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstddef>
+
+#include <planner_cspace/planner_3d/heuristic_cache.h>
+
+#include <gtest/gtest.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+using Vec = HeuristicCache::Vec;
+
+void fill(HeuristicCache::Gridmap& g, const float v)
+{
+  g.reset(Vec(16, 16, 1));
+  g.clear(v);
+}
+
+TEST(HeuristicCache, StoreLoad)
+{
+  HeuristicCache cache;
+  EXPECT_FALSE(cache.enabled());
+  cache.setMemoryLimit(1024 * 1024);
+  EXPECT_TRUE(cache.enabled());
+
+  HeuristicCache::Gridmap g;
+  HeuristicCache::OpenList open;
+  fill(g, 1.0);
+  open.push(GridAstar<3, 2>::PriorityVec(1.0, 1.0, Vec(2, 3, 0)));
+  cache.store(Vec(1, 2, 3), g, open);
+  EXPECT_EQ(1u, cache.size());
+
+  HeuristicCache::Gridmap g_loaded;
+  HeuristicCache::OpenList open_loaded;
+  bool dirty;
+  Vec dirty_min, dirty_max;
+  EXPECT_FALSE(cache.load(Vec(2, 2, 0), g_loaded, open_loaded, dirty, dirty_min, dirty_max));
+  // Angular element of the goal is ignored
+  ASSERT_TRUE(cache.load(Vec(1, 2, 0), g_loaded, open_loaded, dirty, dirty_min, dirty_max));
+  EXPECT_FALSE(dirty);
+  EXPECT_EQ(g.size(), g_loaded.size());
+  EXPECT_EQ(1.0, g_loaded[Vec(15, 15, 0)]);
+  ASSERT_EQ(1u, open_loaded.size());
+  EXPECT_EQ(Vec(2, 3, 0), open_loaded.top().v_);
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+
+  // Stored map must not be affected by the modification of the loaded one
+  g_loaded[Vec(0, 0, 0)] = 5.0;
+  ASSERT_TRUE(cache.load(Vec(1, 2, 0), g_loaded, open_loaded, dirty, dirty_min, dirty_max));
+  EXPECT_EQ(1.0, g_loaded[Vec(0, 0, 0)]);
+
+  // Same goal replaces the entry
+  fill(g, 2.0);
+  cache.store(Vec(1, 2, 0), g, open);
+  EXPECT_EQ(1u, cache.size());
+  ASSERT_TRUE(cache.load(Vec(1, 2, 0), g_loaded, open_loaded, dirty, dirty_min, dirty_max));
+  EXPECT_EQ(2.0, g_loaded[Vec(0, 0, 0)]);
+
+  cache.clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(0u, cache.bytes());
+}
+
+TEST(HeuristicCache, Evict)
+{
+  HeuristicCache::Gridmap g;
+  HeuristicCache::OpenList open;
+  bool dirty;
+  Vec dirty_min, dirty_max;
+  fill(g, 0.0);
+
+  const size_t bytes = g.ser_size() * sizeof(float);
+  HeuristicCache cache;
+  cache.setMemoryLimit(bytes * 2);
+  cache.store(Vec(0, 0, 0), g, open);
+  cache.store(Vec(1, 0, 0), g, open);
+  EXPECT_EQ(bytes * 2, cache.bytes());
+
+  // Touch the first one to make the second one least recently used
+  ASSERT_TRUE(cache.load(Vec(0, 0, 0), g, open, dirty, dirty_min, dirty_max));
+  cache.store(Vec(2, 0, 0), g, open);
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_EQ(bytes * 2, cache.bytes());
+  EXPECT_TRUE(cache.load(Vec(0, 0, 0), g, open, dirty, dirty_min, dirty_max));
+  EXPECT_FALSE(cache.load(Vec(1, 0, 0), g, open, dirty, dirty_min, dirty_max));
+  EXPECT_TRUE(cache.load(Vec(2, 0, 0), g, open, dirty, dirty_min, dirty_max));
+
+  cache.setMemoryLimit(bytes);
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_TRUE(cache.load(Vec(2, 0, 0), g, open, dirty, dirty_min, dirty_max));
+
+  // Too large map is not stored
+  cache.setMemoryLimit(bytes - 1);
+  cache.store(Vec(3, 0, 0), g, open);
+  EXPECT_EQ(0u, cache.size());
+}
+
+TEST(HeuristicCache, Dirty)
+{
+  HeuristicCache cache;
+  cache.setMemoryLimit(1024 * 1024);
+
+  HeuristicCache::Gridmap g;
+  HeuristicCache::OpenList open;
+  bool dirty;
+  Vec dirty_min, dirty_max;
+  fill(g, 0.0);
+  cache.store(Vec(0, 0, 0), g, open);
+  cache.markDirty(Vec(2, 3, 0), Vec(4, 5, 1));
+  cache.store(Vec(1, 0, 0), g, open);
+  cache.markDirty(Vec(1, 4, 0), Vec(3, 8, 1));
+
+  ASSERT_TRUE(cache.load(Vec(0, 0, 0), g, open, dirty, dirty_min, dirty_max));
+  EXPECT_TRUE(dirty);
+  EXPECT_EQ(1, dirty_min[0]);
+  EXPECT_EQ(3, dirty_min[1]);
+  EXPECT_EQ(4, dirty_max[0]);
+  EXPECT_EQ(8, dirty_max[1]);
+
+  ASSERT_TRUE(cache.load(Vec(1, 0, 0), g, open, dirty, dirty_min, dirty_max));
+  EXPECT_TRUE(dirty);
+  EXPECT_EQ(1, dirty_min[0]);
+  EXPECT_EQ(4, dirty_min[1]);
+  EXPECT_EQ(3, dirty_max[0]);
+  EXPECT_EQ(8, dirty_max[1]);
+
+  // Storing again resets the dirty flag
+  cache.store(Vec(1, 0, 0), g, open);
+  ASSERT_TRUE(cache.load(Vec(1, 0, 0), g, open, dirty, dirty_min, dirty_max));
+  EXPECT_FALSE(dirty);
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
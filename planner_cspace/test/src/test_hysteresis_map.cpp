@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/cyclic_vec.h>
+#include <planner_cspace/planner_3d/hysteresis_map.h>
+
+#include <gtest/gtest.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+namespace
+{
+using Vec = CyclicVecInt<3, 2>;
+using Vecf = CyclicVecFloat<3, 2>;
+using Gridmap = BlockMemGridmap<char, 3, 2, 0x20>;
+
+// Computes the hysteresis cost by checking all path segments of the same yaw.
+char hysteresisCost(
+    const Vec& p, const std::vector<Vecf>& path, const int angle,
+    const float expand_dist, const float max_dist)
+{
+  float d_min = std::numeric_limits<float>::max();
+  for (size_t i = 1; i < path.size(); ++i)
+  {
+    int yaw = std::lround(path[i][2]) % angle;
+    int yaw_prev = std::lround(path[i - 1][2]) % angle;
+    if (yaw < 0)
+      yaw += angle;
+    if (yaw_prev < 0)
+      yaw_prev += angle;
+    if (yaw == p[2] || yaw_prev == p[2])
+      d_min = std::min(d_min, Vecf(p).distLinestrip2d(path[i - 1], path[i]));
+  }
+  d_min = std::max(expand_dist, std::min(expand_dist + max_dist, d_min));
+  return std::lround((d_min - expand_dist) * 100.0 / max_dist);
+}
+
+std::vector<Vecf> arcPath(const Vecf& center, const float radius, const float yaw_offset, const int angle)
+{
+  std::vector<Vecf> path;
+  for (float t = 0; t < M_PI; t += 0.1)
+  {
+    const float yaw = (t + yaw_offset) * angle / (2 * M_PI);
+    path.push_back(Vecf(center[0] + radius * std::cos(t), center[1] + radius * std::sin(t), yaw));
+  }
+  return path;
+}
+}  // namespace
+
+TEST(HysteresisMap, Update)
+{
+  const Vec size(64, 48, 16);
+  const float expand_dist = 1.5;
+  const float max_dist = 2.5;
+  Gridmap cm_hyst(size);
+  cm_hyst.clear(100);
+
+  HysteresisMap hyst;
+  const std::vector<std::vector<Vecf>> paths =
+      {
+        arcPath(Vecf(30.0f, 10.0f, 0.0f), 20.0f, 0.0f, size[2]),
+        arcPath(Vecf(20.0f, 20.0f, 0.0f), 8.0f, 1.0f, size[2]),
+        // Partially outside of the map
+        arcPath(Vecf(60.0f, 40.0f, 0.0f), 10.0f, -2.0f, size[2]),
+      };
+  for (const auto& path : paths)
+  {
+    hyst.update(cm_hyst, path, expand_dist, max_dist);
+
+    Vec p;
+    for (p[0] = 0; p[0] < size[0]; ++p[0])
+    {
+      for (p[1] = 0; p[1] < size[1]; ++p[1])
+      {
+        for (p[2] = 0; p[2] < size[2]; ++p[2])
+        {
+          ASSERT_EQ(hysteresisCost(p, path, size[2], expand_dist, max_dist), cm_hyst[p])
+              << p[0] << ", " << p[1] << ", " << p[2];
+        }
+      }
+    }
+  }
+
+  // Cells updated previously are restored.
+  hyst.update(cm_hyst, std::vector<Vecf>(), expand_dist, max_dist);
+  for (size_t i = 0; i < cm_hyst.ser_size(); ++i)
+  {
+    ASSERT_EQ(100, cm_hyst.data()[i]);
+  }
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+
+#include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/cyclic_vec.h>
+#include <planner_cspace/planner_3d/lethal_mask.h>
+
+#include <gtest/gtest.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+TEST(LethalMask, Update)
+{
+  using Vec = LethalMask::Vec;
+  const Vec size(100, 20, 4);
+  BlockMemGridmap<char, 3, 2, 0x20> cm(size);
+  cm.clear(0);
+  cm[Vec(0, 0, 0)] = 100;
+  cm[Vec(63, 5, 1)] = 100;
+  cm[Vec(64, 5, 1)] = 99;
+  cm[Vec(99, 19, 3)] = 100;
+
+  LethalMask mask;
+  mask.reset(size);
+  mask.update(cm, Vec(0, 0, 0), size);
+  Vec p;
+  for (p[2] = 0; p[2] < size[2]; ++p[2])
+    for (p[1] = 0; p[1] < size[1]; ++p[1])
+      for (p[0] = 0; p[0] < size[0]; ++p[0])
+        ASSERT_EQ(cm[p] > 99, mask.get(p)) << p[0] << ", " << p[1] << ", " << p[2];
+
+  // Partial update
+  cm[Vec(0, 0, 0)] = 0;
+  cm[Vec(64, 5, 1)] = 100;
+  mask.update(cm, Vec(0, 0, 0), Vec(1, 1, 1));
+  EXPECT_FALSE(mask.get(Vec(0, 0, 0)));
+  EXPECT_FALSE(mask.get(Vec(64, 5, 1)));
+  mask.update(cm, Vec(60, 0, 0), Vec(200, 10, 4));
+  EXPECT_TRUE(mask.get(Vec(64, 5, 1)));
+}
+
+TEST(LethalMask, Any)
+{
+  using Vec = LethalMask::Vec;
+  const Vec size(100, 20, 4);
+  LethalMask mask;
+  mask.reset(size);
+  mask.set(Vec(0, 3, 2), true);
+  mask.set(Vec(70, 3, 2), true);
+  mask.set(Vec(99, 3, 2), true);
+
+  // Bits are shifted along x axis
+  EXPECT_TRUE(mask.any(0, 3, 2, 0x1));
+  EXPECT_FALSE(mask.any(0, 3, 1, 0x1));
+  EXPECT_FALSE(mask.any(0, 4, 2, 0x1));
+  EXPECT_TRUE(mask.any(-5, 3, 2, 0x20));
+  EXPECT_FALSE(mask.any(-5, 3, 2, 0x1F));
+  EXPECT_TRUE(mask.any(23, 3, 2, static_cast<uint64_t>(1) << 47));
+  EXPECT_FALSE(mask.any(23, 3, 2, (static_cast<uint64_t>(1) << 47) - 1));
+  EXPECT_TRUE(mask.any(43, 3, 2, static_cast<uint64_t>(1) << 56));
+  EXPECT_TRUE(mask.any(95, 3, 2, 0xF0));
+  EXPECT_TRUE(mask.any(95, 3, 2, 0x10));
+  EXPECT_FALSE(mask.any(95, 3, 2, 0xEF));
+
+  // Outside of the map is not lethal
+  EXPECT_FALSE(mask.any(0, -1, 2, 0x1));
+  EXPECT_FALSE(mask.any(0, 20, 2, 0x1));
+  EXPECT_FALSE(mask.any(-1000, 3, 2, ~static_cast<uint64_t>(0)));
+  EXPECT_FALSE(mask.any(1000, 3, 2, ~static_cast<uint64_t>(0)));
+
+  mask.set(Vec(70, 3, 2), false);
+  EXPECT_FALSE(mask.any(43, 3, 2, static_cast<uint64_t>(1) << 27));
+}
+TEST(LethalMask, CopyRegion)
+{
+  using Vec = LethalMask::Vec;
+  const Vec size(100, 20, 4);
+  LethalMask base;
+  base.reset(size);
+  base.set(Vec(10, 3, 1), true);
+  base.set(Vec(50, 5, 2), true);
+
+  LethalMask mask(base);
+  mask.set(Vec(10, 3, 1), false);
+  mask.set(Vec(12, 4, 1), true);
+  mask.set(Vec(51, 5, 2), true);
+
+  // Restore the bits around (10, 3) - (12, 4) only
+  mask.copyRegion(base, Vec(9, 2, 0), Vec(14, 6, 4));
+  EXPECT_TRUE(mask.get(Vec(10, 3, 1)));
+  EXPECT_FALSE(mask.get(Vec(12, 4, 1)));
+  EXPECT_TRUE(mask.get(Vec(50, 5, 2)));
+  EXPECT_TRUE(mask.get(Vec(51, 5, 2)));
+
+  // Region is clipped by the map
+  mask.copyRegion(base, Vec(-10, -10, -1), Vec(200, 200, 10));
+  Vec p;
+  for (p[2] = 0; p[2] < size[2]; ++p[2])
+  {
+    for (p[1] = 0; p[1] < size[1]; ++p[1])
+    {
+      for (p[0] = 0; p[0] < size[0]; ++p[0])
+      {
+        ASSERT_EQ(base.get(p), mask.get(p));
+      }
+    }
+  }
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
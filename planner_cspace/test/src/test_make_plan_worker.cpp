@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <vector>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+
+#include <planner_cspace/reservable_priority_queue.h>
+#include <planner_cspace/planner_3d/costmap_bbf.h>
+#include <planner_cspace/planner_3d/distance_map.h>
+#include <planner_cspace/planner_3d/grid_astar_model.h>
+#include <planner_cspace/planner_3d/lethal_mask.h>
+#include <planner_cspace/planner_3d/make_plan_worker.h>
+
+#include <gtest/gtest.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+using Vec = MakePlanWorker::Vec;
+
+class MakePlanWorkerTest : public ::testing::Test
+{
+protected:
+  const int w_ = 64;
+  const int h_ = 48;
+  MakePlanWorker::Params p_;
+  MakePlanWorker::Rough cm_rough_;
+  LethalMask cm_rough_mask_;
+
+  MakePlanWorkerTest()
+  {
+    p_.map_info.width = w_;
+    p_.map_info.height = h_;
+    p_.map_info.angle = 16;
+    p_.map_info.linear_resolution = 0.1;
+    p_.map_info.angular_resolution = M_PI * 2 / 16;
+    p_.euclid_cost = MakePlanWorker::Vecf(1.0f, 1.0f, 1.0f);
+    p_.range = 4;
+    p_.cc.weight_decel_ = 0.1;
+    p_.cc.weight_backward_ = 0.1;
+    p_.cc.weight_ang_vel_ = 1.0;
+    p_.cc.weight_costmap_ = 10.0;
+    p_.cc.weight_costmap_turn_ = 0.0;
+    p_.cc.weight_remembered_ = 0.0;
+    p_.cc.weight_hysteresis_ = 0.0;
+    p_.cc.in_place_turn_ = 0.0;
+    p_.cc.hysteresis_max_dist_ = 0.0;
+    p_.cc.hysteresis_expand_ = 0.0;
+    p_.cc.min_curve_radius_ = 0.0;
+    p_.cc.max_vel_ = 1.0;
+    p_.cc.max_ang_vel_ = 1.0;
+    p_.cc.angle_resolution_aspect_ = 1.0;
+    p_.distance_map.euclid_cost = p_.euclid_cost;
+    p_.distance_map.range = p_.range;
+    p_.distance_map.local_range = 10;
+    p_.distance_map.longcut_range = 0;
+    p_.distance_map.weight_costmap = p_.cc.weight_costmap_;
+    p_.distance_map.weight_remembered = 0;
+    p_.distance_map.num_cost_estim_task = 16;
+    p_.distance_map.delta_stepping_width = 0;
+    p_.time_limit = 1.0;
+    p_.find_best = true;
+
+    // Wall with a gap at the top
+    cm_rough_.reset(Vec(w_, h_, 1));
+    cm_rough_.clear(0);
+    for (Vec p(30, 0, 0); p[1] < 40; ++p[1])
+      cm_rough_[p] = 100;
+    updateMask();
+  }
+  void updateMask()
+  {
+    cm_rough_mask_.reset(cm_rough_.size());
+    cm_rough_mask_.update(cm_rough_, Vec(0, 0, 0), cm_rough_.size());
+  }
+  void expectValidPath(const Vec& s, const Vec& e, const std::list<Vec>& path)
+  {
+    ASSERT_FALSE(path.empty());
+    EXPECT_EQ(Vec(s[0], s[1], 0), path.front());
+    EXPECT_EQ(Vec(e[0], e[1], 0), path.back());
+    for (const Vec& p : path)
+    {
+      EXPECT_LT(cm_rough_[p], 100) << p[0] << ", " << p[1];
+    }
+  }
+};
+
+TEST_F(MakePlanWorkerTest, Search)
+{
+  MakePlanWorker worker;
+  worker.reset(p_);
+  worker.setMap(cm_rough_, cm_rough_mask_);
+
+  const Vec s(5, 5, 3);
+  const Vec e(55, 5, 0);
+  std::list<Vec> path;
+  ASSERT_TRUE(worker.search(s, e, path));
+  expectValidPath(s, e, path);
+  int y_max = 0;
+  for (const Vec& p : path)
+    y_max = std::max(y_max, p[1]);
+  EXPECT_GE(y_max, 40);
+
+  // Snapshot is not affected by the original costmap
+  for (Vec p(30, 40, 0); p[1] < h_; ++p[1])
+    cm_rough_[p] = 100;
+  ASSERT_TRUE(worker.search(Vec(6, 5, 0), e, path));
+
+  updateMask();
+  worker.setMap(cm_rough_, cm_rough_mask_);
+  EXPECT_FALSE(worker.search(s, e, path));
+  EXPECT_TRUE(worker.search(s, Vec(20, 30, 0), path));
+}
+
+TEST_F(MakePlanWorkerTest, Batch)
+{
+  const std::vector<MakePlanWorker::Query> queries =
+      {
+        {Vec(5, 5, 0), Vec(55, 5, 0)},
+        {Vec(10, 20, 0), Vec(20, 10, 0)},
+        {Vec(5, 40, 0), Vec(55, 5, 0)},
+        {Vec(40, 30, 0), Vec(55, 5, 0)},
+        {Vec(30, 10, 0), Vec(55, 5, 0)},
+      };
+
+  MakePlanWorker worker;
+  worker.reset(p_);
+  worker.setMap(cm_rough_, cm_rough_mask_);
+  std::vector<std::list<Vec>> paths;
+  worker.search(queries, paths);
+  ASSERT_EQ(queries.size(), paths.size());
+
+  for (size_t i = 0; i < queries.size(); ++i)
+  {
+    // Start in the wall
+    if (i == 4)
+    {
+      EXPECT_TRUE(paths[i].empty());
+      continue;
+    }
+    expectValidPath(queries[i].start, queries[i].goal, paths[i]);
+
+    MakePlanWorker worker_single;
+    worker_single.reset(p_);
+    worker_single.setMap(cm_rough_, cm_rough_mask_);
+    std::list<Vec> path;
+    ASSERT_TRUE(worker_single.search(queries[i].start, queries[i].goal, path));
+    EXPECT_EQ(path.size(), paths[i].size());
+  }
+}
+
+TEST_F(MakePlanWorkerTest, Costs)
+{
+  const std::vector<Vec> starts =
+      {
+        Vec(5, 5, 0),
+        Vec(40, 30, 3),
+        Vec(30, 10, 0),  // In the wall
+        Vec(-1, 5, 0),   // Out of the map
+        Vec(60, 45, 0),
+      };
+  const std::vector<Vec> goals =
+      {
+        Vec(55, 5, 0),
+        Vec(5, 40, 0),
+        Vec(20, 10, 0),
+        Vec(64, 0, 0),  // Out of the map
+      };
+
+  MakePlanWorker worker;
+  worker.reset(p_);
+  worker.setMap(cm_rough_, cm_rough_mask_);
+  std::vector<float> costs;
+  worker.costs(starts, goals, costs);
+  ASSERT_EQ(starts.size() * goals.size(), costs.size());
+
+  // Compare with the cost maps filled for each goal
+  CostmapBBF bbf;
+  bbf.reset(cm_rough_.size());
+  bbf.clear();
+  DistanceMap dm(cm_rough_, bbf);
+  dm.init(p_.map_info, p_.distance_map);
+  for (size_t j = 0; j < goals.size(); ++j)
+  {
+    if (j == 3)
+    {
+      for (size_t i = 0; i < starts.size(); ++i)
+        EXPECT_EQ(std::numeric_limits<float>::max(), costs[i * goals.size() + j]);
+      continue;
+    }
+    DistanceMap::Gridmap g;
+    reservable_priority_queue<MakePlanWorker::Astar::PriorityVec> open;
+    g.reset(cm_rough_.size());
+    g.clear(std::numeric_limits<float>::max());
+    g[goals[j]] = 0;
+    open.emplace(0.0f, 0.0f, goals[j]);
+    dm.fill(open, g, Vec(-1, -1, 0));
+
+    for (size_t i = 0; i < starts.size(); ++i)
+    {
+      const float cost = costs[i * goals.size() + j];
+      if (i == 2 || i == 3)
+      {
+        EXPECT_EQ(std::numeric_limits<float>::max(), cost) << i << ", " << j;
+        continue;
+      }
+      EXPECT_LT(cost, std::numeric_limits<float>::max()) << i << ", " << j;
+      EXPECT_FLOAT_EQ(g[Vec(starts[i][0], starts[i][1], 0)], cost) << i << ", " << j;
+    }
+  }
+
+  // Delta-stepping engine runs inside the parallel loop of the goals
+  p_.distance_map.delta_stepping_width = 5;
+  worker.reset(p_);
+  worker.setMap(cm_rough_, cm_rough_mask_);
+  std::vector<float> costs_delta;
+  worker.costs(starts, goals, costs_delta);
+  ASSERT_EQ(costs.size(), costs_delta.size());
+  for (size_t i = 0; i < costs.size(); ++i)
+    EXPECT_FLOAT_EQ(costs[i], costs_delta[i]) << i;
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -29,9 +29,17 @@
 
 #include <cmath>
 #include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include <unistd.h>
 
 #include <planner_cspace/cyclic_vec.h>
 #include <planner_cspace/blockmem_gridmap.h>
+#include <planner_cspace/planner_3d/lethal_mask.h>
 #include <planner_cspace/planner_3d/motion_cache.h>
 
 #include <gtest/gtest.h>
@@ -129,6 +137,277 @@ TEST(MotionCache, Generate)
     }
   }
 }
+TEST(MotionCache, SumCost)
+{
+  const int range = 8;
+  const int angle = 16;
+  const int size = 0x60;
+  const float angular_resolution = M_PI * 2 / angle;
+  const float linear_resolution = 0.1;
+
+  BlockMemGridmap<char, 3, 2, 0x40> cm(CyclicVecInt<3, 2>(size, size, angle));
+  BlockMemGridmap<char, 3, 2, 0x40> cm_hyst(CyclicVecInt<3, 2>(size, size, angle));
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> cost_dist(0, 99);
+  std::uniform_int_distribution<int> lethal_dist(0, 100);
+  CyclicVecInt<3, 2> p;
+  for (p[0] = 0; p[0] < size; ++p[0])
+  {
+    for (p[1] = 0; p[1] < size; ++p[1])
+    {
+      for (p[2] = 0; p[2] < angle; ++p[2])
+      {
+        cm[p] = lethal_dist(engine) == 0 ? 100 : cost_dist(engine);
+        cm_hyst[p] = cost_dist(engine);
+      }
+    }
+  }
+
+  MotionCache cache;
+  cache.reset(
+      linear_resolution, angular_resolution, range,
+      cm.getAddressor());
+
+  LethalMask mask;
+  mask.reset(cm.size());
+  mask.update(cm, CyclicVecInt<3, 2>(0, 0, 0), cm.size());
+
+  const MotionCache::GridmapView view(cm);
+  const MotionCache::GridmapView view_hyst(cm_hyst);
+  const CyclicVecInt<3, 2> curs[] =
+      {
+        CyclicVecInt<3, 2>(range, range, 0),
+        CyclicVecInt<3, 2>(0x3C, 0x42, 5),
+        CyclicVecInt<3, 2>(size - range - 1, size / 2, 11),
+      };
+  int num_lethal = 0;
+  for (const auto& cur : curs)
+  {
+    CyclicVecInt<3, 2> d;
+    for (d[0] = -range; d[0] <= range; d[0]++)
+    {
+      for (d[1] = -range; d[1] <= range; d[1]++)
+      {
+        for (d[2] = 0; d[2] < angle; d[2]++)
+        {
+          const auto page = cache.find(cur[2], d);
+          if (page == cache.end(cur[2]))
+            continue;
+
+          bool on_map = true;
+          for (const auto& pos_diff : page->second.getMotion())
+          {
+            const CyclicVecInt<3, 2> pos(cur[0] + pos_diff[0], cur[1] + pos_diff[1], pos_diff[2]);
+            on_map &= cm.validate(pos);
+          }
+          if (!on_map)
+            continue;
+
+          bool expected_lethal = false;
+          int expected_sum = 0, expected_sum_hyst = 0;
+          for (const auto& pos_diff : page->second.getMotion())
+          {
+            const CyclicVecInt<3, 2> pos(cur[0] + pos_diff[0], cur[1] + pos_diff[1], pos_diff[2]);
+            if (cm[pos] > 99)
+            {
+              expected_lethal = true;
+              break;
+            }
+            expected_sum += cm[pos];
+            expected_sum_hyst += cm_hyst[pos];
+          }
+
+          ASSERT_EQ(expected_lethal, page->second.hitsLethal(mask, cur[0], cur[1]));
+
+          int sum, sum_hyst;
+          ASSERT_EQ(!expected_lethal, page->second.sumCost(cur[0], cur[1], view, &view_hyst, sum, sum_hyst));
+          if (expected_lethal)
+          {
+            num_lethal++;
+            continue;
+          }
+          ASSERT_EQ(expected_sum, sum);
+          ASSERT_EQ(expected_sum_hyst, sum_hyst);
+
+          ASSERT_TRUE(page->second.sumCost(cur[0], cur[1], view, nullptr, sum, sum_hyst));
+          ASSERT_EQ(expected_sum, sum);
+          ASSERT_EQ(0, sum_hyst);
+        }
+      }
+    }
+  }
+  ASSERT_GT(num_lethal, 0);
+}
+TEST(MotionCache, SaveLoad)
+{
+  const int range = 4;
+  const int angle = 8;
+  const float angular_resolution = M_PI * 2 / angle;
+  const float linear_resolution = 0.5;
+
+  char dir_template[] = "/tmp/test_motion_cache_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir_template));
+  const std::string dir(dir_template);
+
+  const int size = 0x40;
+  BlockMemGridmap<char, 3, 2, 0x20> gm(CyclicVecInt<3, 2>(size, size, angle));
+  std::mt19937 engine(1);
+  std::uniform_int_distribution<int> cost_dist(0, 99);
+  CyclicVecInt<3, 2> p;
+  for (p[0] = 0; p[0] < size; ++p[0])
+  {
+    for (p[1] = 0; p[1] < size; ++p[1])
+    {
+      for (p[2] = 0; p[2] < angle; ++p[2])
+        gm[p] = cost_dist(engine);
+    }
+  }
+
+  MotionCache cache;
+  cache.reset(
+      linear_resolution, angular_resolution, range,
+      gm.getAddressor(), dir);
+  const std::string file = dir + "/" + cache.getKey().fileName();
+  ASSERT_TRUE(std::ifstream(file).good());
+
+  MotionCache loaded;
+  ASSERT_TRUE(loaded.load(file, cache.getKey()));
+  ASSERT_EQ(cache.getMaxRange(), loaded.getMaxRange());
+
+  const MotionCache::GridmapView view(gm);
+
+  const CyclicVecInt<3, 2> cur(0x20 - 2, 0x20 - 2, 0);
+  for (int syaw = 0; syaw < angle; ++syaw)
+  {
+    CyclicVecInt<3, 2> d;
+    for (d[0] = -range; d[0] <= range; d[0]++)
+    {
+      for (d[1] = -range; d[1] <= range; d[1]++)
+      {
+        for (d[2] = 0; d[2] < angle; d[2]++)
+        {
+          const auto page = cache.find(syaw, d);
+          const auto page_loaded = loaded.find(syaw, d);
+          if (page == cache.end(syaw))
+          {
+            ASSERT_EQ(page_loaded, loaded.end(syaw));
+            continue;
+          }
+          ASSERT_NE(page_loaded, loaded.end(syaw));
+          ASSERT_EQ(page->second.getDistance(), page_loaded->second.getDistance());
+          ASSERT_EQ(page->second.getMotion(), page_loaded->second.getMotion());
+
+          int sum, sum_hyst, sum_loaded, sum_hyst_loaded;
+          ASSERT_TRUE(page->second.sumCost(cur[0], cur[1], view, &view, sum, sum_hyst));
+          ASSERT_TRUE(page_loaded->second.sumCost(cur[0], cur[1], view, &view, sum_loaded, sum_hyst_loaded));
+          ASSERT_EQ(sum, sum_loaded);
+          ASSERT_EQ(sum_hyst, sum_hyst_loaded);
+        }
+      }
+    }
+  }
+
+  // Saved file must be reproducible.
+  {
+    MotionCache cache2;
+    cache2.reset(
+        linear_resolution, angular_resolution, range,
+        gm.getAddressor());
+    const std::string file2 = dir + "/cache2.bin";
+    ASSERT_TRUE(cache2.save(file2));
+    std::ifstream ifs(file, std::ios::binary);
+    std::ifstream ifs2(file2, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    const std::string data2((std::istreambuf_iterator<char>(ifs2)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(data, data2);
+    std::remove(file2.c_str());
+  }
+
+  // Cache generated with the different parameters must not be loaded.
+  MotionCache::CacheKey key = cache.getKey();
+  key.range = range + 1;
+  ASSERT_FALSE(loaded.load(file, key));
+
+  // Broken file must not be loaded.
+  {
+    std::ifstream ifs(file, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    std::ofstream ofs(file, std::ios::binary | std::ios::trunc);
+    ofs.write(data.data(), data.size() / 2);
+  }
+  ASSERT_FALSE(loaded.load(file, cache.getKey()));
+
+  std::remove(file.c_str());
+  rmdir(dir.c_str());
+}
+TEST(MotionCache, LoadBroken)
+{
+  const int range = 2;
+  const int angle = 4;
+  const float angular_resolution = M_PI * 2 / angle;
+  const float linear_resolution = 0.5;
+  const int size = 0x20;
+
+  char dir_template[] = "/tmp/test_motion_cache_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir_template));
+  const std::string file = std::string(dir_template) + "/cache.bin";
+
+  BlockMemGridmap<char, 3, 2, 0x20> gm(CyclicVecInt<3, 2>(size, size, angle));
+  gm.clear(0);
+  const MotionCache::GridmapView view(gm);
+  MotionCache cache;
+  cache.reset(
+      linear_resolution, angular_resolution, range,
+      gm.getAddressor());
+  ASSERT_TRUE(cache.save(file));
+  std::string data;
+  {
+    std::ifstream ifs(file, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  }
+
+  // Overwrite each word of the file.
+  // Loaded pages must be usable without reading outside of the map.
+  int num_failed = 0;
+  for (size_t pos = 0; pos + 4 <= data.size(); pos += 4)
+  {
+    std::string broken = data;
+    std::fill(broken.begin() + pos, broken.begin() + pos + 4, '\xFF');
+    {
+      std::ofstream ofs(file, std::ios::binary | std::ios::trunc);
+      ofs.write(broken.data(), broken.size());
+    }
+    MotionCache loaded;
+    if (!loaded.load(file, cache.getKey()))
+    {
+      num_failed++;
+      continue;
+    }
+    for (int syaw = 0; syaw < angle; ++syaw)
+    {
+      CyclicVecInt<3, 2> d;
+      for (d[0] = -range; d[0] <= range; d[0]++)
+      {
+        for (d[1] = -range; d[1] <= range; d[1]++)
+        {
+          for (d[2] = 0; d[2] < angle; d[2]++)
+          {
+            const auto page = loaded.find(syaw, d);
+            if (page == loaded.end(syaw))
+              continue;
+            int sum, sum_hyst;
+            ASSERT_TRUE(page->second.sumCost(size / 2, size / 2, view, &view, sum, sum_hyst)) << pos;
+            ASSERT_EQ(0, sum) << pos;
+          }
+        }
+      }
+    }
+  }
+  EXPECT_GT(num_failed, 0);
+
+  std::remove(file.c_str());
+  rmdir(dir_template);
+}
 }  // namespace planner_3d
 }  // namespace planner_cspace
 
@@ -28,9 +28,11 @@
  */
 
 #include <list>
+#include <memory>
 #include <vector>
 
 #include <costmap_cspace_msgs/MapMetaData3D.h>
+#include <planner_cspace/grid_astar.h>
 #include <planner_cspace/planner_3d/grid_astar_model.h>
 
 #include <gtest/gtest.h>
@@ -92,6 +94,112 @@ TEST(GridAstarModel3D, Cost)
   EXPECT_LT(c_straight, c_drift);
   EXPECT_LT(c_straight, c_drift_curve);
 }
+TEST(GridAstarModel3D, IncrementalSearch)
+{
+  using Vec = GridAstarModel3D::Vec;
+  const int size = 64;
+  const int angle = 16;
+  const int range = 4;
+  const int local_range = 12;
+
+  costmap_cspace_msgs::MapMetaData3D map_info;
+  map_info.width = size;
+  map_info.height = size;
+  map_info.angle = angle;
+  map_info.linear_resolution = 0.1;
+  map_info.angular_resolution = M_PI * 2 / map_info.angle;
+  BlockMemGridmap<char, 3, 2, 0x40> cm(Vec(size, size, angle));
+  BlockMemGridmap<float, 3, 2> cost_estim_cache(Vec(size, size, angle));
+  cm.clear(0);
+  cost_estim_cache.clear(0.0);
+  CostCoeff cc;
+  cc.weight_decel_ = 0.1;
+  cc.weight_backward_ = 0.9;
+  cc.weight_ang_vel_ = 1.0;
+  cc.weight_costmap_ = 10.0;
+  cc.weight_costmap_turn_ = 0.1;
+  cc.weight_remembered_ = 0.0;
+  cc.weight_hysteresis_ = 0.0;
+  cc.in_place_turn_ = 0.5;
+  cc.hysteresis_max_dist_ = 0.0;
+  cc.hysteresis_expand_ = 0.0;
+  cc.min_curve_radius_ = 0.1;
+  cc.max_vel_ = 1.0;
+  cc.max_ang_vel_ = 1.0;
+  cc.angle_resolution_aspect_ = 2.0 / tanf(map_info.angular_resolution);
+
+  std::shared_ptr<GridAstarModel3D> model(
+      new GridAstarModel3D(
+          map_info,
+          GridAstarModel3D::Vecf(1.0f, 1.0f, 0.5f),
+          local_range,
+          cost_estim_cache, cm, cm, cm,
+          cc, range));
+
+  std::vector<GridAstarModel3D::VecWithCost> starts;
+  starts.emplace_back(Vec(16, 32, 0));
+  const Vec goal(48, 32, 0);
+
+  const auto path_cost = [&model, &starts, &goal](const std::list<Vec>& path)
+  {
+    float cost = 0;
+    for (auto it = std::next(path.cbegin()); it != path.cend(); ++it)
+      cost += model->cost(*std::prev(it), *it, starts, goal);
+    return cost;
+  };
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+  const auto set_obstacle = [&cm](const int x0, const int x1, const int y0, const int y1, const char c)
+  {
+    Vec p;
+    for (p[0] = x0; p[0] < x1; ++p[0])
+    {
+      for (p[1] = y0; p[1] < y1; ++p[1])
+      {
+        for (p[2] = 0; p[2] < angle; ++p[2])
+          cm[p] = c;
+      }
+    }
+  };
+
+  GridAstar<3, 2> as(Vec(size, size, angle));
+  GridAstar<3, 2> as_ref(Vec(size, size, angle));
+
+  std::list<Vec> path;
+  std::list<Vec> path_ref;
+  ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+  ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+  EXPECT_NEAR(path_cost(path_ref), path_cost(path), 1e-3);
+
+  // Obstacles around the boundary of the local range,
+  // where the motion primitives and the rough search grids are switched.
+  const int x_boundary = starts[0].v_[0] + local_range;
+  const std::vector<std::vector<int>> updates =
+      {
+        // x0, x1, y0, y1, cost
+        { x_boundary - 2, x_boundary + 2, 28, 38, 100 },
+        { x_boundary - 3, x_boundary + 1, 24, 28, 60 },
+        { x_boundary - 2, x_boundary + 2, 28, 38, 0 },
+        { x_boundary - 3, x_boundary + 1, 24, 28, 0 },
+      };
+  for (const auto& u : updates)
+  {
+    set_obstacle(u[0], u[1], u[2], u[3], u[4]);
+    as.updateIncremental(
+        Vec(u[0] - range - 1, u[2] - range - 1, 0),
+        Vec(u[1] + range + 1, u[3] + range + 1, angle));
+
+    path.clear();
+    path_ref.clear();
+    ASSERT_TRUE(as.searchIncremental(starts, goal, path, model, 0));
+    ASSERT_TRUE(as_ref.search(starts, goal, path_ref, model, cb_progress, 0, 100.0));
+    EXPECT_EQ(path.front(), starts[0].v_);
+    EXPECT_EQ(path.back(), goal);
+    EXPECT_NEAR(path_cost(path_ref), path_cost(path), 1e-3);
+  }
+}
 }  // namespace planner_3d
 }  // namespace planner_cspace
 
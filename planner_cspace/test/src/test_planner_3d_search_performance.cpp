@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <iomanip>
+#include <list>
+#include <random>
+#include <vector>
+
+#include <boost/chrono.hpp>
+
+#include <omp.h>
+
+#include <costmap_cspace_msgs/MapMetaData3D.h>
+#include <planner_cspace/grid_astar.h>
+#include <planner_cspace/planner_3d/grid_astar_model.h>
+#include <planner_cspace/planner_3d/grid_astar_model_impl.h>
+
+#include <gtest/gtest.h>
+
+namespace planner_cspace
+{
+namespace planner_3d
+{
+TEST(GridAstarModel3D, DevirtualizedSearchPerformance)
+{
+  using Astar = GridAstar<3, 2>;
+  using Vec = Astar::Vec;
+  constexpr int size = 0x80;
+  constexpr int angle = 16;
+  constexpr int repeat = 4;
+
+  costmap_cspace_msgs::MapMetaData3D map_info;
+  map_info.width = size;
+  map_info.height = size;
+  map_info.angle = angle;
+  map_info.linear_resolution = 0.1;
+  map_info.angular_resolution = M_PI * 2 / map_info.angle;
+
+  CostCoeff cc;
+  cc.weight_decel_ = 50.0;
+  cc.weight_backward_ = 0.9;
+  cc.weight_ang_vel_ = 1.0;
+  cc.weight_costmap_ = 50.0;
+  cc.weight_costmap_turn_ = 0.0;
+  cc.weight_remembered_ = 0.0;
+  cc.weight_hysteresis_ = 0.0;
+  cc.in_place_turn_ = 30.0;
+  cc.hysteresis_max_dist_ = 0.1;
+  cc.hysteresis_expand_ = 0.1;
+  cc.min_curve_radius_ = 0.1;
+  cc.max_vel_ = 0.3;
+  cc.max_ang_vel_ = 0.6;
+  cc.angle_resolution_aspect_ = 2.0 / tanf(map_info.angular_resolution);
+  const Astar::Vecf ec(1.0f / cc.max_vel_, 1.0f / cc.max_vel_, cc.weight_ang_vel_ / cc.max_ang_vel_);
+
+  const Vec start(8, 8, 0);
+  const Vec goal(size - 8, size - 8, angle / 4);
+
+  Astar::Gridmap<char, 0x40> cm(Vec(size, size, angle));
+  Astar::Gridmap<char, 0x80> cm_rough(Vec(size, size, 1));
+  Astar::Gridmap<char, 0x40> cm_hyst(Vec(size, size, angle));
+  Astar::Gridmap<float> cost_estim_cache(Vec(size, size, 1));
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> cost_dist(0, 99);
+  Vec p;
+  for (p[0] = 0; p[0] < size; ++p[0])
+  {
+    for (p[1] = 0; p[1] < size; ++p[1])
+    {
+      // Walls with gaps
+      const char c = (p[0] % 0x20 == 0x10 && p[1] % 0x40 > 0x10) ? 100 : cost_dist(engine) / 4;
+      for (p[2] = 0; p[2] < angle; ++p[2])
+        cm[p] = c;
+      p[2] = 0;
+      cm_rough[p] = c;
+      cost_estim_cache[p] = std::hypot(goal[0] - p[0], goal[1] - p[1]) * ec[0];
+    }
+  }
+  cm_hyst.clear(100);
+
+  // Planner_3d uses the concrete gridmaps and the concrete model type.
+  GridAstarModel3DPlanner::Ptr model_devirtualized(
+      new GridAstarModel3DPlanner(
+          map_info, ec, size * 2,
+          cost_estim_cache, cm, cm_hyst, cm_rough,
+          cc, 4));
+  // Plugins access the model and gridmaps through the virtual interfaces.
+  GridAstarModelBase<3, 2>::Ptr model_virtual(
+      new GridAstarModel3D(
+          map_info, ec, size * 2,
+          cost_estim_cache, cm, cm_hyst, cm_rough,
+          cc, 4));
+
+  const auto cb_progress = [](const std::list<Vec>&)
+  {
+    return true;
+  };
+  std::vector<Astar::VecWithCost> starts;
+  starts.emplace_back(start);
+
+  omp_set_num_threads(1);
+  Astar as(Vec(size, size, angle));
+  as.setSearchTaskNum(1);
+
+  std::list<Vec> path_virtual;
+  std::list<Vec> path_devirtualized;
+  boost::chrono::duration<float> duration_virtual(0);
+  boost::chrono::duration<float> duration_devirtualized(0);
+  for (int r = 0; r < repeat; ++r)
+  {
+    const auto ts = boost::chrono::high_resolution_clock::now();
+    path_virtual.clear();
+    ASSERT_TRUE(as.search(starts, goal, path_virtual, model_virtual, cb_progress, 0, 100.0));
+    const auto tm = boost::chrono::high_resolution_clock::now();
+    path_devirtualized.clear();
+    ASSERT_TRUE(as.search(starts, goal, path_devirtualized, model_devirtualized, cb_progress, 0, 100.0));
+    const auto te = boost::chrono::high_resolution_clock::now();
+    duration_virtual += tm - ts;
+    duration_devirtualized += te - tm;
+  }
+
+  // Both must give exactly the same result
+  ASSERT_EQ(path_virtual, path_devirtualized);
+
+  std::cout << std::setw(16) << "virtual [s]"
+            << std::setw(20) << "devirtualized [s]" << std::endl;
+  std::cout << std::setw(16) << duration_virtual.count() / repeat
+            << std::setw(20) << duration_devirtualized.count() / repeat << std::endl;
+}
+}  // namespace planner_3d
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2020, the neonavigation authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <planner_cspace/priority_queues.h>
+#include <planner_cspace/reservable_priority_queue.h>
+
+namespace planner_cspace
+{
+namespace
+{
+struct Entry
+{
+  float p_;
+  int id_;
+
+  Entry(const float p, const int id)
+    : p_(p)
+    , id_(id)
+  {
+  }
+  bool operator<(const Entry& b) const
+  {
+    // smaller first
+    return p_ > b.p_;
+  }
+};
+
+template <class T>
+using DaryHeap4 = dary_heap<T, 4>;
+template <class T>
+using DaryHeap8 = dary_heap<T, 8>;
+template <class T>
+using BucketQueue = bucket_queue<T, 4>;
+template <class T>
+using TwoLevelBucketQueue = two_level_bucket_queue<T, 1>;
+
+// Maximum priority error of the popped elements
+template <template <class> class QUEUE>
+float quantization()
+{
+  return 0;
+}
+template <>
+float quantization<BucketQueue>()
+{
+  return 1.0 / 4;
+}
+
+template <template <class> class QUEUE>
+void testRandomOperations(const bool bounded)
+{
+  std::mt19937 engine(42);
+  std::uniform_int_distribution<int> op_dist(0, 9);
+  std::uniform_real_distribution<float> cost_dist(0.0, 100.0);
+
+  QUEUE<Entry> queue;
+  // Reference of the queued priorities
+  std::multiset<float> ref;
+  float last_popped = 0;
+
+  for (int i = 0; i < 20000; ++i)
+  {
+    const int op = op_dist(engine);
+    if (op < 5 || ref.empty())
+    {
+      // Keys larger than the last popped one, as A* with a consistent heuristic
+      // and some smaller keys, as the anytime and incremental search
+      // and infinite keys, as the unreachable grids
+      float p = last_popped + cost_dist(engine) / 10;
+      if (op == 0)
+        p = cost_dist(engine);
+      else if (op == 1 && i % 8 == 0)
+        p = std::numeric_limits<float>::max();
+      queue.emplace(p, i);
+      ref.insert(p);
+    }
+    else if (op < 9 || !bounded)
+    {
+      const float p = queue.top().p_;
+      ASSERT_NEAR(*ref.begin(), p, quantization<QUEUE>()) << i;
+      ref.erase(ref.find(p));
+      queue.pop();
+      last_popped = p;
+    }
+    else
+    {
+      const float worst = *ref.rbegin();
+      queue.pop_back();
+
+      // Compare the remaining contents
+      QUEUE<Entry> copied = queue;
+      std::multiset<float> evicted = ref;
+      ref.clear();
+      while (copied.size() > 0)
+      {
+        const float p = copied.top().p_;
+        const auto it = evicted.find(p);
+        ASSERT_NE(evicted.end(), it) << i;
+        evicted.erase(it);
+        ref.insert(p);
+        copied.pop();
+      }
+      ASSERT_EQ(1u, evicted.size());
+      // Quantized queue may evict another element in the worst bucket
+      EXPECT_NEAR(worst, *evicted.begin(), quantization<QUEUE>()) << i;
+    }
+    ASSERT_EQ(ref.size(), queue.size());
+  }
+  queue.clear();
+  EXPECT_EQ(0u, queue.size());
+  queue.emplace(1.0, 0);
+  queue.emplace(0.5, 1);
+  EXPECT_EQ(1, queue.top().id_);
+}
+}  // namespace
+
+TEST(PriorityQueues, DaryHeap)
+{
+  testRandomOperations<DaryHeap4>(false);
+  testRandomOperations<DaryHeap8>(false);
+  testRandomOperations<reservable_priority_queue>(false);
+}
+
+TEST(PriorityQueues, MinMaxHeap)
+{
+  testRandomOperations<min_max_heap>(true);
+
+  min_max_heap<Entry> queue;
+  for (int i = 0; i < 100; ++i)
+    queue.emplace(static_cast<float>((i * 37) % 100), i);
+  for (int i = 0; i < 50; ++i)
+  {
+    EXPECT_EQ(static_cast<float>(99 - i), queue.bottom().p_);
+    queue.pop_back();
+  }
+  EXPECT_EQ(0.0f, queue.top().p_);
+}
+
+TEST(PriorityQueues, BucketQueue)
+{
+  testRandomOperations<BucketQueue>(true);
+}
+
+TEST(PriorityQueues, TwoLevelBucketQueue)
+{
+  testRandomOperations<TwoLevelBucketQueue>(true);
+}
+}  // namespace planner_cspace
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}